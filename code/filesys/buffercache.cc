@@ -0,0 +1,454 @@
+// buffercache.cc
+//	Routines to keep recently used disk sectors in memory.
+//
+//	Only one thread at a time may look at the cache, but the lock
+//	is let go while a buffer is read from or written to disk, so that
+//	other threads can use the rest of the cache meanwhile.  A buffer
+//	being read or written is "busy"; anyone else who wants it waits
+//	until it isn't.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "buffercache.h"
+#include "system.h"
+
+#include <strings.h>
+
+//----------------------------------------------------------------------
+// CacheFlusher
+// 	The life of the flusher thread.  Need this to be a C routine,
+//	because C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+CacheFlusher(int arg)
+{
+    BufferCache *cache = (BufferCache *) arg;
+
+    cache->Flusher();
+}
+
+//----------------------------------------------------------------------
+// CacheReadAhead
+// 	The life of the read-ahead thread.
+//----------------------------------------------------------------------
+
+static void
+CacheReadAhead(int arg)
+{
+    BufferCache *cache = (BufferCache *) arg;
+
+    cache->ReadAhead();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::BufferCache
+// 	Initialize the buffer cache, with every buffer empty, and start
+//	the flusher and the read-ahead thread.
+//----------------------------------------------------------------------
+
+BufferCache::BufferCache()
+{
+    Thread *flusher = new Thread("cache flusher");
+    Thread *reader = new Thread("cache read-ahead");
+
+    buffers = new Buffer[NumBuffers];
+    for (int i = 0; i < NumBuffers; i++) {
+	buffers[i].sector = buffers[i].next = -1;
+	buffers[i].dirty = buffers[i].busy = buffers[i].used = FALSE;
+    }
+    for (int i = 0; i < NumBuckets; i++)
+	buckets[i] = -1;
+    hand = 0;
+    numDirty = 0;
+    lock = new Lock("buffer cache");
+    available = new Condition("buffer available");
+    tooDirty = new Condition("too many dirty buffers");
+    firstReadAhead = numReadAheads = 0;
+    wanted = new Condition("read ahead wanted");
+    flusher->Fork(CacheFlusher, (int) this);
+    reader->Fork(CacheReadAhead, (int) this);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::~BufferCache
+// 	Nachos is halting: write back everything that hasn't been yet.
+//	The flusher and the read-ahead thread are still waiting for work,
+//	so we leave the lock and the conditions alone.
+//----------------------------------------------------------------------
+
+BufferCache::~BufferCache()
+{
+    Flush();
+    delete [] buffers;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Read
+// 	Read part of a sector, from the cache if it is there; otherwise
+//	read the sector into the cache first.
+//
+//	"sector" -- the sector to read
+//	"into" -- where to put the data
+//	"offset" -- where in the sector to start
+//	"numBytes" -- how much to read
+//----------------------------------------------------------------------
+
+void
+BufferCache::Read(int sector, char *into, int offset, int numBytes)
+{
+    int i;
+
+    ASSERT((offset >= 0) && (numBytes >= 0) &&
+		(offset + numBytes <= SectorSize));
+    lock->Acquire();
+    i = Get(sector, TRUE);
+    bcopy(&buffers[i].data[offset], into, numBytes);
+    Put(i, FALSE);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Write
+// 	Write part of a sector, in the cache.  If the sector isn't there,
+//	and we aren't writing all of it, we read the rest of it first.
+//	The disk is only written later.
+//
+//	"sector" -- the sector to write
+//	"from" -- the data to write
+//	"offset" -- where in the sector to start
+//	"numBytes" -- how much to write
+//----------------------------------------------------------------------
+
+void
+BufferCache::Write(int sector, char *from, int offset, int numBytes)
+{
+    int i;
+
+    ASSERT((offset >= 0) && (numBytes >= 0) &&
+		(offset + numBytes <= SectorSize));
+    lock->Acquire();
+    i = Get(sector, (offset > 0) || (numBytes < SectorSize));
+    bcopy(from, &buffers[i].data[offset], numBytes);
+    Put(i, TRUE);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Zero
+// 	Fill a sector with zeroes, in the cache.  This is for sectors
+//	just allocated to a file, so there is no need to read them first.
+//
+//	"sector" -- the sector to zero
+//----------------------------------------------------------------------
+
+void
+BufferCache::Zero(int sector)
+{
+    int i;
+
+    lock->Acquire();
+    i = Get(sector, FALSE);
+    bzero(buffers[i].data, SectorSize);
+    Put(i, TRUE);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Prefetch
+// 	Ask for a sector to be read into the cache, by the read-ahead
+//	thread, and return without waiting for it.  Nothing is done if
+//	the sector is cached, or already asked for -- or if too many
+//	sectors are, since we are only guessing that it will be needed.
+//
+//	"sector" -- the sector to read ahead
+//----------------------------------------------------------------------
+
+void
+BufferCache::Prefetch(int sector)
+{
+    bool queued = FALSE;
+
+    lock->Acquire();
+    for (int n = 0; n < numReadAheads; n++)
+	if (readAheads[(firstReadAhead + n) % MaxReadAheads] == sector)
+	    queued = TRUE;
+    if (!queued && (Find(sector) == -1) && (numReadAheads < MaxReadAheads)) {
+	readAheads[(firstReadAhead + numReadAheads) % MaxReadAheads] = sector;
+	numReadAheads++;
+	wanted->Signal(lock);
+    }
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Flush
+// 	Write back every buffer that is dirty.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Flush()
+{
+    lock->Acquire();
+    while (numDirty > 0)
+	if (WriteBackAll() == 0)
+	    available->Wait(lock);	// the dirty ones are all busy
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Flusher
+// 	Whenever too many buffers are dirty, write them all back, so
+//	that there are clean buffers to replace -- and a thread that
+//	needs one doesn't have to wait for a dirty one to be written.
+//	Never returns.
+//----------------------------------------------------------------------
+
+void
+BufferCache::Flusher()
+{
+    lock->Acquire();
+    for (;;) {
+	while (numDirty < FlushThreshold)
+	    tooDirty->Wait(lock);
+	DEBUG('f', "Flushing %d dirty buffers\n", numDirty);
+	if (WriteBackAll() == 0)
+	    available->Wait(lock);	// someone else is writing them back
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::ReadAhead
+// 	Read the sectors asked for by Prefetch into the cache, in the
+//	order they were asked for.  Never returns.
+//----------------------------------------------------------------------
+
+void
+BufferCache::ReadAhead()
+{
+    int sector, i;
+
+    lock->Acquire();
+    for (;;) {
+	while (numReadAheads == 0)
+	    wanted->Wait(lock);
+	sector = readAheads[firstReadAhead];
+	firstReadAhead = (firstReadAhead + 1) % MaxReadAheads;
+	numReadAheads--;
+	if (Find(sector) == -1) {	// else someone read it meanwhile
+	    DEBUG('f', "Reading ahead sector %d\n", sector);
+	    i = Get(sector, TRUE);
+	    stats->numReadAheads++;
+	    Put(i, FALSE);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Find
+// 	Return the buffer holding a sector, or -1 if it isn't cached.
+//	The caller holds the lock.
+//
+//	"sector" -- the sector to look for
+//----------------------------------------------------------------------
+
+int
+BufferCache::Find(int sector)
+{
+    int i;
+
+    for (i = buckets[sector % NumBuckets]; i != -1; i = buffers[i].next)
+	if (buffers[i].sector == sector)
+	    break;
+    return i;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Rehash
+// 	Change which sector a buffer is for, moving it from one hash
+//	bucket to the other.  The caller holds the lock.
+//
+//	"i" -- the buffer
+//	"sector" -- the sector it is now for
+//----------------------------------------------------------------------
+
+void
+BufferCache::Rehash(int i, int sector)
+{
+    int *link;
+
+    if (buffers[i].sector != -1) {
+	for (link = &buckets[buffers[i].sector % NumBuckets]; *link != i;
+		link = &buffers[*link].next)
+	    ;
+	*link = buffers[i].next;
+    }
+    buffers[i].sector = sector;
+    buffers[i].next = buckets[sector % NumBuckets];
+    buckets[sector % NumBuckets] = i;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Get
+// 	Return the buffer holding a sector, marked busy so that nobody
+//	else uses it until we Put it.  If the sector isn't cached, replace
+//	a buffer with it, first writing the buffer back if it is dirty.
+//	The caller holds the lock, which we let go while we wait for the
+//	disk, or for a busy buffer.
+//
+//	"sector" -- the sector we want
+//	"fill" -- if the sector isn't cached, should we read it from
+//		disk?  Not if the caller is about to overwrite all of it.
+//----------------------------------------------------------------------
+
+int
+BufferCache::Get(int sector, bool fill)
+{
+    int i;
+
+    for (;;) {
+	i = Find(sector);
+	if (i != -1) {
+	    if (!buffers[i].busy) {
+		stats->numCacheHits++;
+		break;
+	    }
+	    available->Wait(lock);	// being read or written
+	} else {
+	    i = Victim();
+	    if (i == -1)
+		available->Wait(lock);	// every buffer is busy
+	    else if (buffers[i].dirty)
+		WriteBack(i);		// then look again: someone else
+					// may have cached "sector" meanwhile
+	    else {
+		stats->numCacheMisses++;
+		Rehash(i, sector);
+		if (fill) {
+		    buffers[i].busy = TRUE;
+		    lock->Release();
+		    synchDisk->ReadSector(sector, buffers[i].data);
+		    lock->Acquire();
+		}
+		break;
+	    }
+	}
+    }
+    buffers[i].busy = TRUE;
+    buffers[i].used = TRUE;
+    return i;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Put
+// 	We are done with a buffer; let anyone waiting for it have it.
+//	The caller holds the lock.
+//
+//	"i" -- the buffer
+//	"dirtied" -- did we change it?
+//----------------------------------------------------------------------
+
+void
+BufferCache::Put(int i, bool dirtied)
+{
+    if (dirtied && !buffers[i].dirty) {
+	buffers[i].dirty = TRUE;
+	if (++numDirty >= FlushThreshold)
+	    tooDirty->Signal(lock);
+    }
+    buffers[i].busy = FALSE;
+    available->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::Victim
+// 	Choose a buffer to replace: the first one the clock hand finds
+//	that isn't busy, and hasn't been used since the hand last passed
+//	it.  Return -1 if every buffer is busy.  The caller holds the lock.
+//----------------------------------------------------------------------
+
+int
+BufferCache::Victim()
+{
+    int i;
+
+    for (int n = 0; n < 2 * NumBuffers; n++) {
+	i = hand;
+	hand = (hand + 1) % NumBuffers;
+	if (buffers[i].busy)
+	    continue;
+	if (!buffers[i].used)
+	    return i;
+	buffers[i].used = FALSE;
+    }
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteBack
+// 	Write a dirty buffer back to disk.  The caller holds the lock,
+//	which we let go while we wait for the disk; the buffer is busy
+//	meanwhile.
+//
+//	"i" -- the buffer, which mustn't be busy
+//----------------------------------------------------------------------
+
+void
+BufferCache::WriteBack(int i)
+{
+    ASSERT(buffers[i].dirty && !buffers[i].busy);
+    buffers[i].busy = TRUE;
+    lock->Release();
+    synchDisk->WriteSector(buffers[i].sector, buffers[i].data);
+    lock->Acquire();
+    buffers[i].busy = FALSE;
+    buffers[i].dirty = FALSE;
+    numDirty--;
+    available->Broadcast(lock);
+}
+
+//----------------------------------------------------------------------
+// BufferCache::WriteBackAll
+// 	Write back every dirty buffer that isn't busy, and return how many
+//	there were.  They are all given to the disk at once, so that it
+//	can write them in whatever order is quickest.  The caller holds
+//	the lock, which we let go while we wait for the disk; the buffers
+//	are busy meanwhile.
+//----------------------------------------------------------------------
+
+int
+BufferCache::WriteBackAll()
+{
+    DiskRequest requests[NumBuffers];
+    int which[NumBuffers];		// the buffer each request is for
+    Semaphore done("buffers written back", 0);
+    int n = 0;
+
+    for (int i = 0; i < NumBuffers; i++)
+	if (buffers[i].dirty && !buffers[i].busy) {
+	    buffers[i].busy = TRUE;
+	    requests[n].sector = buffers[i].sector;
+	    requests[n].data = buffers[i].data;
+	    requests[n].writing = TRUE;
+	    requests[n].done = &done;
+	    which[n++] = i;
+	}
+    if (n == 0)
+	return 0;
+    lock->Release();
+    for (int k = 0; k < n; k++)
+	synchDisk->StartRequest(&requests[k]);
+    for (int k = 0; k < n; k++)
+	done.P();
+    lock->Acquire();
+    for (int k = 0; k < n; k++) {
+	buffers[which[k]].busy = FALSE;
+	buffers[which[k]].dirty = FALSE;
+    }
+    numDirty -= n;
+    available->Broadcast(lock);
+    return n;
+}
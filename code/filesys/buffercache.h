@@ -0,0 +1,106 @@
+// buffercache.h
+//	Data structures for keeping recently used disk sectors in memory.
+//
+//	All of the file system's disk I/O goes through the buffer cache.
+//	A sector that is in the cache is read and written there, without
+//	going to the disk; a write only marks the cached copy as dirty,
+//	and it is written back later -- when its buffer is needed for
+//	another sector, or by the flusher, a kernel thread that writes
+//	back dirty buffers once there are too many of them.
+//
+//	A sector can be read or written in part, so that a small write
+//	does not have to read and write the whole sector itself.
+//
+//	A sector can also be read ahead: asked for before it is needed,
+//	and read into the cache by another kernel thread, so that whoever
+//	asked need not wait for it.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef BUFFERCACHE_H
+#define BUFFERCACHE_H
+
+#include "copyright.h"
+#include "disk.h"
+#include "synch.h"
+
+#define NumBuffers	64		// sectors the cache can hold
+#define NumBuckets	NumBuffers	// size of the hash table
+#define FlushThreshold	(NumBuffers / 2)	// wake the flusher when
+					// this many buffers are dirty
+#define MaxReadAheads	(NumBuffers / 4)	// most sectors waiting to
+					// be read ahead
+
+// The following class defines one buffer: a sector's worth of data,
+// and which sector it is.
+
+class Buffer {
+  public:
+    int sector;			// the sector in the buffer, or -1
+    bool dirty;			// has it changed since it was read?
+    bool busy;			// is it being read or written, so that
+				// nobody else may use it?
+    bool used;			// has it been used since the clock hand
+				// last passed it?
+    int next;			// next buffer in the same hash bucket,
+				// or -1
+    char data[SectorSize];	// the contents of the sector
+};
+
+// The following class defines the buffer cache.  Buffers are found by
+// hashing their sector number, and replaced in "clock" order.
+
+class BufferCache {
+  public:
+    BufferCache();			// Initialize the cache, empty, and
+					// start the flusher
+    ~BufferCache();			// Write back every dirty buffer
+
+    void Read(int sector, char *into, int offset, int numBytes);
+    					// Read/write "numBytes" bytes of a
+					// sector, starting "offset" bytes
+					// into it
+    void Write(int sector, char *from, int offset, int numBytes);
+    void ReadSector(int sector, char *into)
+	{ Read(sector, into, 0, SectorSize); }
+    void WriteSector(int sector, char *from)
+	{ Write(sector, from, 0, SectorSize); }
+    void Zero(int sector);		// A newly allocated sector will
+					// hold only zeroes
+    void Prefetch(int sector);		// Start reading "sector" into the
+					// cache, but don't wait for it
+
+    void Flush();			// Write back every dirty buffer
+    void Flusher();			// The flusher thread's life
+    void ReadAhead();			// The read-ahead thread's life
+
+  private:
+    int Find(int sector);		// Which buffer holds "sector", or -1
+    void Rehash(int i, int sector);	// Buffer "i" is now for "sector"
+    int Get(int sector, bool fill);	// Find or load "sector", and mark
+					// its buffer busy
+    void Put(int i, bool dirtied);	// Done with buffer "i"
+    int Victim();			// Choose a buffer to replace
+    void WriteBack(int i);		// Write buffer "i" back to disk
+    int WriteBackAll();			// Write back every dirty buffer
+					// that isn't busy
+
+    Buffer *buffers;			// the buffers themselves
+    int buckets[NumBuckets];		// first buffer in each hash bucket
+    int hand;				// where the clock hand is
+    int numDirty;			// # of buffers that are dirty
+    Lock *lock;				// to use any of the above
+    Condition *available;		// signalled when a buffer stops
+					// being busy
+    Condition *tooDirty;		// signalled when the flusher has
+					// work to do
+    int readAheads[MaxReadAheads];	// sectors waiting to be read ahead,
+    int firstReadAhead;			// in order, from here
+    int numReadAheads;			// # of them
+    Condition *wanted;			// signalled when there is a sector
+					// to read ahead
+};
+
+#endif // BUFFERCACHE_H
@@ -3,12 +3,17 @@
 //	would be called the i-node).
 //
 //	The file header is used to locate where on disk the 
-//	file's data is stored.  We implement this as a fixed size
-//	table of pointers -- each entry in the table points to the 
-//	disk sector containing that portion of the file data
-//	(in other words, there are no indirect or doubly indirect 
-//	blocks). The table size is chosen so that the file header
-//	will be just big enough to fit in one disk sector, 
+//	file's data is stored.  We implement this as a table of extents
+//	-- each entry in the table gives the first disk sector, and the
+//	number of consecutive sectors, of the next portion of the file
+//	data.  As many extents as fit are in the file header's own
+//	sector; the rest are in an indirect block, and then in blocks
+//	listed by a doubly indirect block.
+//
+//	When we allocate a file's data blocks, we keep them in as few
+//	extents as we can, so that the file can be read and written
+//	with as few seeks as possible -- and so that most files have
+//	all their extents in the file header itself.
 //
 //      Unlike in a real system, we do not keep track of file permissions, 
 //	ownership, last modification date, etc., in the file header. 
@@ -32,7 +37,8 @@
 // 	Initialize a fresh file header for a newly created file.
 //	Allocate data blocks for the file out of the map of free disk blocks.
 //	Return FALSE if there are not enough free blocks to accomodate
-//	the new file.
+//	the new file -- or if the free blocks are so scattered that it
+//	would need more than MaxExtents extents.
 //
 //	"freeMap" is the bit map of free disk sectors
 //	"fileSize" is the bit map of free disk sectors
@@ -41,19 +47,122 @@
 bool
 FileHeader::Allocate(BitMap *freeMap, int fileSize)
 { 
+    numBytes = numSectors = numExtents = 0;
+    indirect = doubleIndirect = -1;
+    if (!Extend(freeMap, fileSize))
+	return FALSE;
     numBytes = fileSize;
-    numSectors  = divRoundUp(fileSize, SectorSize);
-    if (freeMap->NumClear() < numSectors)
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::Extend
+// 	Allocate enough more data blocks for the file to grow to
+//	"fileSize" bytes (its length doesn't change until SetLength).
+//	Return FALSE, with nothing changed, if there are not enough free
+//	blocks, or they are too scattered.
+//
+//	The new blocks keep on from the file's last sector, for as many
+//	of the sectors after it as are free.  For the rest, we take the
+//	first run of free sectors long enough for all of them; failing 
+//	that, the longest runs there are, one after another.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"fileSize" is how big the file is to be able to get
+//----------------------------------------------------------------------
+
+bool
+FileHeader::Extend(BitMap *freeMap, int fileSize)
+{
+    int oldSectors = numSectors, oldExtents = numExtents;
+    int oldIndirect = NumIndirect();
+    int oldLength = (numExtents > 0) ? extents[numExtents - 1].length : 0;
+    int left = divRoundUp(fileSize, SectorSize) - numSectors;
+    Extent *last;
+    int length;
+
+    if (left <= 0)
+	return TRUE;		// there's room already
+    if (freeMap->NumClear() < left)
 	return FALSE;		// not enough space
 
-    for (int i = 0; i < numSectors; i++)
-	dataSectors[i] = freeMap->Find();
+    if (numExtents > 0) {
+	last = &extents[numExtents - 1];
+	length = freeMap->MarkRun(last->start + last->length, left);
+	last->length += length;
+	numSectors += length;
+	left -= length;
+    }
+    while ((left > 0) && (numExtents < (int) MaxExtents)) {
+	extents[numExtents].start = freeMap->FindRun(left, &length);
+	extents[numExtents].length = length;
+	numExtents++;
+	numSectors += length;
+	left -= length;
+    }
+    if ((left == 0) && AllocateIndirect(freeMap, oldIndirect))
+	return TRUE;
+
+    // too scattered, or no room for the indirect blocks: give back
+    // the blocks we took
+    for (int i = oldSectors; i < numSectors; i++)
+	freeMap->Clear(ByteToSector(i * SectorSize));
+    numSectors = oldSectors;
+    numExtents = oldExtents;
+    if (numExtents > 0)
+	extents[numExtents - 1].length = oldLength;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// FileHeader::NumIndirect
+// 	Return the number of indirect blocks needed to hold the extents
+//	that don't fit in the file header proper: the first indirect
+//	block, and those listed in the doubly indirect block.
+//----------------------------------------------------------------------
+
+int
+FileHeader::NumIndirect()
+{
+    if (numExtents <= (int) NumDirect)
+	return 0;
+    return divRoundUp(numExtents - NumDirect, ExtentsPerSector);
+}
+
+//----------------------------------------------------------------------
+// FileHeader::AllocateIndirect
+// 	Allocate the sectors for any more indirect blocks the file's 
+//	extents need, and for the doubly indirect block, if it is needed
+//	now and wasn't before.  Return FALSE, allocating nothing, if there
+//	aren't enough free sectors.
+//
+//	"freeMap" is the bit map of free disk sectors
+//	"numAllocated" is how many indirect blocks the file already has
+//----------------------------------------------------------------------
+
+bool
+FileHeader::AllocateIndirect(BitMap *freeMap, int numAllocated)
+{
+    int needed = NumIndirect();
+    int more = needed - numAllocated;
+
+    if ((needed > 1) && (numAllocated <= 1))
+	more++;				// the doubly indirect block
+    if (freeMap->NumClear() < more)
+	return FALSE;
+    if ((needed > 0) && (numAllocated == 0))
+	indirect = freeMap->Find();
+    if ((needed > 1) && (numAllocated <= 1))
+	doubleIndirect = freeMap->Find();
+    for (int i = max(numAllocated - 1, 0); i < needed - 1; i++)
+	indirectSectors[i] = freeMap->Find();
     return TRUE;
 }
 
 //----------------------------------------------------------------------
 // FileHeader::Deallocate
-// 	De-allocate all the space allocated for data blocks for this file.
+// 	De-allocate all the space allocated for data blocks for this file,
+//	and for its indirect blocks.
 //
 //	"freeMap" is the bit map of free disk sectors
 //----------------------------------------------------------------------
@@ -61,15 +170,26 @@ FileHeader::Allocate(BitMap *freeMap, int fileSize)
 void 
 FileHeader::Deallocate(BitMap *freeMap)
 {
-    for (int i = 0; i < numSectors; i++) {
-	ASSERT(freeMap->Test((int) dataSectors[i]));  // ought to be marked!
-	freeMap->Clear((int) dataSectors[i]);
-    }
+    int i, j;
+
+    for (i = 0; i < numExtents; i++)
+	for (j = 0; j < extents[i].length; j++) {
+	    ASSERT(freeMap->Test(extents[i].start + j));  // ought to be marked!
+	    freeMap->Clear(extents[i].start + j);
+	}
+    if (indirect != -1)
+	freeMap->Clear(indirect);
+    if (doubleIndirect != -1)
+	freeMap->Clear(doubleIndirect);
+    for (i = 0; i < NumIndirect() - 1; i++)
+	freeMap->Clear(indirectSectors[i]);
 }
 
 //----------------------------------------------------------------------
 // FileHeader::FetchFrom
-// 	Fetch contents of file header from disk. 
+// 	Fetch contents of file header from disk: the header proper, and 
+//	the indirect blocks, if there are any, so that all the extents
+//	are in memory.
 //
 //	"sector" is the disk sector containing the file header
 //----------------------------------------------------------------------
@@ -77,12 +197,21 @@ FileHeader::Deallocate(BitMap *freeMap)
 void
 FileHeader::FetchFrom(int sector)
 {
-    synchDisk->ReadSector(sector, (char *)this);
+    bufferCache->ReadSector(sector, (char *)this);
+    if (indirect != -1)
+	bufferCache->ReadSector(indirect, (char *) &extents[NumDirect]);
+    if (doubleIndirect != -1) {
+	bufferCache->ReadSector(doubleIndirect, (char *) indirectSectors);
+	for (int i = 0; i < NumIndirect() - 1; i++)
+	    bufferCache->ReadSector(indirectSectors[i], 
+		(char *) &extents[NumDirect + (i + 1) * ExtentsPerSector]);
+    }
 }
 
 //----------------------------------------------------------------------
 // FileHeader::WriteBack
-// 	Write the modified contents of the file header back to disk. 
+// 	Write the modified contents of the file header back to disk,
+//	along with its indirect blocks.
 //
 //	"sector" is the disk sector to contain the file header
 //----------------------------------------------------------------------
@@ -90,7 +219,15 @@ FileHeader::FetchFrom(int sector)
 void
 FileHeader::WriteBack(int sector)
 {
-    synchDisk->WriteSector(sector, (char *)this); 
+    bufferCache->WriteSector(sector, (char *)this); 
+    if (indirect != -1)
+	bufferCache->WriteSector(indirect, (char *) &extents[NumDirect]);
+    if (doubleIndirect != -1) {
+	bufferCache->WriteSector(doubleIndirect, (char *) indirectSectors);
+	for (int i = 0; i < NumIndirect() - 1; i++)
+	    bufferCache->WriteSector(indirectSectors[i], 
+		(char *) &extents[NumDirect + (i + 1) * ExtentsPerSector]);
+    }
 }
 
 //----------------------------------------------------------------------
@@ -100,13 +237,24 @@ FileHeader::WriteBack(int sector)
 //	offset in the file) to a physical address (the sector where the
 //	data at the offset is stored).
 //
+//	We count through the extents to the one holding the byte's data
+//	block; there are seldom more than a few.
+//
 //	"offset" is the location within the file of the byte in question
 //----------------------------------------------------------------------
 
 int
 FileHeader::ByteToSector(int offset)
 {
-    return(dataSectors[offset / SectorSize]);
+    int block = offset / SectorSize;
+
+    for (int i = 0; i < numExtents; i++) {
+	if (block < extents[i].length)
+	    return extents[i].start + block;
+	block -= extents[i].length;
+    }
+    ASSERT(FALSE);			// past the end of the file
+    return -1;
 }
 
 //----------------------------------------------------------------------
@@ -120,6 +268,21 @@ FileHeader::FileLength()
     return numBytes;
 }
 
+//----------------------------------------------------------------------
+// FileHeader::SetLength
+// 	Change the number of bytes in the file, to no more than its data
+//	blocks can hold.
+//
+//	"fileSize" is the new length
+//----------------------------------------------------------------------
+
+void
+FileHeader::SetLength(int fileSize)
+{
+    ASSERT((fileSize >= 0) && (fileSize <= numSectors * SectorSize));
+    numBytes = fileSize;
+}
+
 //----------------------------------------------------------------------
 // FileHeader::Print
 // 	Print the contents of the file header, and the contents of all
@@ -133,11 +296,12 @@ FileHeader::Print()
     char *data = new char[SectorSize];
 
     printf("FileHeader contents.  File size: %d.  File blocks:\n", numBytes);
-    for (i = 0; i < numSectors; i++)
-	printf("%d ", dataSectors[i]);
+    for (i = 0; i < numExtents; i++)
+	printf("%d-%d ", extents[i].start, 
+				extents[i].start + extents[i].length - 1);
     printf("\nFile contents:\n");
     for (i = k = 0; i < numSectors; i++) {
-	synchDisk->ReadSector(dataSectors[i], data);
+	bufferCache->ReadSector(ByteToSector(i * SectorSize), data);
         for (j = 0; (j < SectorSize) && (k < numBytes); j++, k++) {
 	    if ('\040' <= data[j] && data[j] <= '\176')   // isprint(data[j])
 		printf("%c", data[j]);
@@ -17,19 +17,44 @@
 #include "disk.h"
 #include "bitmap.h"
 
-#define NumDirect 	((SectorSize - 2 * sizeof(int)) / sizeof(int))
-#define MaxFileSize 	(NumDirect * SectorSize)
+// The following class defines an "extent" -- a run of consecutive
+// disk sectors, holding consecutive data blocks of a file.
+
+class Extent {
+  public:
+    int start;				// the first sector of the run
+    int length;				// the # of sectors in it
+};
+
+#define NumDirect 	((SectorSize - 5 * sizeof(int)) / sizeof(Extent))
+#define ExtentsPerSector	(SectorSize / sizeof(Extent))
+#define SectorsPerIndex		(SectorSize / sizeof(int))
+#define MaxExtents	(NumDirect + ExtentsPerSector + \
+				SectorsPerIndex * ExtentsPerSector)
+#define MaxFileSize 	(MaxExtents * SectorSize)	// even if no two of
+							// its sectors are
+							// together
 
 // The following class defines the Nachos "file header" (in UNIX terms,  
 // the "i-node"), describing where on disk to find all of the data in the file.
-// The file header is organized as a simple table of pointers to
-// data blocks. 
+// The file header is organized as a table of extents: the file's
+// data blocks are in the first extent's sectors, then the second's,
+// and so on.
 //
 // The file header data structure can be stored in memory or on disk.
-// When it is on disk, it is stored in a single sector -- this means
-// that we assume the size of this data structure to be the same
-// as one disk sector.  Without indirect addressing, this
-// limits the maximum file length to just under 4K bytes.
+// When it is on disk, the header proper is stored in a single sector,
+// with room for the first NumDirect extents.  The next ExtentsPerSector
+// extents are in a sector of their own (the indirect block); and after
+// that, in further sectors, listed in another (the doubly indirect
+// block).  In memory, we keep all of the extents in one table.
+//
+// A file can grow: its new data blocks follow on from its last one, if
+// those sectors are free, or else are in new extents.
+//
+// Since the allocator keeps a file's sectors together whenever it can,
+// a file usually has only a few extents, and can be nearly as big as the
+// disk.  MaxFileSize is how big a file can be if every one of its data
+// blocks is in an extent of its own.
 //
 // There is no constructor; rather the file header can be initialized
 // by allocating blocks for the file (if it is a new file), or by
@@ -40,6 +65,9 @@ class FileHeader {
     bool Allocate(BitMap *bitMap, int fileSize);// Initialize a file header, 
 						//  including allocating space 
 						//  on disk for the file data
+    bool Extend(BitMap *bitMap, int fileSize);	// Allocate more space, so
+						//  the file can grow to
+						//  "fileSize" bytes
     void Deallocate(BitMap *bitMap);  		// De-allocate this file's 
 						//  data blocks
 
@@ -53,14 +81,35 @@ class FileHeader {
 
     int FileLength();			// Return the length of the file 
 					// in bytes
+    void SetLength(int fileSize);	// Change it, within the space
+					// allocated for the file
 
     void Print();			// Print the contents of the file.
 
   private:
+    int NumIndirect();			// # of indirect blocks the extents
+					// need, counting the first
+    bool AllocateIndirect(BitMap *bitMap, int numAllocated);
+					// Allocate sectors for them, besides
+					// the "numAllocated" we already have
+
+// These first fields are the header proper, as it is on disk
     int numBytes;			// Number of bytes in the file
     int numSectors;			// Number of data sectors in the file
-    int dataSectors[NumDirect];		// Disk sector numbers for each data 
-					// block in the file
+    int numExtents;			// Number of extents they are in
+    int indirect;			// Sector of the indirect block, or
+					// -1 if there aren't that many
+					// extents
+    int doubleIndirect;			// Sector of the doubly indirect
+					// block, or -1
+    Extent extents[MaxExtents];		// Where the data blocks are: the
+					// first NumDirect are on disk in
+					// the header proper
+
+    int indirectSectors[SectorsPerIndex];
+					// The contents of the doubly indirect
+					// block: the sectors of the indirect
+					// blocks after the first
 };
 
 #endif // FILEHDR_H
@@ -19,20 +19,31 @@
 //	on bootup.
 //
 //	The file system assumes that the bitmap and directory files are
-//	kept "open" continuously while Nachos is running.
+//	kept "open" continuously while Nachos is running.  The bitmap is
+//	kept in memory as well.
 //
 //	For those operations (such as Create, Remove) that modify the
 //	directory and/or bitmap, if the operation succeeds, the changes
-//	are written immediately back to disk (the two files are kept
-//	open during all this time).  If the operation fails, and we have
-//	modified part of the directory and/or bitmap, we simply discard
-//	the changed version, without writing it back to disk.
+//	are written immediately back to disk, by way of the buffer cache 
+//	(the two files are kept open during all this time).  If the 
+//	operation fails, and we have modified part of the directory, we
+//	simply discard the changed version, without writing it back to
+//	disk; we undo any change to the bitmap.
+//
+//	Files grow when they are written past their end.  Every OpenFile
+//	of a file shares one copy of its header, in memory; growing the 
+//	file changes that copy, and the bitmap, and they are only written
+//	back when the file is last closed (or by the next Create or Remove,
+//	for the bitmap) -- rather than every time the file grows.
 //
 // 	Our implementation at this point has the following restrictions:
 //
-//	   there is no synchronization for concurrent accesses
-//	   files have a fixed size, set when the file is created
-//	   files cannot be bigger than about 3KB in size
+//	   the directory, bitmap and file headers are only used by one
+//	     thread at a time, but nothing stops concurrent writes to the
+//	     same part of a file from being interleaved
+//	   a file can't be removed while it is open
+//	   files cannot be bigger than the free space on the disk, or if
+//	     it is badly fragmented, than MaxFileSize
 //	   there is no hierarchical directory structure, and only a limited
 //	     number of files can be added to the system
 //	   there is no attempt to make the system robust to failures
@@ -42,28 +53,32 @@
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
-
+     
 #include "copyright.h"
-
+     
 #include "disk.h"
 #include "bitmap.h"
 #include "directory.h"
 #include "filehdr.h"
 #include "filesys.h"
-
+#include "system.h"
+#include "synch.h"
+     
+#include <strings.h>
+     
 // Sectors containing the file headers for the bitmap of free sectors,
 // and the directory of files.  These file headers are placed in well-known 
 // sectors, so that they can be located on boot-up.
 #define FreeMapSector 		0
 #define DirectorySector 	1
-
+     
 // Initial file sizes for the bitmap and directory; until the file system
 // supports extensible files, the directory size sets the maximum number 
 // of files that can be loaded onto the disk.
 #define FreeMapFileSize 	(NumSectors / BitsInByte)
 #define NumDirEntries 		10
 #define DirectoryFileSize 	(sizeof(DirectoryEntry) * NumDirEntries)
-
+     
 //----------------------------------------------------------------------
 // FileSystem::FileSystem
 // 	Initialize the file system.  If format = TRUE, the disk has
@@ -76,60 +91,70 @@
 //
 //	"format" -- should we initialize the disk?
 //----------------------------------------------------------------------
-
+     
 FileSystem::FileSystem(bool format)
 { 
     DEBUG('f', "Initializing the file system.\n");
+    freeMap = new BitMap(NumSectors);
+    freeMapDirty = FALSE;
+    headers = new FileHeader *[NumSectors];
+    opens = new int[NumSectors];
+    headerDirty = new bool[NumSectors];
+    for (int i = 0; i < NumSectors; i++) {
+	headers[i] = NULL;
+	opens[i] = 0;
+	headerDirty[i] = FALSE;
+    }
+    lock = new Lock("file system");
     if (format) {
-        BitMap *freeMap = new BitMap(NumSectors);
         Directory *directory = new Directory(NumDirEntries);
 	FileHeader *mapHdr = new FileHeader;
 	FileHeader *dirHdr = new FileHeader;
-
+     
         DEBUG('f', "Formatting the file system.\n");
-
+     
     // First, allocate space for FileHeaders for the directory and bitmap
     // (make sure no one else grabs these!)
 	freeMap->Mark(FreeMapSector);	    
 	freeMap->Mark(DirectorySector);
-
+     
     // Second, allocate space for the data blocks containing the contents
     // of the directory and bitmap files.  There better be enough space!
-
+     
 	ASSERT(mapHdr->Allocate(freeMap, FreeMapFileSize));
 	ASSERT(dirHdr->Allocate(freeMap, DirectoryFileSize));
-
+     
     // Flush the bitmap and directory FileHeaders back to disk
     // We need to do this before we can "Open" the file, since open
     // reads the file header off of disk (and currently the disk has garbage
     // on it!).
-
+     
         DEBUG('f', "Writing headers back to disk.\n");
 	mapHdr->WriteBack(FreeMapSector);    
 	dirHdr->WriteBack(DirectorySector);
-
+     
     // OK to open the bitmap and directory files now
     // The file system operations assume these two files are left open
     // while Nachos is running.
-
-        freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+     
+        freeMapFile = new OpenFile(FreeMapSector, Attach(FreeMapSector));
+        directoryFile = new OpenFile(DirectorySector, 
+					Attach(DirectorySector));
      
     // Once we have the files "open", we can write the initial version
     // of each file back to disk.  The directory at this point is completely
     // empty; but the bitmap has been changed to reflect the fact that
     // sectors on the disk have been allocated for the file headers and
     // to hold the file data for the directory and bitmap.
-
+     
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
 	freeMap->WriteBack(freeMapFile);	 // flush changes to disk
 	directory->WriteBack(directoryFile);
-
+     
 	if (DebugIsEnabled('f')) {
 	    freeMap->Print();
 	    directory->Print();
-
-        delete freeMap; 
+     
 	delete directory; 
 	delete mapHdr; 
 	delete dirHdr;
@@ -137,16 +162,153 @@ FileSystem::FileSystem(bool format)
     } else {
     // if we are not formatting the disk, just open the files representing
     // the bitmap and directory; these are left open while Nachos is running
-        freeMapFile = new OpenFile(FreeMapSector);
-        directoryFile = new OpenFile(DirectorySector);
+        freeMapFile = new OpenFile(FreeMapSector, Attach(FreeMapSector));
+        directoryFile = new OpenFile(DirectorySector, 
+					Attach(DirectorySector));
+	freeMap->FetchFrom(freeMapFile);
+    }
+} 
+     
+//----------------------------------------------------------------------
+// FileSystem::~FileSystem
+// 	Nachos is halting: write back the headers of the files that are
+//	still open, if they have changed, and the bitmap.  (Their
+//	OpenFiles are never closed.)
+//----------------------------------------------------------------------
+     
+FileSystem::~FileSystem()
+{ 
+    for (int i = 0; i < NumSectors; i++)
+	if (headerDirty[i])
+	    headers[i]->WriteBack(i);
+    if (freeMapDirty)
+	freeMap->WriteBack(freeMapFile);
+    delete freeMap;
+    delete lock;
+} 
+     
+//----------------------------------------------------------------------
+// FileSystem::Attach
+// 	Return the header of a file that is being opened, reading it
+//	from disk unless the file is already open, in which case its
+//	OpenFiles share the copy in memory.  The caller holds the lock
+//	(or is the constructor).
+//
+//	"sector" -- where the header is on disk
+//----------------------------------------------------------------------
+     
+FileHeader *
+FileSystem::Attach(int sector)
+{ 
+    if (headers[sector] == NULL) {
+	headers[sector] = new FileHeader;
+	headers[sector]->FetchFrom(sector);
+    }
+    opens[sector]++;
+    return headers[sector];
+} 
+     
+//----------------------------------------------------------------------
+// FileSystem::Close
+// 	An OpenFile is done with the header of its file.  When the last 
+//	one is, write the header back to disk if the file has grown, along
+//	with the bitmap, and forget it.
+//
+//	"sector" -- where the header is on disk
+//----------------------------------------------------------------------
+     
+void
+FileSystem::Close(int sector)
+{ 
+    lock->Acquire();
+    ASSERT(opens[sector] > 0);
+    if (--opens[sector] == 0) {
+	if (headerDirty[sector]) {
+	    if (freeMapDirty)
+		freeMap->WriteBack(freeMapFile);
+	    freeMapDirty = FALSE;
+	    headers[sector]->WriteBack(sector);
+	    headerDirty[sector] = FALSE;
+	}
+	delete headers[sector];
+	headers[sector] = NULL;
+    }
+    lock->Release();
+} 
+     
+//----------------------------------------------------------------------
+// FileSystem::Extend
+// 	Make an open file "length" bytes long (if it isn't already), so
+//	that a write can go past its end.  Return FALSE if there isn't
+//	room on the disk.
+//
+//	Everything new in the file is zeroed first, so that if the write 
+//	starts past the end, the bytes in between read as zeroes.  The
+//	file only gets longer once they are -- so that a write into that
+//	part of the file, by another thread, has to wait for us here
+//	first, rather than be zeroed.
+//
+//	"sector" -- where the file's header is on disk
+//	"length" -- where the write ends
+//----------------------------------------------------------------------
+     
+bool
+FileSystem::Extend(int sector, int length)
+{ 
+    FileHeader *hdr = headers[sector];
+    int oldLength;
+    bool success = TRUE;
+     
+    lock->Acquire();
+    oldLength = hdr->FileLength();
+    if (length > oldLength) {
+	if (!hdr->Extend(freeMap, length))
+	    success = FALSE;		// no space on disk
+	else {
+	    DEBUG('f', "Extending file at sector %d from %d to %d bytes\n",
+			sector, oldLength, length);
+	    ZeroFill(hdr, oldLength, 
+			divRoundUp(length, SectorSize) * SectorSize);
+	    hdr->SetLength(length);
+	    headerDirty[sector] = freeMapDirty = TRUE;
+	}
+    }
+    lock->Release();
+    return success;
+} 
+     
+//----------------------------------------------------------------------
+// FileSystem::ZeroFill
+// 	Zero the bytes of a file from "from" up to "to", in the buffer
+//	cache.  Only a sector we zero part of can have data in it that we
+//	have to keep; the others are new, so we need not read them first.
+//
+//	"hdr" -- the file's header
+//	"from", "to" -- the bytes to zero
+//----------------------------------------------------------------------
+     
+void
+FileSystem::ZeroFill(FileHeader *hdr, int from, int to)
+{ 
+    char zeroes[SectorSize];
+    int offset, count;
+     
+    bzero(zeroes, SectorSize);
+    for (; from < to; from += count) {
+	offset = from % SectorSize;
+	count = min(SectorSize - offset, to - from);
+	if (count == SectorSize)
+	    bufferCache->Zero(hdr->ByteToSector(from));
+	else
+	    bufferCache->Write(hdr->ByteToSector(from), zeroes, offset, count);
     }
-}
-
+} 
+     
 //----------------------------------------------------------------------
 // FileSystem::Create
 // 	Create a file in the Nachos file system (similar to UNIX create).
-//	Since we can't increase the size of files dynamically, we have
-//	to give Create the initial size of the file.
+//	We give Create the initial size of the file; it can grow later,
+//	as it is written.
 //
 //	The steps to create a file are:
 //	  Make sure the file doesn't already exist
@@ -170,50 +332,51 @@ FileSystem::FileSystem(bool format)
 //	"name" -- name of file to be created
 //	"initialSize" -- size of file to be created
 //----------------------------------------------------------------------
-
+     
 bool
 FileSystem::Create(char *name, int initialSize)
-{
+{ 
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *hdr;
     int sector;
     bool success;
-
+     
     DEBUG('f', "Creating file %s, size %d\n", name, initialSize);
-
+     
+    lock->Acquire();
     directory = new Directory(NumDirEntries);
     directory->FetchFrom(directoryFile);
-
+     
     if (directory->Find(name) != -1)
       success = FALSE;			// file is already in directory
     else {	
-        freeMap = new BitMap(NumSectors);
-        freeMap->FetchFrom(freeMapFile);
         sector = freeMap->Find();	// find a sector to hold the file header
     	if (sector == -1) 		
             success = FALSE;		// no free block for file header 
-        else if (!directory->Add(name, sector))
+        else if (!directory->Add(name, sector)) {
             success = FALSE;	// no space in directory
-	else {
+	    freeMap->Clear(sector);
+	} else {
     	    hdr = new FileHeader;
-	    if (!hdr->Allocate(freeMap, initialSize))
+	    if (!hdr->Allocate(freeMap, initialSize)) {
             	success = FALSE;	// no space on disk for data
-	    else {	
+		freeMap->Clear(sector);
+	    } else {	
 	    	success = TRUE;
 		// everthing worked, flush all changes back to disk
     	    	hdr->WriteBack(sector); 		
     	    	directory->WriteBack(directoryFile);
     	    	freeMap->WriteBack(freeMapFile);
+		freeMapDirty = FALSE;
 	    }
             delete hdr;
 	}
-        delete freeMap;
     }
     delete directory;
+    lock->Release();
     return success;
-}
-
+} 
+     
 //----------------------------------------------------------------------
 // FileSystem::Open
 // 	Open a file for reading and writing.  
@@ -223,23 +386,25 @@ FileSystem::Create(char *name, int initialSize)
 //
 //	"name" -- the text name of the file to be opened
 //----------------------------------------------------------------------
-
+     
 OpenFile *
 FileSystem::Open(char *name)
 { 
     Directory *directory = new Directory(NumDirEntries);
     OpenFile *openFile = NULL;
     int sector;
-
+     
     DEBUG('f', "Opening file %s\n", name);
+    lock->Acquire();
     directory->FetchFrom(directoryFile);
     sector = directory->Find(name); 
-    if (sector >= 0) 		
-	openFile = new OpenFile(sector);	// name was found in directory 
+    if (sector >= 0) 		// name was found in directory 
+	openFile = new OpenFile(sector, Attach(sector));
+    lock->Release();
     delete directory;
     return openFile;				// return NULL if not found
-}
-
+} 
+     
 //----------------------------------------------------------------------
 // FileSystem::Remove
 // 	Delete a file from the file system.  This requires:
@@ -249,59 +414,60 @@ FileSystem::Open(char *name)
 //	    Write changes to directory, bitmap back to disk
 //
 //	Return TRUE if the file was deleted, FALSE if the file wasn't
-//	in the file system.
+//	in the file system, or is open.
 //
 //	"name" -- the text name of the file to be removed
 //----------------------------------------------------------------------
-
+     
 bool
 FileSystem::Remove(char *name)
 { 
     Directory *directory;
-    BitMap *freeMap;
     FileHeader *fileHdr;
     int sector;
     
+    lock->Acquire();
     directory = new Directory(NumDirEntries);
     directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
-    if (sector == -1) {
+    sector = directory->Find(name); 
+    if ((sector == -1) || (opens[sector] > 0)) {
        delete directory;
-       return FALSE;			 // file not found 
+       lock->Release();
+       return FALSE;			 // file not found, or in use
     }
     fileHdr = new FileHeader;
     fileHdr->FetchFrom(sector);
-
-    freeMap = new BitMap(NumSectors);
-    freeMap->FetchFrom(freeMapFile);
-
+     
     fileHdr->Deallocate(freeMap);  		// remove data blocks
     freeMap->Clear(sector);			// remove header block
     directory->Remove(name);
-
+     
     freeMap->WriteBack(freeMapFile);		// flush to disk
+    freeMapDirty = FALSE;
     directory->WriteBack(directoryFile);        // flush to disk
     delete fileHdr;
     delete directory;
-    delete freeMap;
+    lock->Release();
     return TRUE;
 } 
-
+     
 //----------------------------------------------------------------------
 // FileSystem::List
 // 	List all the files in the file system directory.
 //----------------------------------------------------------------------
-
+     
 void
 FileSystem::List()
-{
+{ 
     Directory *directory = new Directory(NumDirEntries);
-
+     
+    lock->Acquire();
     directory->FetchFrom(directoryFile);
     directory->List();
+    lock->Release();
     delete directory;
-}
-
+} 
+     
 //----------------------------------------------------------------------
 // FileSystem::Print
 // 	Print everything about the file system:
@@ -311,31 +477,29 @@ FileSystem::List()
 //	      the contents of the file header
 //	      the data in the file
 //----------------------------------------------------------------------
-
+     
 void
 FileSystem::Print()
-{
+{ 
     FileHeader *bitHdr = new FileHeader;
     FileHeader *dirHdr = new FileHeader;
-    BitMap *freeMap = new BitMap(NumSectors);
     Directory *directory = new Directory(NumDirEntries);
-
+     
     printf("Bit map file header:\n");
     bitHdr->FetchFrom(FreeMapSector);
     bitHdr->Print();
-
+     
     printf("Directory file header:\n");
     dirHdr->FetchFrom(DirectorySector);
     dirHdr->Print();
-
-    freeMap->FetchFrom(freeMapFile);
+     
     freeMap->Print();
-
+     
     directory->FetchFrom(directoryFile);
     directory->Print();
-
+     
     delete bitHdr;
     delete dirHdr;
-    delete freeMap;
     delete directory;
 } 
+     
\ No newline at end of file
@@ -65,6 +65,10 @@ class FileSystem {
 };
 
 #else // FILESYS
+class BitMap;
+class FileHeader;
+class Lock;
+
 class FileSystem {
   public:
     FileSystem(bool format);		// Initialize the file system.
@@ -73,6 +77,7 @@ class FileSystem {
     					// If "format", there is nothing on
 					// the disk, so initialize the directory
     					// and the bitmap of free blocks.
+    ~FileSystem();			// Write back what hasn't been yet
 
     bool Create(char *name, int initialSize);  	
 					// Create a file (UNIX creat)
@@ -85,11 +90,30 @@ class FileSystem {
 
     void Print();			// List all the files and their contents
 
+    bool Extend(int sector, int length);	// Make the open file whose
+					// header is at "sector" "length"
+					// bytes long
+    void Close(int sector);		// An OpenFile of that file is done
+
   private:
+    FileHeader *Attach(int sector);	// Share the header of an open file
+    void ZeroFill(FileHeader *hdr, int from, int to);
+					// Zero part of a file
+
    OpenFile* freeMapFile;		// Bit map of free disk blocks,
 					// represented as a file
    OpenFile* directoryFile;		// "Root" directory -- list of 
 					// file names, represented as a file
+   BitMap *freeMap;			// The bit map, kept in memory
+   bool freeMapDirty;			// Has it changed since it was last
+					// written back?
+   FileHeader **headers;		// The header of each open file, by
+					// the sector it is in, or NULL
+   int *opens;				// # of OpenFiles sharing each
+   bool *headerDirty;			// Has it changed since it was last
+					// written back?
+   Lock *lock;				// Only one thread at a time may use
+					// any of the above
 };
 
 #endif // FILESYS
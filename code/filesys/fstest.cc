@@ -100,11 +100,13 @@ Print(char *name)
 // PerformanceTest
 // 	Stress the Nachos file system by creating a large file, writing
 //	it out a bit at a time, reading it back a bit at a time, and then
-//	deleting the file.
+//	deleting the file.  Then check that flushing the buffer cache
+//	gets along with the flusher.
 //
-//	Implemented as three separate routines:
+//	Implemented as four separate routines:
 //	  FileWrite -- write the file
 //	  FileRead -- read the file
+//	  DirtyFlush -- flush with the flusher woken
 //	  PerformanceTest -- overall control, and print out performance #'s
 //----------------------------------------------------------------------
 
@@ -169,6 +171,37 @@ FileRead()
     delete openFile;	// close file
 }
 
+//----------------------------------------------------------------------
+// DirtyFlush
+// 	Dirty more than FlushThreshold buffers, which wakes the flusher,
+//	and flush them before it gets to run -- as Cleanup does, if Nachos
+//	halts just then.  The flusher must wait for us to write them back,
+//	not spin.
+//----------------------------------------------------------------------
+
+#define DirtyName	"DirtyFile"
+
+static void
+DirtyFlush()
+{
+    OpenFile *openFile;
+    char sector[SectorSize];
+
+    printf("Flushing %d dirty sectors\n", FlushThreshold + 1);
+    if (!fileSystem->Create(DirtyName, 0) ||
+		((openFile = fileSystem->Open(DirtyName)) == NULL)) {
+	printf("Perf test: can't create %s\n", DirtyName);
+	return;
+    }
+    memset(sector, 'x', SectorSize);
+    for (int i = 0; i <= FlushThreshold; i++)
+	openFile->Write(sector, SectorSize);
+    bufferCache->Flush();
+    delete openFile;
+    if (!fileSystem->Remove(DirtyName))
+	printf("Perf test: unable to remove %s\n", DirtyName);
+}
+
 void
 PerformanceTest()
 {
@@ -180,6 +213,8 @@ PerformanceTest()
       printf("Perf test: unable to remove %s\n", FileName);
       return;
     }
+    bufferCache->Flush();		// count the writes the cache has put off
     stats->Print();
+    DirtyFlush();
 }
 
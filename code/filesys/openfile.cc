@@ -21,28 +21,31 @@
 
 //----------------------------------------------------------------------
 // OpenFile::OpenFile
-// 	Open a Nachos file for reading and writing.  Bring the file header
-//	into memory while the file is open.
+// 	Open a Nachos file for reading and writing.  The file system 
+//	brings the file header into memory while the file is open.
 //
 //	"sector" -- the location on disk of the file header for this file
+//	"header" -- the file header, in memory
 //----------------------------------------------------------------------
 
-OpenFile::OpenFile(int sector)
+OpenFile::OpenFile(int sector, FileHeader *header)
 { 
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = header;
+    hdrSector = sector;
     seekPosition = 0;
-}
+    nextPosition = window = aheadTo = 0;
+}	
 
 //----------------------------------------------------------------------
 // OpenFile::~OpenFile
-// 	Close a Nachos file, de-allocating any in-memory data structures.
+// 	Close a Nachos file; the file system de-allocates the header
+//	once the file's last OpenFile is closed.
 //----------------------------------------------------------------------
 
 OpenFile::~OpenFile()
-{
-    delete hdr;
-}
+{ 
+    fileSystem->Close(hdrSector);
+}	
 
 //----------------------------------------------------------------------
 // OpenFile::Seek
@@ -54,7 +57,7 @@ OpenFile::~OpenFile()
 
 void
 OpenFile::Seek(int position)
-{
+{ 
     seekPosition = position;
 }	
 
@@ -73,19 +76,19 @@ OpenFile::Seek(int position)
 
 int
 OpenFile::Read(char *into, int numBytes)
-{
+{ 
    int result = ReadAt(into, numBytes, seekPosition);
    seekPosition += result;
    return result;
-}
+}	
 
 int
 OpenFile::Write(char *into, int numBytes)
-{
+{ 
    int result = WriteAt(into, numBytes, seekPosition);
    seekPosition += result;
    return result;
-}
+}	
 
 //----------------------------------------------------------------------
 // OpenFile::ReadAt/WriteAt
@@ -95,16 +98,14 @@ OpenFile::Write(char *into, int numBytes)
 //
 //	There is no guarantee the request starts or ends on an even disk sector
 //	boundary; however the disk only knows how to read/write a whole disk
-//	sector at a time.  Thus:
+//	sector at a time.  So we go through the buffer cache, a sector at
+//	a time, reading or writing just the part of each sector that is
+//	in the request; the cache reads in a sector we only write part of,
+//	if it doesn't have it already.
 //
-//	For ReadAt:
-//	   We read in all of the full or partial sectors that are part of the
-//	   request, but we only copy the part we are interested in.
-//	For WriteAt:
-//	   We must first read in any sectors that will be partially written,
-//	   so that we don't overwrite the unmodified portion.  We then copy
-//	   in the data that will be modified, and write back all the full
-//	   or partial sectors that are part of the request.
+//	For ReadAt, we then guess what will be read next, and ask for it
+//	to be read ahead.  For WriteAt, if the request goes past the end
+//	of the file, we first make the file longer.
 //
 //	"into" -- the buffer to contain the data to be read from disk 
 //	"from" -- the buffer containing the data to be written to disk 
@@ -115,10 +116,9 @@ OpenFile::Write(char *into, int numBytes)
 
 int
 OpenFile::ReadAt(char *into, int numBytes, int position)
-{
+{ 
     int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    char *buf;
+    int done, offset, count;
 
     if ((numBytes <= 0) || (position >= fileLength))
     	return 0; 				// check request
@@ -127,62 +127,73 @@ OpenFile::ReadAt(char *into, int numBytes, int position)
     DEBUG('f', "Reading %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    // read in all the full and partial sectors that we need
-    buf = new char[numSectors * SectorSize];
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->ReadSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-
-    // copy the part we want
-    bcopy(&buf[position - (firstSector * SectorSize)], into, numBytes);
-    delete [] buf;
+    for (done = 0; done < numBytes; done += count) {
+	offset = (position + done) % SectorSize;
+	count = min(SectorSize - offset, numBytes - done);
+	bufferCache->Read(hdr->ByteToSector(position + done), &into[done],
+				offset, count);
+    }
+    ReadAhead(position, numBytes);
     return numBytes;
-}
+}	
 
 int
 OpenFile::WriteAt(char *from, int numBytes, int position)
-{
-    int fileLength = hdr->FileLength();
-    int i, firstSector, lastSector, numSectors;
-    bool firstAligned, lastAligned;
-    char *buf;
+{ 
+    int fileLength;
+    int done, offset, count;
 
-    if ((numBytes <= 0) || (position >= fileLength))
+    if ((numBytes <= 0) || (position < 0))
 	return 0;				// check request
-    if ((position + numBytes) > fileLength)
+    if ((position + numBytes) > hdr->FileLength())	// grow the file, if
+	fileSystem->Extend(hdrSector, position + numBytes);
+							// there's room
+    fileLength = hdr->FileLength();
+    if (position >= fileLength)
+	return 0;				// there wasn't
+    if ((position + numBytes) > fileLength)		
 	numBytes = fileLength - position;
     DEBUG('f', "Writing %d bytes at %d, from file of length %d.\n", 	
 			numBytes, position, fileLength);
 
-    firstSector = divRoundDown(position, SectorSize);
-    lastSector = divRoundDown(position + numBytes - 1, SectorSize);
-    numSectors = 1 + lastSector - firstSector;
-
-    buf = new char[numSectors * SectorSize];
-
-    firstAligned = (position == (firstSector * SectorSize));
-    lastAligned = ((position + numBytes) == ((lastSector + 1) * SectorSize));
-
-// read in first and last sector, if they are to be partially modified
-    if (!firstAligned)
-        ReadAt(buf, SectorSize, firstSector * SectorSize);	
-    if (!lastAligned && ((firstSector != lastSector) || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SectorSize], 
-				SectorSize, lastSector * SectorSize);	
+    for (done = 0; done < numBytes; done += count) {
+	offset = (position + done) % SectorSize;
+	count = min(SectorSize - offset, numBytes - done);
+	bufferCache->Write(hdr->ByteToSector(position + done), &from[done],
+				offset, count);
+    }
+    return numBytes;
+}	
 
-// copy in the bytes we want to change 
-    bcopy(from, &buf[position - (firstSector * SectorSize)], numBytes);
+//----------------------------------------------------------------------
+// OpenFile::ReadAhead
+// 	Called after each read.  If the file is being read in order --
+//	this read starts where the last one ended -- ask the buffer cache
+//	to start reading the sectors that come next, before they are
+//	asked for.  The longer the file is read in order, the further
+//	ahead we read, up to MaxReadAhead sectors; a read anywhere else
+//	stops us reading ahead, until the reads are in order again.
+//
+//	"position" -- where the read started
+//	"numBytes" -- how much was read
+//----------------------------------------------------------------------
 
-// write modified sectors back
-    for (i = firstSector; i <= lastSector; i++)	
-        synchDisk->WriteSector(hdr->ByteToSector(i * SectorSize), 
-					&buf[(i - firstSector) * SectorSize]);
-    delete [] buf;
-    return numBytes;
+void
+OpenFile::ReadAhead(int position, int numBytes)
+{
+    int next, last;
+
+    if (position != nextPosition) {
+	window = aheadTo = 0;		// not in order
+	nextPosition = position + numBytes;
+	return;
+    }
+    window = (window == 0) ? MinReadAhead : min(2 * window, MaxReadAhead);
+    nextPosition = position + numBytes;
+    next = divRoundUp(nextPosition, SectorSize);
+    last = min(next + window, divRoundUp(hdr->FileLength(), SectorSize));
+    for (aheadTo = max(aheadTo, next); aheadTo < last; aheadTo++)
+	bufferCache->Prefetch(hdr->ByteToSector(aheadTo * SectorSize));
 }
 
 //----------------------------------------------------------------------
@@ -194,4 +205,4 @@ int
 OpenFile::Length() 
 { 
     return hdr->FileLength(); 
-}
+}	
@@ -16,13 +16,13 @@
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
-
+    
 #ifndef OPENFILE_H
 #define OPENFILE_H
-
+    
 #include "copyright.h"
 #include "utility.h"
-
+    
 #ifdef FILESYS_STUB			// Temporarily implement calls to 
 					// Nachos file system as calls to UNIX!
 					// See definitions listed under #else
@@ -30,7 +30,7 @@ class OpenFile {
   public:
     OpenFile(int f) { file = f; currentOffset = 0; }	// open the file
     ~OpenFile() { Close(file); }			// close the file
-
+    
     int ReadAt(char *into, int numBytes, int position) { 
     		Lseek(file, position, 0); 
 		return ReadPartial(file, into, numBytes); 
@@ -49,48 +49,73 @@ class OpenFile {
 		int numWritten = WriteAt(from, numBytes, currentOffset); 
 		currentOffset += numWritten;
 		return numWritten;
-		}
-
+		}	
+    
     int Length() { Lseek(file, 0, 2); return Tell(file); }
+    int Identity() { return FileNumber(file); }
+    int Device() { return FileDevice(file); }
     
   private:
     int file;
     int currentOffset;
 };
-
+    
 #else // FILESYS
 class FileHeader;
-
+    
+#define MinReadAhead	2	// sectors to read ahead, once a file is
+				// read sequentially
+#define MaxReadAhead	8	// the most, after it has been for a while
+    
 class OpenFile {
   public:
-    OpenFile(int sector);		// Open a file whose header is located
-					// at "sector" on the disk
+    OpenFile(int sector, FileHeader *header);
+					// Open a file whose header is located
+					// at "sector" on the disk, and is
+					// "header" in memory
     ~OpenFile();			// Close the file
-
+    
     void Seek(int position); 		// Set the position from which to 
 					// start reading/writing -- UNIX lseek
-
+    
     int Read(char *into, int numBytes); // Read/write bytes from the file,
 					// starting at the implicit position.
 					// Return the # actually read/written,
 					// and increment position in file.
     int Write(char *from, int numBytes);
-
+    
     int ReadAt(char *into, int numBytes, int position);
     					// Read/write bytes from the file,
 					// bypassing the implicit position.
     int WriteAt(char *from, int numBytes, int position);
-
+    
     int Length(); 			// Return the number of bytes in the
 					// file (this interface is simpler 
 					// than the UNIX idiom -- lseek to 
 					// end of file, tell, lseek back 
+    int Identity() { return hdrSector; }	// Which file this is: the
+					// same for every OpenFile of the
+					// same file
+    int Device() { return 0; }		// Which disk it is on; there is
+					// only the one
     
   private:
-    FileHeader *hdr;			// Header for this file 
+    FileHeader *hdr;			// Header for this file, shared with
+					// its other OpenFiles
+    int hdrSector;			// Where the header is on disk
     int seekPosition;			// Current position within the file
+    
+    void ReadAhead(int position, int numBytes);
+					// Guess what will be read next
+    int nextPosition;			// Where the next read starts, if the
+					// file is being read sequentially
+    int window;				// # of sectors to read ahead, or 0 if
+					// the file isn't being read in order
+    int aheadTo;			// The sectors before this one (in the
+					// file) have been read or asked for
 };
-
+    
 #endif // FILESYS
-
+    
 #endif // OPENFILE_H
+    
\ No newline at end of file
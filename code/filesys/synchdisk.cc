@@ -5,10 +5,14 @@
 //	the disk providing a synchronous interface (requests wait until
 //	the request completes).
 //
-//	Use a semaphore to synchronize the interrupt handlers with the
-//	pending requests.  And, because the physical disk can only
-//	handle one operation at a time, use a lock to enforce mutual
-//	exclusion.
+//	Any number of threads may ask for a sector at once, but the
+//	physical disk can only handle one operation at a time.  So each
+//	request is queued, and the thread waits on a semaphore until it
+//	is done.  Whenever the disk is free, the next request is chosen
+//	according to the scheduling policy, to keep the head from moving
+//	back and forth across the disk.  The interrupt handler starts the
+//	next request, so the queue is protected by turning off interrupts,
+//	rather than by a lock.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -16,6 +20,7 @@
 
 #include "copyright.h"
 #include "synchdisk.h"
+#include "system.h"
 
 //----------------------------------------------------------------------
 // DiskRequestDone
@@ -31,6 +36,20 @@ DiskRequestDone (int arg)
     disk->RequestDone();
 }
 
+//----------------------------------------------------------------------
+// TrackDistance
+// 	Return how many tracks the head moves to get from one sector to
+//	another.
+//----------------------------------------------------------------------
+
+static int
+TrackDistance(int from, int to)
+{
+    int distance = to / SectorsPerTrack - from / SectorsPerTrack;
+
+    return (distance < 0) ? -distance : distance;
+}
+
 //----------------------------------------------------------------------
 // SynchDisk::SynchDisk
 // 	Initialize the synchronous interface to the physical disk, in turn
@@ -38,12 +57,15 @@ DiskRequestDone (int arg)
 //
 //	"name" -- UNIX file name to be used as storage for the disk data
 //	   (usually, "DISK")
+//	"which" -- how to choose the next request to give the disk
 //----------------------------------------------------------------------
 
-SynchDisk::SynchDisk(char* name)
+SynchDisk::SynchDisk(char* name, DiskScheduling which)
 {
-    semaphore = new Semaphore("synch disk", 0);
-    lock = new Lock("synch disk lock");
+    scheduling = which;
+    waiting = active = NULL;
+    numWaiting = 0;
+    headSector = 0;
     disk = new Disk(name, DiskRequestDone, (int) this);
 }
 
@@ -56,8 +78,6 @@ SynchDisk::SynchDisk(char* name)
 SynchDisk::~SynchDisk()
 {
     delete disk;
-    delete lock;
-    delete semaphore;
 }
 
 //----------------------------------------------------------------------
@@ -72,10 +92,7 @@ SynchDisk::~SynchDisk()
 void
 SynchDisk::ReadSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->ReadRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Request(sectorNumber, data, FALSE);
 }
 
 //----------------------------------------------------------------------
@@ -90,20 +107,149 @@ SynchDisk::ReadSector(int sectorNumber, char* data)
 void
 SynchDisk::WriteSector(int sectorNumber, char* data)
 {
-    lock->Acquire();			// only one disk I/O at a time
-    disk->WriteRequest(sectorNumber, data);
-    semaphore->P();			// wait for interrupt
-    lock->Release();
+    Request(sectorNumber, data, TRUE);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Request
+// 	Make a request of the disk, and wait until it is done.
+//
+//	"sectorNumber" -- the disk sector to read or write
+//	"data" -- where to put it, or where to get it from
+//	"writing" -- TRUE to write, FALSE to read
+//----------------------------------------------------------------------
+
+void
+SynchDisk::Request(int sectorNumber, char* data, bool writing)
+{
+    Semaphore done("disk request", 0);
+    DiskRequest request;
+
+    request.sector = sectorNumber;
+    request.data = data;
+    request.writing = writing;
+    request.done = &done;
+    StartRequest(&request);
+    done.P();				// wait for interrupt
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartRequest
+// 	Queue a request for the disk, starting it at once if the disk is
+//	free, and return without waiting for it.  The request's semaphore
+//	is V'ed once it is done; until then, the caller must leave the
+//	request, and its data, alone.
+//
+//	"request" -- the sector to read or write, where to put it or get
+//		it from, and whether to write
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartRequest(DiskRequest *request)
+{
+    DiskRequest **last;
+    int queued;				// requests waiting or in progress,
+					// counting this one
+    IntStatus oldLevel;
+
+    ASSERT((request->sector >= 0) && (request->sector < NumSectors));
+    request->next = NULL;
+
+    oldLevel = interrupt->SetLevel(IntOff);
+    for (last = &waiting; *last != NULL; last = &(*last)->next)
+	;
+    *last = request;
+    numWaiting++;
+    queued = numWaiting + ((active != NULL) ? 1 : 0);
+    stats->diskQueueLength += queued;
+    if (queued > stats->maxDiskQueue)
+	stats->maxDiskQueue = queued;
+    if (active == NULL)
+	StartNext();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::Choose
+// 	Return the waiting request to give the disk next, according to
+//	the scheduling policy.  A request is never chosen ahead of an
+//	earlier one for the same sector, so that a read always sees the
+//	writes asked for before it, and the last write asked for is the
+//	one left on disk.  Interrupts are off.
+//
+//	FCFS takes the first request to arrive; SSTF, the one on the
+//	nearest track to the head; C-LOOK, the first one at or past the
+//	head, in sector order, or if there are none, the first one on the
+//	disk.
+//----------------------------------------------------------------------
+
+DiskRequest *
+SynchDisk::Choose()
+{
+    DiskRequest *best = NULL;
+    DiskRequest *r, *earlier;
+
+    for (r = waiting; r != NULL; r = r->next) {
+	for (earlier = waiting; earlier != r; earlier = earlier->next)
+	    if (earlier->sector == r->sector)
+		break;
+	if (earlier != r)
+	    continue;			// it has to wait its turn
+	if (best == NULL)
+	    best = r;
+	else if (scheduling == SstfScheduling) {
+	    if (TrackDistance(headSector, r->sector) <
+			TrackDistance(headSector, best->sector))
+		best = r;
+	} else if (scheduling == CLookScheduling) {
+	    if (((r->sector - headSector + NumSectors) % NumSectors) <
+		    ((best->sector - headSector + NumSectors) % NumSectors))
+		best = r;
+	}
+    }
+    return best;
+}
+
+//----------------------------------------------------------------------
+// SynchDisk::StartNext
+// 	The disk is free: if any request is waiting, choose one and give
+//	it to the disk.  Interrupts are off.
+//----------------------------------------------------------------------
+
+void
+SynchDisk::StartNext()
+{
+    DiskRequest **link;
+
+    ASSERT(active == NULL);
+    if (waiting == NULL)
+	return;
+    active = Choose();
+    for (link = &waiting; *link != active; link = &(*link)->next)
+	;
+    *link = active->next;
+    numWaiting--;
+
+    stats->seekTracks += TrackDistance(headSector, active->sector);
+    headSector = active->sector;
+    if (active->writing)
+	disk->WriteRequest(active->sector, active->data);
+    else
+	disk->ReadRequest(active->sector, active->data);
 }
 
 //----------------------------------------------------------------------
 // SynchDisk::RequestDone
-// 	Disk interrupt handler.  Wake up any thread waiting for the disk
-//	request to finish.
+// 	Disk interrupt handler.  Wake up the thread waiting for the disk
+//	request to finish, and start the next one.
 //----------------------------------------------------------------------
 
 void
 SynchDisk::RequestDone()
 { 
-    semaphore->V();
+    DiskRequest *done = active;
+
+    active = NULL;
+    StartNext();
+    done->done->V();
 }
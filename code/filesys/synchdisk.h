@@ -14,6 +14,24 @@
 #include "disk.h"
 #include "synch.h"
 
+// The disk scheduling policies we know about: first come first served,
+// shortest seek first, and circular LOOK -- sweep the head from the
+// outside of the disk in, serving requests on the way, then go straight
+// back to the outermost request and sweep again.
+
+enum DiskScheduling { FcfsScheduling, SstfScheduling, CLookScheduling };
+
+// The following class defines a request waiting for the disk.
+
+class DiskRequest {
+  public:
+    int sector;				// the sector to read or write
+    char *data;				// where to put it or get it from
+    bool writing;			// is this a write?
+    Semaphore *done;			// V'ed once the request is done
+    DiskRequest *next;			// the next request to arrive
+};
+
 // The following class defines a "synchronous" disk abstraction.
 // As with other I/O devices, the raw physical disk is an asynchronous device --
 // requests to read or write portions of the disk return immediately,
@@ -23,31 +41,47 @@
 //
 // This class provides the abstraction that for any individual thread
 // making a request, it waits around until the operation finishes before
-// returning.
+// returning.  Any number of threads may make requests at once, and a
+// thread may make several at once without waiting; they are queued,
+// and given to the disk one at a time, in the order the scheduling
+// policy chooses.
 class SynchDisk {
   public:
-    SynchDisk(char* name);    		// Initialize a synchronous disk,
+    SynchDisk(char* name, DiskScheduling which);
+					// Initialize a synchronous disk,
 					// by initializing the raw Disk.
     ~SynchDisk();			// De-allocate the synch disk data
     
     void ReadSector(int sectorNumber, char* data);
     					// Read/write a disk sector, returning
     					// only once the data is actually read 
-					// or written.  These call
-    					// Disk::ReadRequest/WriteRequest and
-					// then wait until the request is done.
+					// or written.  These queue a request,
+					// and wait until the disk has
+					// done it.
     void WriteSector(int sectorNumber, char* data);
+    void StartRequest(DiskRequest *request);
+					// Queue a request, and return at
+					// once; its semaphore is V'ed
+					// when it is done
     
     void RequestDone();			// Called by the disk device interrupt
 					// handler, to signal that the
 					// current disk operation is complete.
 
   private:
+    void Request(int sectorNumber, char* data, bool writing);
+					// Queue a request, and wait for it
+    DiskRequest *Choose();		// Which waiting request to do next
+    void StartNext();			// Give it to the disk
+
     Disk *disk;		  		// Raw disk device
-    Semaphore *semaphore; 		// To synchronize requesting thread 
-					// with the interrupt handler
-    Lock *lock;		  		// Only one read/write request
-					// can be sent to the disk at a time
+    DiskScheduling scheduling;		// how to choose the next request
+    DiskRequest *waiting;		// requests not yet given to the disk,
+					// in the order they arrived
+    int numWaiting;			// # of them
+    DiskRequest *active;		// the one the disk is doing, or NULL
+    int headSector;			// the last sector given to the disk,
+					// which is where its head is
 };
 
 #endif // SYNCHDISK_H
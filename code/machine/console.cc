@@ -80,7 +80,8 @@ Console::~Console()
 //	Only read it in if there is buffer space for it (if the previous
 //	character has been grabbed out of the buffer by the Nachos kernel).
 //	Invoke the "read" interrupt handler, once the character has been 
-//	put into the buffer. 
+//	put into the buffer.  Stop polling at the end of the input (when
+//	it is a file, or stdin is redirected from one).
 //----------------------------------------------------------------------
 
 void
@@ -88,16 +89,21 @@ Console::CheckCharAvail()
 {
     char c;
 
-    // schedule the next time to poll for a packet
-    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, 
-			ConsoleReadInt);
-
     // do nothing if character is already buffered, or none to be read
-    if ((incoming != EOF) || !PollFile(readFileNo))
+    if ((incoming != EOF) || !PollFile(readFileNo)) {
+	// schedule the next time to poll for a packet
+	interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, 
+			ConsoleReadInt);
 	return;	  
+    }
 
-    // otherwise, read character and tell user about it
-    Read(readFileNo, &c, sizeof(char));
+    // otherwise, read character and tell user about it -- unless we
+    // are at the end of the input, in which case nothing more will
+    // ever be typed, so stop polling
+    if (ReadPartial(readFileNo, &c, sizeof(char)) <= 0)
+	return;
+    interrupt->Schedule(ConsoleReadPoll, (int)this, ConsoleTime, 
+			ConsoleReadInt);
     incoming = c ;
     stats->numConsoleCharsRead++;
     (*readHandler)(handlerArg);	
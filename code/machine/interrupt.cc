@@ -50,6 +50,118 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
     type = kind;
 }
 
+//----------------------------------------------------------------------
+// PendingQueue::PendingQueue
+// 	Initialize an empty queue of pending interrupts.  We start with
+//	room for plenty of interrupts; if the queue ever fills up, we
+//	double it.
+//----------------------------------------------------------------------
+
+PendingQueue::PendingQueue()
+{
+    maxPending = 64;
+    heap = new PendingInterrupt[maxPending];
+    numPending = 0;
+    nextOrder = 0;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::~PendingQueue
+// 	De-allocate a queue of pending interrupts.
+//----------------------------------------------------------------------
+
+PendingQueue::~PendingQueue()
+{
+    delete [] heap;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Earlier
+// 	Return TRUE if interrupt "a" should fire before "b": it is due
+//	sooner, or at the same time but was scheduled first.  (The order
+//	numbers are compared so as to survive wrapping around.)
+//----------------------------------------------------------------------
+
+bool
+PendingQueue::Earlier(PendingInterrupt *a, PendingInterrupt *b)
+{
+    if (a->when != b->when)
+	return (a->when < b->when);
+    return ((a->order - b->order) < 0);
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::Insert
+// 	Add an interrupt to the queue: put it at the bottom of the heap,
+//	and move it up past any later interrupts.
+//
+//	"handler", "arg", "when", "type" -- cf. PendingInterrupt
+//----------------------------------------------------------------------
+
+void
+PendingQueue::Insert(VoidFunctionPtr handler, int arg, int when, IntType type)
+{
+    PendingInterrupt toOccur(handler, arg, when, type);
+    int i, parent;
+
+    if (numPending == maxPending) {		// full; make it bigger
+	PendingInterrupt *old = heap;
+
+	heap = new PendingInterrupt[maxPending * 2];
+	for (i = 0; i < numPending; i++)
+	    heap[i] = old[i];
+	maxPending *= 2;
+	delete [] old;
+    }
+    toOccur.order = nextOrder++;
+    for (i = numPending++; i > 0; i = parent) {
+	parent = (i - 1) / 2;
+	if (!Earlier(&toOccur, &heap[parent]))
+	    break;
+	heap[i] = heap[parent];
+    }
+    heap[i] = toOccur;
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::First
+// 	Return the earliest interrupt in the queue, leaving it there, or
+//	NULL if the queue is empty.
+//----------------------------------------------------------------------
+
+PendingInterrupt *
+PendingQueue::First()
+{
+    if (numPending == 0)
+	return NULL;
+    return &heap[0];
+}
+
+//----------------------------------------------------------------------
+// PendingQueue::RemoveFirst
+// 	Remove the earliest interrupt from the queue: move the last 
+//	interrupt in the heap into its place, and then down past any 
+//	earlier interrupts.
+//----------------------------------------------------------------------
+
+void
+PendingQueue::RemoveFirst()
+{
+    PendingInterrupt *last;
+    int i, child;
+
+    ASSERT(numPending > 0);
+    last = &heap[--numPending];
+    for (i = 0; (child = 2 * i + 1) < numPending; i = child) {
+	if ((child + 1 < numPending) && Earlier(&heap[child + 1], &heap[child]))
+	    child++;				// the earlier of the two children
+	if (!Earlier(&heap[child], last))
+	    break;
+	heap[i] = heap[child];
+    }
+    heap[i] = *last;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::Interrupt
 // 	Initialize the simulation of hardware device interrupts.
@@ -60,7 +172,7 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, int param, int time,
 Interrupt::Interrupt()
 {
     level = IntOff;
-    pending = new List();
+    pending = new PendingQueue();
     inHandler = FALSE;
     yieldOnReturn = FALSE;
     status = SystemMode;
@@ -73,8 +185,6 @@ Interrupt::Interrupt()
 
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-	delete (PendingInterrupt *)pending->Remove();
     delete pending;
 }
 
@@ -145,7 +255,9 @@ Interrupt::Enable()
 //
 //	Two things can cause OneTick to be called:
 //		interrupts are re-enabled
-//		a user instruction is executed
+//		a user instruction is executed, and an interrupt may
+//		be due (otherwise, Machine::Run saves up the ticks, and
+//		charges them later with AdvanceUserTime)
 //----------------------------------------------------------------------
 void
 Interrupt::OneTick()
@@ -178,6 +290,36 @@ Interrupt::OneTick()
     }
 }
 
+//----------------------------------------------------------------------
+// Interrupt::AdvanceUserTime
+// 	Advance simulated time by "ticks" user instructions at once,
+//	without checking for interrupts.  Used when running user code
+//	a basic block at a time; the caller must be sure that no 
+//	interrupt comes due in the meantime (cf. NextDueTime).
+//----------------------------------------------------------------------
+void
+Interrupt::AdvanceUserTime(int ticks)
+{
+    ASSERT(stats->totalTicks + ticks * UserTick < NextDueTime());
+    stats->totalTicks += ticks * UserTick;
+    stats->userTicks += ticks * UserTick;
+}
+
+//----------------------------------------------------------------------
+// Interrupt::NextDueTime
+// 	Return the time at which the next pending interrupt is due, or 
+//	NeverDue if there are no interrupts pending.
+//----------------------------------------------------------------------
+int
+Interrupt::NextDueTime()
+{
+    PendingInterrupt *next = pending->First();
+
+    if (next == NULL)
+	return NeverDue;
+    return next->when;
+}
+
 //----------------------------------------------------------------------
 // Interrupt::YieldOnReturn
 // 	Called from within an interrupt handler, to cause a context switch
@@ -241,6 +383,10 @@ void
 Interrupt::Halt()
 {
     printf("Machine halting!\n\n");
+    scheduler->ChargeRunTime();		// for the last thread to run
+#ifdef USER_PROGRAM
+    scheduler->EndSlice();		// charge the last CPU for its time
+#endif
     stats->Print();
     Cleanup();     // Never returns.
 }
@@ -250,7 +396,7 @@ Interrupt::Halt()
 // 	Arrange for the CPU to be interrupted when simulated time
 //	reaches "now + when".
 //
-//	Implementation: just put it on a sorted list.
+//	Implementation: just put it on the pending queue.
 //
 //	NOTE: the Nachos kernel should not call this routine directly.
 //	Instead, it is only called by the hardware device simulators.
@@ -265,13 +411,12 @@ void
 Interrupt::Schedule(VoidFunctionPtr handler, int arg, int fromNow, IntType type)
 {
     int when = stats->totalTicks + fromNow;
-    PendingInterrupt *toOccur = new PendingInterrupt(handler, arg, when, type);
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %d\n", 
 					intTypeNames[type], when);
     ASSERT(fromNow > 0);
 
-    pending->SortedInsert(toOccur, when);
+    pending->Insert(handler, arg, when, type);
 }
 
 //----------------------------------------------------------------------
@@ -297,29 +442,28 @@ Interrupt::CheckIfDue(bool advanceClock)
 					// to invoke an interrupt handler
     if (DebugIsEnabled('i'))
 	DumpState();
-    PendingInterrupt *toOccur = 
-		(PendingInterrupt *)pending->SortedRemove(&when);
+    PendingInterrupt *next = pending->First();
 
-    if (toOccur == NULL)		// no pending interrupts
+    if (next == NULL)			// no pending interrupts
 	return FALSE;			
+    when = next->when;
 
     if (advanceClock && when > stats->totalTicks) {	// advance the clock
 	stats->idleTicks += (when - stats->totalTicks);
 	stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {	// not time yet, put it back
-	pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks)	// not time yet
 	return FALSE;
-    }
 
 // Check if there is nothing more to do, and if so, quit
-    if ((status == IdleMode) && (toOccur->type == TimerInt) 
-				&& pending->IsEmpty()) {
-	 pending->SortedInsert(toOccur, when);
+    if ((status == IdleMode) && (next->type == TimerInt) 
+				&& (pending->NumPending() == 1))
 	 return FALSE;
-    }
+
+    PendingInterrupt toOccur = *next;	// the handler may schedule more
+    pending->RemoveFirst();
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %d\n", 
-			intTypeNames[toOccur->type], toOccur->when);
+			intTypeNames[toOccur.type], toOccur.when);
 #ifdef USER_PROGRAM
     if (machine != NULL)
     	machine->DelayedLoad(0, 0);
@@ -328,26 +472,41 @@ Interrupt::CheckIfDue(bool advanceClock)
     status = SystemMode;			// whatever we were doing,
 						// we are now going to be
 						// running in the kernel
-    (*(toOccur->handler))(toOccur->arg);	// call the interrupt handler
+    (*(toOccur.handler))(toOccur.arg);	// call the interrupt handler
     status = old;				// restore the machine status
     inHandler = FALSE;
-    delete toOccur;
     return TRUE;
 }
 
 //----------------------------------------------------------------------
-// PrintPending
-// 	Print information about an interrupt that is scheduled to occur.
-//	When, where, why, etc.
+// PendingQueue::Print
+// 	Print information about each interrupt that is scheduled to occur,
+//	in the order they will occur.  When, where, why, etc.
+//
+//	The heap isn't kept in that order, so we drain a copy of it.  The
+//	copy is of the heap as it is, order numbers and all: inserting the
+//	interrupts afresh would number them in heap order, and those due
+//	at the same time might then come out in the wrong order.
 //----------------------------------------------------------------------
 
-static void
-PrintPending(int arg)
+void
+PendingQueue::Print()
 {
-    PendingInterrupt *pend = (PendingInterrupt *)arg;
-
-    printf("Interrupt handler %s, scheduled at %d\n", 
-	intTypeNames[pend->type], pend->when);
+    PendingQueue *copy = new PendingQueue();
+    PendingInterrupt *pend;
+
+    delete [] copy->heap;
+    copy->heap = new PendingInterrupt[maxPending];
+    copy->maxPending = maxPending;
+    for (int i = 0; i < numPending; i++)
+	copy->heap[i] = heap[i];
+    copy->numPending = numPending;
+    while ((pend = copy->First()) != NULL) {
+	printf("Interrupt handler %s, scheduled at %d\n", 
+	    intTypeNames[pend->type], pend->when);
+	copy->RemoveFirst();
+    }
+    delete copy;
 }
 
 //----------------------------------------------------------------------
@@ -363,7 +522,7 @@ Interrupt::DumpState()
 					intLevelNames[level]);
     printf("Pending interrupts:\n");
     fflush(stdout);
-    pending->Mapcar(PrintPending);
+    pending->Print();
     printf("End of pending interrupts\n");
     fflush(stdout);
 }
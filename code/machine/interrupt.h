@@ -52,6 +52,9 @@ enum MachineStatus {IdleMode, SystemMode, UserMode};
 enum IntType { TimerInt, DiskInt, ConsoleWriteInt, ConsoleReadInt, 
 				NetworkSendInt, NetworkRecvInt};
 
+// NextDueTime returns NeverDue if there are no interrupts pending.
+#define NeverDue	0x7fffffff
+
 // The following class defines an interrupt that is scheduled
 // to occur in the future.  The internal data structures are
 // left public to make it simpler to manipulate.
@@ -61,12 +64,51 @@ class PendingInterrupt {
     PendingInterrupt(VoidFunctionPtr func, int param, int time, IntType kind);
 				// initialize an interrupt that will
 				// occur in the future
+    PendingInterrupt() {}	// an empty slot in a PendingQueue
 
     VoidFunctionPtr handler;    // The function (in the hardware device
 				// emulator) to call when the interrupt occurs
     int arg;                    // The argument to the function.
     int when;			// When the interrupt is supposed to fire
     IntType type;		// for debugging
+    int order;			// Set by PendingQueue, to fire interrupts
+				// due at the same time in the order they 
+				// were scheduled
+};
+
+// The following class defines the queue of interrupts scheduled to 
+// occur in the future, earliest first.  It is a binary heap, stored in
+// an array of PendingInterrupts, so that scheduling an interrupt and 
+// firing it don't allocate any memory (except to grow the array, the 
+// first few times it fills up).
+
+class PendingQueue {
+  public:
+    PendingQueue();			// initialize an empty queue
+    ~PendingQueue();			// de-allocate the queue
+
+    void Insert(VoidFunctionPtr handler, int arg, int when, IntType type);
+					// Add an interrupt to the queue
+    PendingInterrupt *First();		// Return the earliest interrupt, 
+					// without removing it; NULL if none.
+					// Only good until the next Insert.
+    void RemoveFirst();			// Remove the earliest interrupt
+    int NumPending() { return numPending; }
+    bool IsEmpty() { return (numPending == 0); }
+
+    void Print();			// print the interrupts in the order
+					// they will occur
+
+  private:
+    PendingInterrupt *heap;		// heap[0] is the earliest interrupt;
+					// heap[i] is earlier than 
+					// heap[2i+1] and heap[2i+2]
+    int numPending;			// # of interrupts in the queue
+    int maxPending;			// # of slots in heap
+    int nextOrder;			// order for the next interrupt
+
+    bool Earlier(PendingInterrupt *a, PendingInterrupt *b);
+					// should "a" fire before "b"?
 };
 
 // The following class defines the data structures for the simulation
@@ -94,6 +136,7 @@ class Interrupt {
     
     void YieldOnReturn();		// cause a context switch on return 
 					// from an interrupt handler
+    bool InHandler() { return inHandler; }	// in an interrupt handler?
 
     MachineStatus getStatus() { return status; } // idle, kernel, user
     void setStatus(MachineStatus st) { status = st; }
@@ -111,10 +154,14 @@ class Interrupt {
     					// by the hardware device simulators.
     
     void OneTick();       		// Advance simulated time
+    void AdvanceUserTime(int ticks);	// Advance simulated time by several
+					// user instructions at once, when
+					// no interrupt can be due
+    int NextDueTime();			// When is the next interrupt due?
 
   private:
     IntStatus level;		// are interrupts enabled or disabled?
-    List *pending;		// the list of interrupts scheduled
+    PendingQueue *pending;	// the interrupts scheduled
 				// to occur in the future
     bool inHandler;		// TRUE if we are running an interrupt handler
     bool yieldOnReturn; 	// TRUE if we are to context switch
@@ -50,28 +50,53 @@ void CheckEndian()
 //
 //	"debug" -- if TRUE, drop into the debugger after each user instruction
 //		is executed.
+//	"blocks" -- if TRUE, run user code a basic block at a time 
+//		where possible.
+//	"cpus" -- the number of CPUs sharing the memory
+//	"tlbEntries" -- the size of each CPU's TLB, if there is one
+//	"ways" -- the associativity of the TLB
 //----------------------------------------------------------------------
 
-Machine::Machine(bool debug)
+Machine::Machine(bool debug, bool blocks, int cpus, int tlbEntries, 
+		 int ways)
 {
-    int i;
+    int i, cpu;
 
     for (i = 0; i < NumTotalRegs; i++)
         registers[i] = 0;
     mainMemory = new char[MemorySize];
     for (i = 0; i < MemorySize; i++)
       	mainMemory[i] = 0;
+    decodeCache = new CompiledInstr[MemorySize / 4];
+    for (i = 0; i < NumPhysPages; i++)
+	frameDecoded[i] = FALSE;
+    ASSERT((cpus >= 1) && (cpus <= MaxCpus));
+    numCpus = cpus;
+    ASSERT((ways >= 2) && (tlbEntries % ways == 0));
+					// an instruction can need two pages
+					// at once (its own, and the one it
+					// loads or stores), so a set must
+					// be able to hold both
+    tlbSize = tlbEntries;
+    tlbWays = ways;
+    asid = 0;
+    for (cpu = 0; cpu < numCpus; cpu++) {
 #ifdef USE_TLB
-    tlb = new TranslationEntry[TLBSize];
-    for (i = 0; i < TLBSize; i++)
-	tlb[i].valid = FALSE;
-    pageTable = NULL;
+	cpuTlb[cpu] = new TranslationEntry[tlbSize];
+	for (i = 0; i < tlbSize; i++)
+	    cpuTlb[cpu][i].valid = FALSE;
 #else	// use linear page table
-    tlb = NULL;
-    pageTable = NULL;
+	cpuTlb[cpu] = NULL;
 #endif
+    }
+    pageTable = NULL;
+    SetCpu(0);
+    sliceEnd = CpuSlice;
 
     singleStep = debug;
+    useBlocks = blocks;
+    blockChanged = FALSE;
+    unchargedTicks = 0;
     CheckEndian();
 }
 
@@ -83,8 +108,28 @@ Machine::Machine(bool debug)
 Machine::~Machine()
 {
     delete [] mainMemory;
-    if (tlb != NULL)
-        delete [] tlb;
+    delete [] decodeCache;
+    for (int cpu = 0; cpu < numCpus; cpu++)
+	if (cpuTlb[cpu] != NULL)
+	    delete [] cpuTlb[cpu];
+}
+
+//----------------------------------------------------------------------
+// Machine::SetCpu
+// 	Switch to simulating another CPU.  Its registers are loaded 
+//	separately, along with the user thread it is running; all we 
+//	need to switch here is the TLB.
+//
+//	"cpu" -- the CPU to simulate from now on
+//----------------------------------------------------------------------
+
+void
+Machine::SetCpu(int cpu)
+{
+    ASSERT((cpu >= 0) && (cpu < numCpus));
+    currentCpu = cpu;
+    tlb = cpuTlb[cpu];
+    FlushTranslations();
 }
 
 //----------------------------------------------------------------------
@@ -100,14 +145,19 @@ Machine::~Machine()
 void
 Machine::RaiseException(ExceptionType which, int badVAddr)
 {
+    MachineStatus oldStatus = interrupt->getStatus();
+
     DEBUG('m', "Exception: %s\n", exceptionNames[which]);
     
 //  ASSERT(interrupt->getStatus() == UserMode);
     registers[BadVAddrReg] = badVAddr;
+    ChargeTicks();			// bring the clock up to date, if we
+					// are part way through a block
     DelayedLoad(0, 0);			// finish anything in progress
     interrupt->setStatus(SystemMode);
     ExceptionHandler(which);		// interrupts are enabled at this point
-    interrupt->setStatus(UserMode);
+    interrupt->setStatus(oldStatus);	// user mode, unless the kernel was
+					// touching user memory for a syscall
 }
 
 //----------------------------------------------------------------------
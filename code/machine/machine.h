@@ -25,6 +25,7 @@
 #include "utility.h"
 #include "translate.h"
 #include "disk.h"
+#include "stats.h"
 
 // Definitions related to the size, and format of user memory
 
@@ -35,6 +36,12 @@
 #define NumPhysPages    32
 #define MemorySize 	(NumPhysPages * PageSize)
 #define TLBSize		4		// if there is a TLB, make it small
+					// (unless told otherwise: -tlb)
+#define InstrsPerPage	(PageSize / 4)	// instruction words in one page
+#define TransCacheSize	64		// entries in each translation cache
+					// (must be a power of 2)
+#define NoPage		((unsigned int) -1)	// vpn of an unused
+						// translation cache entry
 
 enum ExceptionType { NoException,           // Everything ok!
 		     SyscallException,      // A program executed a system call.
@@ -91,6 +98,47 @@ class Instruction {
                      // Immediates are sign-extended.
 };
 
+// The effects of executing an instruction that are applied only once
+// it has completed without an exception.
+
+class InstrResult {
+  public:
+    int pcAfter;	// new value of NextPCReg
+    int loadReg;	// register target of any delayed load the
+    int loadValue;	// instruction started, and the value to load
+};
+
+class Machine;
+typedef bool (*InstrHandler)(Machine *m, Instruction *instr,
+				InstrResult *result);
+				// Execute one instruction; return FALSE
+				// if it raised an exception
+
+// The following class defines a pre-decoded instruction, as kept in the
+// decode cache: the decoded instruction, the routine that executes it,
+// and (if it starts a basic block) how long that block is.
+
+class CompiledInstr {
+  public:
+    InstrHandler handler;	// routine to execute the instruction
+    Instruction instr;		// the decoded instruction
+    int blockLength;		// # of instructions in the basic block
+				// starting here; 0 if not yet known
+};
+
+// The following class defines an entry in the translation cache: a
+// recently used translation of a virtual page, straight to where that
+// page lives in mainMemory.  The cache is purely a speedup of the
+// simulation, which the kernel never sees -- except that the kernel must
+// call Machine::FlushTranslations whenever it changes the page table 
+// or the TLB.
+
+class CachedTranslation {
+  public:
+    unsigned int virtualPage;	// the page translated; NoPage if unused
+    char *hostPage;		// start of the page in mainMemory
+};
+
 // The following class defines the simulated host workstation hardware, as 
 // seen by user programs -- the CPU registers, main memory, etc.
 // User programs shouldn't be able to tell that they are running on our 
@@ -106,7 +154,8 @@ class Instruction {
 
 class Machine {
   public:
-    Machine(bool debug);	// Initialize the simulation of the hardware
+    Machine(bool debug, bool blocks, int cpus, int tlbEntries, int ways);
+				// Initialize the simulation of the hardware
 				// for running user programs
     ~Machine();			// De-allocate the data structures
 
@@ -118,11 +167,32 @@ class Machine {
     void WriteRegister(int num, int value);
 				// store a value into a CPU register
 
+    void InvalidateFrame(int frame);
+				// Forget any decoded instructions cached
+				// for physical page "frame".  Must be
+				// called whenever the kernel loads new
+				// contents into a frame directly, or
+				// hands the frame to another virtual page.
+
+    void SetCpu(int cpu);	// Switch to simulating CPU "cpu" (the
+				// scheduler does this; cf. SwitchCpu)
+
+    void FlushTranslations();	// Forget all cached translations.  Must
+				// be called whenever the kernel switches
+				// or changes the page table, or changes
+				// the TLB (including use/dirty bits).
+
 
 // Routines internal to the machine simulation -- DO NOT call these 
 
     void OneInstruction(Instruction *instr); 	
     				// Run one instruction of a user program.
+    bool FetchInstruction(Instruction *instr);
+				// Fetch and decode the instruction at PC.
+				// Return FALSE if the fetch trapped.
+    bool RunBlock();		// Run the basic block at PC, all at once.
+				// Return FALSE if it has to be run one
+				// instruction at a time instead.
     void DelayedLoad(int nextReg, int nextVal);  	
 				// Do a pending delayed load (modifying a reg)
     
@@ -138,6 +208,10 @@ class Machine {
 				// the translation entry appropriately,
     				// and return an exception code if the 
 				// translation couldn't be completed.
+    char *CachedTranslate(int virtAddr, int size, bool writing);
+				// Translate an address using only the
+				// translation cache.  Return NULL if
+				// there's no usable cached translation.
 
     void RaiseException(ExceptionType which, int badVAddr);
 				// Trap to the Nachos kernel, because of a
@@ -182,7 +256,54 @@ class Machine {
     TranslationEntry *pageTable;
     unsigned int pageTableSize;
 
+// The TLB is set associative: entry i is in set i / tlbWays, and a 
+// virtual page can only be in set (vpn % # of sets).  With tlbWays 
+// equal to tlbSize, it is fully associative.  An entry only matches
+// if its asid is the same as the "asid" register, so TLB entries for 
+// several address spaces can coexist.
+
+    int tlbSize;			// # of entries in each TLB
+    int tlbWays;			// # of entries in each set
+    int asid;				// address space now running
+
+// With more than one CPU, the CPUs share mainMemory, but each has its 
+// own registers and TLB.  We simulate one CPU at a time, for a slice of
+// CpuSlice ticks, and then move on to the next (see Scheduler::SwitchCpu).
+// Only the CPU being simulated has its registers in "registers"; the 
+// others' are saved in the user threads they are running.
+
+    int numCpus;		// # of CPUs
+    int currentCpu;		// the CPU being simulated right now
+    int sliceEnd;		// when its slice is up
+    TranslationEntry *cpuTlb[MaxCpus];	// each CPU's TLB, if any; the 
+				// kernel may change the other CPUs'
+				// TLBs (to invalidate entries)
+
+    void WordChanged(int physAddr);	// a store changed a word of mainMemory
+					// in a decoded frame
+
   private:
+    void DecodeFrame(int frame);	// pre-decode every word of a frame
+    void DecodeWord(int physAddr);	// pre-decode one word
+    void FindBlock(int physAddr);	// find the extent of a basic block
+    void ChargeTicks();			// add the ticks we owe for user
+					// instructions to the clock
+
+    CompiledInstr *decodeCache;	// pre-decoded copy of each word of
+				// mainMemory, valid only for frames
+				// with frameDecoded set
+    bool frameDecoded[NumPhysPages];
+
+    CachedTranslation transCache[2][TransCacheSize];
+				// recent translations for reading [0] and
+				// writing [1], direct-mapped by vpn
+
+    bool useBlocks;		// run a basic block at a time, if we can
+    bool blockChanged;		// a store in the current block changed
+				// where some block ends
+    int unchargedTicks;		// ticks used by user instructions that
+				// have not yet been added to the clock
+
     bool singleStep;		// drop back into the debugger after each
 				// simulated instruction
     int runUntilTime;		// drop back into the debugger when simulated
@@ -23,6 +23,19 @@ static void Mult(int a, int b, bool signedArith, int* hiPtr, int* loPtr);
 // 	Simulate the execution of a user-level program on Nachos.
 //	Called by the kernel when the program starts up; never returns.
 //
+//	If basic-block mode is on, we try to run a whole basic block
+//	at a time (see RunBlock), and fall back to one instruction at a
+//	time whenever that isn't possible.  Either way, the simulated
+//	machine ends up in exactly the same state.
+//
+//	We only call OneTick when an interrupt could be due; until then,
+//	we just keep count of the ticks we owe the clock (unchargedTicks),
+//	and pay them all at once.  RaiseException pays them too, before 
+//	the kernel gets to look at the clock.
+//
+//	With more than one CPU, this is also where each CPU's time slice
+//	ends, and we move on to the next CPU.
+//
 //	This routine is re-entrant, in that it can be called multiple
 //	times concurrently -- one for each thread executing user code.
 //----------------------------------------------------------------------
@@ -31,14 +44,30 @@ void
 Machine::Run()
 {
     Instruction *instr = new Instruction;  // storage for decoded instruction
+    bool tracing = DebugIsEnabled('m') || DebugIsEnabled('a')
+			|| DebugIsEnabled('i');
+					// debugging output wants to see
+					// every instruction and every tick
 
     if(DebugIsEnabled('m'))
         printf("Starting thread \"%s\" at time %d\n",
 	       currentThread->getName(), stats->totalTicks);
     interrupt->setStatus(UserMode);
     for (;;) {
-        OneInstruction(instr);
-	interrupt->OneTick();
+	if (!useBlocks || singleStep || tracing || !RunBlock())
+	    OneInstruction(instr);
+	if (!singleStep && !tracing && (stats->totalTicks
+		+ (unchargedTicks + 1) * UserTick < interrupt->NextDueTime()))
+	    unchargedTicks++;		// nothing can be due yet
+	else {
+	    ChargeTicks();
+	    interrupt->OneTick();
+	}
+	if ((numCpus > 1) && 
+		(stats->totalTicks + unchargedTicks * UserTick >= sliceEnd)) {
+	    ChargeTicks();
+	    scheduler->SwitchCpu();	// give the next CPU a turn
+	}
 	if (singleStep && (runUntilTime <= stats->totalTicks))
 	  Debugger();
     }
@@ -67,6 +96,726 @@ TypeToReg(RegType reg, Instruction *instr)
     }
 }
 
+//----------------------------------------------------------------------
+// Instruction handlers
+// 	One routine per opcode, to execute a decoded instruction
+//	(cf. Kane's book).  Both OneInstruction and RunBlock dispatch
+//	through opHandlers[], so they can never disagree about what an
+//	instruction does.
+//
+//	A handler updates the registers and memory directly, except for
+//	the next PC and any delayed load it starts, which it leaves in
+//	"result" for the caller to apply once the instruction is done.
+//
+//	Returns FALSE if the instruction raised an exception, in which
+//	case "result" must be ignored.
+//----------------------------------------------------------------------
+
+static bool
+ExecUndefined(Machine *m, Instruction *instr, InstrResult *result)
+{
+    ASSERT(FALSE);		// Decode never produces these opcodes
+    return FALSE;
+}
+
+static bool
+ExecAdd(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+    int sum = registers[instr->rs] + registers[instr->rt];
+
+    if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	((registers[instr->rs] ^ sum) & SIGN_BIT)) {
+	m->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    registers[instr->rd] = sum;
+    return TRUE;
+}
+
+static bool
+ExecAddi(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+    int sum = registers[instr->rs] + instr->extra;
+
+    if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
+	((instr->extra ^ sum) & SIGN_BIT)) {
+	m->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    registers[instr->rt] = sum;
+    return TRUE;
+}
+
+static bool
+ExecAddiu(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rt] = m->registers[instr->rs] + instr->extra;
+    return TRUE;
+}
+
+static bool
+ExecAddu(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] + m->registers[instr->rt];
+    return TRUE;
+}
+
+static bool
+ExecAnd(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] & m->registers[instr->rt];
+    return TRUE;
+}
+
+static bool
+ExecAndi(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rt] = m->registers[instr->rs] & (instr->extra & 0xffff);
+    return TRUE;
+}
+
+static bool
+ExecBeq(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    if (registers[instr->rs] == registers[instr->rt])
+	result->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+ExecBgez(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    if (!(registers[instr->rs] & SIGN_BIT))
+	result->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+ExecBgezal(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[R31] = m->registers[NextPCReg] + 4;
+    return ExecBgez(m, instr, result);
+}
+
+static bool
+ExecBgtz(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    if (registers[instr->rs] > 0)
+	result->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+ExecBlez(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    if (registers[instr->rs] <= 0)
+	result->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+ExecBltz(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    if (registers[instr->rs] & SIGN_BIT)
+	result->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+ExecBltzal(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[R31] = m->registers[NextPCReg] + 4;
+    return ExecBltz(m, instr, result);
+}
+
+static bool
+ExecBne(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    if (registers[instr->rs] != registers[instr->rt])
+	result->pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+ExecDiv(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    if (registers[instr->rt] == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	registers[LoReg] =  registers[instr->rs] / registers[instr->rt];
+	registers[HiReg] = registers[instr->rs] % registers[instr->rt];
+    }
+    return TRUE;
+}
+
+static bool
+ExecDivu(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+    unsigned int rs = (unsigned int) registers[instr->rs];
+    unsigned int rt = (unsigned int) registers[instr->rt];
+    int tmp;
+
+    if (rt == 0) {
+	registers[LoReg] = 0;
+	registers[HiReg] = 0;
+    } else {
+	tmp = rs / rt;
+	registers[LoReg] = (int) tmp;
+	tmp = rs % rt;
+	registers[HiReg] = (int) tmp;
+    }
+    return TRUE;
+}
+
+static bool
+ExecJ(Machine *m, Instruction *instr, InstrResult *result)
+{
+    result->pcAfter = (result->pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
+    return TRUE;
+}
+
+static bool
+ExecJal(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[R31] = m->registers[NextPCReg] + 4;
+    return ExecJ(m, instr, result);
+}
+
+static bool
+ExecJr(Machine *m, Instruction *instr, InstrResult *result)
+{
+    result->pcAfter = m->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+ExecJalr(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[NextPCReg] + 4;
+    return ExecJr(m, instr, result);
+}
+
+static bool
+ExecLoadByte(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int tmp = m->registers[instr->rs] + instr->extra;
+    int value;
+
+    if (!m->ReadMem(tmp, 1, &value))
+	return FALSE;
+
+    if ((value & 0x80) && (instr->opCode == OP_LB))
+	value |= 0xffffff00;
+    else
+	value &= 0xff;
+    result->loadReg = instr->rt;
+    result->loadValue = value;
+    return TRUE;
+}
+
+static bool
+ExecLoadHalf(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int tmp = m->registers[instr->rs] + instr->extra;
+    int value;
+
+    if (tmp & 0x1) {
+	m->RaiseException(AddressErrorException, tmp);
+	return FALSE;
+    }
+    if (!m->ReadMem(tmp, 2, &value))
+	return FALSE;
+
+    if ((value & 0x8000) && (instr->opCode == OP_LH))
+	value |= 0xffff0000;
+    else
+	value &= 0xffff;
+    result->loadReg = instr->rt;
+    result->loadValue = value;
+    return TRUE;
+}
+
+static bool
+ExecLui(Machine *m, Instruction *instr, InstrResult *result)
+{
+    DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
+    m->registers[instr->rt] = instr->extra << 16;
+    return TRUE;
+}
+
+static bool
+ExecLw(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int tmp = m->registers[instr->rs] + instr->extra;
+    int value;
+
+    if (tmp & 0x3) {
+	m->RaiseException(AddressErrorException, tmp);
+	return FALSE;
+    }
+    if (!m->ReadMem(tmp, 4, &value))
+	return FALSE;
+    result->loadReg = instr->rt;
+    result->loadValue = value;
+    return TRUE;
+}
+
+static bool
+ExecLwl(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+    int tmp = registers[instr->rs] + instr->extra;
+    int value, nextLoadValue;
+
+    // ReadMem assumes all 4 byte requests are aligned on an even
+    // word boundary.  Also, the little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);
+
+    if (!m->ReadMem(tmp, 4, &value))
+	return FALSE;
+    if (registers[LoadReg] == instr->rt)
+	nextLoadValue = registers[LoadValueReg];
+    else
+	nextLoadValue = registers[instr->rt];
+    switch (tmp & 0x3) {
+      case 0:
+	nextLoadValue = value;
+	break;
+      case 1:
+	nextLoadValue = (nextLoadValue & 0xff) | (value << 8);
+	break;
+      case 2:
+	nextLoadValue = (nextLoadValue & 0xffff) | (value << 16);
+	break;
+      case 3:
+	nextLoadValue = (nextLoadValue & 0xffffff) | (value << 24);
+	break;
+    }
+    result->loadReg = instr->rt;
+    result->loadValue = nextLoadValue;
+    return TRUE;
+}
+
+static bool
+ExecLwr(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+    int tmp = registers[instr->rs] + instr->extra;
+    int value, nextLoadValue;
+
+    // ReadMem assumes all 4 byte requests are aligned on an even
+    // word boundary.  Also, the little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);
+
+    if (!m->ReadMem(tmp, 4, &value))
+	return FALSE;
+    if (registers[LoadReg] == instr->rt)
+	nextLoadValue = registers[LoadValueReg];
+    else
+	nextLoadValue = registers[instr->rt];
+    switch (tmp & 0x3) {
+      case 0:
+	nextLoadValue = (nextLoadValue & 0xffffff00) |
+	    ((value >> 24) & 0xff);
+	break;
+      case 1:
+	nextLoadValue = (nextLoadValue & 0xffff0000) |
+	    ((value >> 16) & 0xffff);
+	break;
+      case 2:
+	nextLoadValue = (nextLoadValue & 0xff000000)
+	    | ((value >> 8) & 0xffffff);
+	break;
+      case 3:
+	nextLoadValue = value;
+	break;
+    }
+    result->loadReg = instr->rt;
+    result->loadValue = nextLoadValue;
+    return TRUE;
+}
+
+static bool
+ExecMfhi(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[HiReg];
+    return TRUE;
+}
+
+static bool
+ExecMflo(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[LoReg];
+    return TRUE;
+}
+
+static bool
+ExecMthi(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[HiReg] = m->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+ExecMtlo(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[LoReg] = m->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+ExecMult(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    Mult(registers[instr->rs], registers[instr->rt], TRUE,
+	 &registers[HiReg], &registers[LoReg]);
+    return TRUE;
+}
+
+static bool
+ExecMultu(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    Mult(registers[instr->rs], registers[instr->rt], FALSE,
+	 &registers[HiReg], &registers[LoReg]);
+    return TRUE;
+}
+
+static bool
+ExecNor(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] =
+		~(m->registers[instr->rs] | m->registers[instr->rt]);
+    return TRUE;
+}
+
+static bool
+ExecOr(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] | m->registers[instr->rs];
+    return TRUE;
+}
+
+static bool
+ExecOri(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rt] = m->registers[instr->rs] | (instr->extra & 0xffff);
+    return TRUE;
+}
+
+static bool
+ExecSb(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    return m->WriteMem((unsigned) (registers[instr->rs] + instr->extra),
+			1, registers[instr->rt]);
+}
+
+static bool
+ExecSh(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    return m->WriteMem((unsigned) (registers[instr->rs] + instr->extra),
+			2, registers[instr->rt]);
+}
+
+static bool
+ExecSll(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[instr->rt] << instr->extra;
+    return TRUE;
+}
+
+static bool
+ExecSllv(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[instr->rt] <<
+	(m->registers[instr->rs] & 0x1f);
+    return TRUE;
+}
+
+static bool
+ExecSlt(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    if (registers[instr->rs] < registers[instr->rt])
+	registers[instr->rd] = 1;
+    else
+	registers[instr->rd] = 0;
+    return TRUE;
+}
+
+static bool
+ExecSlti(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    if (registers[instr->rs] < instr->extra)
+	registers[instr->rt] = 1;
+    else
+	registers[instr->rt] = 0;
+    return TRUE;
+}
+
+static bool
+ExecSltiu(Machine *m, Instruction *instr, InstrResult *result)
+{
+    unsigned int rs = m->registers[instr->rs];
+    unsigned int imm = instr->extra;
+
+    if (rs < imm)
+	m->registers[instr->rt] = 1;
+    else
+	m->registers[instr->rt] = 0;
+    return TRUE;
+}
+
+static bool
+ExecSltu(Machine *m, Instruction *instr, InstrResult *result)
+{
+    unsigned int rs = m->registers[instr->rs];
+    unsigned int rt = m->registers[instr->rt];
+
+    if (rs < rt)
+	m->registers[instr->rd] = 1;
+    else
+	m->registers[instr->rd] = 0;
+    return TRUE;
+}
+
+static bool
+ExecSra(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[instr->rt] >> instr->extra;
+    return TRUE;
+}
+
+static bool
+ExecSrav(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[instr->rt] >>
+	(m->registers[instr->rs] & 0x1f);
+    return TRUE;
+}
+
+static bool
+ExecSrl(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int tmp = m->registers[instr->rt];
+
+    tmp >>= instr->extra;
+    m->registers[instr->rd] = tmp;
+    return TRUE;
+}
+
+static bool
+ExecSrlv(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int tmp = m->registers[instr->rt];
+
+    tmp >>= (m->registers[instr->rs] & 0x1f);
+    m->registers[instr->rd] = tmp;
+    return TRUE;
+}
+
+static bool
+ExecSub(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+    int diff = registers[instr->rs] - registers[instr->rt];
+
+    if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
+	((registers[instr->rs] ^ diff) & SIGN_BIT)) {
+	m->RaiseException(OverflowException, 0);
+	return FALSE;
+    }
+    registers[instr->rd] = diff;
+    return TRUE;
+}
+
+static bool
+ExecSubu(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] - m->registers[instr->rt];
+    return TRUE;
+}
+
+static bool
+ExecSw(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+
+    return m->WriteMem((unsigned) (registers[instr->rs] + instr->extra),
+			4, registers[instr->rt]);
+}
+
+static bool
+ExecSwl(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+    int tmp = registers[instr->rs] + instr->extra;
+    int value;
+
+    // The little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);
+
+    if (!m->ReadMem((tmp & ~0x3), 4, &value))
+	return FALSE;
+    switch (tmp & 0x3) {
+      case 0:
+	value = registers[instr->rt];
+	break;
+      case 1:
+	value = (value & 0xff000000) | ((registers[instr->rt] >> 8) &
+					0xffffff);
+	break;
+      case 2:
+	value = (value & 0xffff0000) | ((registers[instr->rt] >> 16) &
+					0xffff);
+	break;
+      case 3:
+	value = (value & 0xffffff00) | ((registers[instr->rt] >> 24) &
+					0xff);
+	break;
+    }
+    return m->WriteMem((tmp & ~0x3), 4, value);
+}
+
+static bool
+ExecSwr(Machine *m, Instruction *instr, InstrResult *result)
+{
+    int *registers = m->registers;
+    int tmp = registers[instr->rs] + instr->extra;
+    int value;
+
+    // The little endian/big endian swap code would
+    // fail (I think) if the other cases are ever exercised.
+    ASSERT((tmp & 0x3) == 0);
+
+    if (!m->ReadMem((tmp & ~0x3), 4, &value))
+	return FALSE;
+    switch (tmp & 0x3) {
+      case 0:
+	value = (value & 0xffffff) | (registers[instr->rt] << 24);
+	break;
+      case 1:
+	value = (value & 0xffff) | (registers[instr->rt] << 16);
+	break;
+      case 2:
+	value = (value & 0xff) | (registers[instr->rt] << 8);
+	break;
+      case 3:
+	value = registers[instr->rt];
+	break;
+    }
+    return m->WriteMem((tmp & ~0x3), 4, value);
+}
+
+static bool
+ExecSyscall(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->RaiseException(SyscallException, 0);
+    return FALSE;
+}
+
+static bool
+ExecXor(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rd] = m->registers[instr->rs] ^ m->registers[instr->rt];
+    return TRUE;
+}
+
+static bool
+ExecXori(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->registers[instr->rt] = m->registers[instr->rs] ^ (instr->extra & 0xffff);
+    return TRUE;
+}
+
+static bool
+ExecIllegal(Machine *m, Instruction *instr, InstrResult *result)
+{
+    m->RaiseException(IllegalInstrException, 0);
+    return FALSE;
+}
+
+// The handler for each opcode, indexed like opStrings[].
+
+static InstrHandler opHandlers[] = {
+    ExecUndefined, ExecAdd, ExecAddi, ExecAddiu,		// 0-3
+    ExecAddu, ExecAnd, ExecAndi, ExecBeq,		// 4-7
+    ExecBgez, ExecBgezal, ExecBgtz, ExecBlez,		// 8-11
+    ExecBltz, ExecBltzal, ExecBne, ExecUndefined,	// 12-15
+    ExecDiv, ExecDivu, ExecJ, ExecJal,			// 16-19
+    ExecJalr, ExecJr, ExecLoadByte, ExecLoadByte,	// 20-23
+    ExecLoadHalf, ExecLoadHalf, ExecLui, ExecLw,	// 24-27
+    ExecLwl, ExecLwr, ExecUndefined, ExecMfhi,		// 28-31
+    ExecMflo, ExecUndefined, ExecMthi, ExecMtlo,	// 32-35
+    ExecMult, ExecMultu, ExecNor, ExecOr,		// 36-39
+    ExecOri, ExecUndefined, ExecSb, ExecSh,		// 40-43 (RFE is 41)
+    ExecSll, ExecSllv, ExecSlt, ExecSlti,		// 44-47
+    ExecSltiu, ExecSltu, ExecSra, ExecSrav,		// 48-51
+    ExecSrl, ExecSrlv, ExecSub, ExecSubu,		// 52-55
+    ExecSw, ExecSwl, ExecSwr, ExecXor,			// 56-59
+    ExecXori, ExecSyscall, ExecIllegal, ExecIllegal	// 60-63
+};
+
+//----------------------------------------------------------------------
+// EndsBlock
+// 	Return TRUE if a basic block must stop after "opCode": branches
+//	and jumps (whose delay slot is still run as part of the block),
+//	and system calls.
+//----------------------------------------------------------------------
+
+static bool
+EndsBlock(int opCode)
+{
+    switch (opCode) {
+      case OP_BEQ:
+      case OP_BGEZ:
+      case OP_BGEZAL:
+      case OP_BGTZ:
+      case OP_BLEZ:
+      case OP_BLTZ:
+      case OP_BLTZAL:
+      case OP_BNE:
+      case OP_J:
+      case OP_JAL:
+      case OP_JALR:
+      case OP_JR:
+      case OP_SYSCALL:
+	return TRUE;
+      default:
+	return FALSE;
+    }
+}
+
 //----------------------------------------------------------------------
 // Machine::OneInstruction
 // 	Execute one instruction from a user-level program
@@ -93,16 +842,11 @@ TypeToReg(RegType reg, Instruction *instr)
 void
 Machine::OneInstruction(Instruction *instr)
 {
-    int raw;
-    int nextLoadReg = 0; 	
-    int nextLoadValue = 0; 	// record delayed load operation, to apply
-				// in the future
+    InstrResult result;
 
     // Fetch instruction 
-    if (!machine->ReadMem(registers[PCReg], 4, &raw))
+    if (!FetchInstruction(instr))
 	return;			// exception occurred
-    instr->value = raw;
-    instr->Decode();
 
     if (DebugIsEnabled('m')) {
        struct OpString *str = &opStrings[instr->opCode];
@@ -113,455 +857,259 @@ Machine::OneInstruction(Instruction *instr)
 		TypeToReg(str->args[1], instr), TypeToReg(str->args[2], instr));
        printf("\n");
        }
-    
+
     // Compute next pc, but don't install in case there's an error or branch.
-    int pcAfter = registers[NextPCReg] + 4;
-    int sum, diff, tmp, value;
-    unsigned int rs, rt, imm;
+    result.pcAfter = registers[NextPCReg] + 4;
+    result.loadReg = 0;
+    result.loadValue = 0;
+
+    // Execute the instruction
+    if (!(*opHandlers[instr->opCode])(this, instr, &result))
+	return;			// exception occurred
 
-    // Execute the instruction (cf. Kane's book)
-    switch (instr->opCode) {
-	
-      case OP_ADD:
-	sum = registers[instr->rs] + registers[instr->rt];
-	if (!((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
-	    ((registers[instr->rs] ^ sum) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rd] = sum;
-	break;
-	
-      case OP_ADDI:
-	sum = registers[instr->rs] + instr->extra;
-	if (!((registers[instr->rs] ^ instr->extra) & SIGN_BIT) &&
-	    ((instr->extra ^ sum) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rt] = sum;
-	break;
-	
-      case OP_ADDIU:
-	registers[instr->rt] = registers[instr->rs] + instr->extra;
-	break;
-	
-      case OP_ADDU:
-	registers[instr->rd] = registers[instr->rs] + registers[instr->rt];
-	break;
-	
-      case OP_AND:
-	registers[instr->rd] = registers[instr->rs] & registers[instr->rt];
-	break;
-	
-      case OP_ANDI:
-	registers[instr->rt] = registers[instr->rs] & (instr->extra & 0xffff);
-	break;
-	
-      case OP_BEQ:
-	if (registers[instr->rs] == registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BGEZAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BGEZ:
-	if (!(registers[instr->rs] & SIGN_BIT))
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BGTZ:
-	if (registers[instr->rs] > 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BLEZ:
-	if (registers[instr->rs] <= 0)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BLTZAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_BLTZ:
-	if (registers[instr->rs] & SIGN_BIT)
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_BNE:
-	if (registers[instr->rs] != registers[instr->rt])
-	    pcAfter = registers[NextPCReg] + IndexToAddr(instr->extra);
-	break;
-	
-      case OP_DIV:
-	if (registers[instr->rt] == 0) {
-	    registers[LoReg] = 0;
-	    registers[HiReg] = 0;
-	} else {
-	    registers[LoReg] =  registers[instr->rs] / registers[instr->rt];
-	    registers[HiReg] = registers[instr->rs] % registers[instr->rt];
-	}
-	break;
-	
-      case OP_DIVU:	  
-	  rs = (unsigned int) registers[instr->rs];
-	  rt = (unsigned int) registers[instr->rt];
-	  if (rt == 0) {
-	      registers[LoReg] = 0;
-	      registers[HiReg] = 0;
-	  } else {
-	      tmp = rs / rt;
-	      registers[LoReg] = (int) tmp;
-	      tmp = rs % rt;
-	      registers[HiReg] = (int) tmp;
-	  }
-	  break;
-	
-      case OP_JAL:
-	registers[R31] = registers[NextPCReg] + 4;
-      case OP_J:
-	pcAfter = (pcAfter & 0xf0000000) | IndexToAddr(instr->extra);
-	break;
-	
-      case OP_JALR:
-	registers[instr->rd] = registers[NextPCReg] + 4;
-      case OP_JR:
-	pcAfter = registers[instr->rs];
-	break;
-	
-      case OP_LB:
-      case OP_LBU:
-	tmp = registers[instr->rs] + instr->extra;
-	if (!machine->ReadMem(tmp, 1, &value))
-	    return;
-
-	if ((value & 0x80) && (instr->opCode == OP_LB))
-	    value |= 0xffffff00;
-	else
-	    value &= 0xff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-	
-      case OP_LH:
-      case OP_LHU:	  
-	tmp = registers[instr->rs] + instr->extra;
-	if (tmp & 0x1) {
-	    RaiseException(AddressErrorException, tmp);
-	    return;
-	}
-	if (!machine->ReadMem(tmp, 2, &value))
-	    return;
-
-	if ((value & 0x8000) && (instr->opCode == OP_LH))
-	    value |= 0xffff0000;
-	else
-	    value &= 0xffff;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-      	
-      case OP_LUI:
-	DEBUG('m', "Executing: LUI r%d,%d\n", instr->rt, instr->extra);
-	registers[instr->rt] = instr->extra << 16;
-	break;
-	
-      case OP_LW:
-	tmp = registers[instr->rs] + instr->extra;
-	if (tmp & 0x3) {
-	    RaiseException(AddressErrorException, tmp);
-	    return;
-	}
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	nextLoadReg = instr->rt;
-	nextLoadValue = value;
-	break;
-    	
-      case OP_LWL:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// ReadMem assumes all 4 byte requests are aligned on an even 
-	// word boundary.  Also, the little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
-	else
-	    nextLoadValue = registers[instr->rt];
-	switch (tmp & 0x3) {
-	  case 0:
-	    nextLoadValue = value;
-	    break;
-	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xff) | (value << 8);
-	    break;
-	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xffff) | (value << 16);
-	    break;
-	  case 3:
-	    nextLoadValue = (nextLoadValue & 0xffffff) | (value << 24);
-	    break;
-	}
-	nextLoadReg = instr->rt;
-	break;
-      	
-      case OP_LWR:
-	tmp = registers[instr->rs] + instr->extra;
-
-	// ReadMem assumes all 4 byte requests are aligned on an even 
-	// word boundary.  Also, the little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem(tmp, 4, &value))
-	    return;
-	if (registers[LoadReg] == instr->rt)
-	    nextLoadValue = registers[LoadValueReg];
-	else
-	    nextLoadValue = registers[instr->rt];
-	switch (tmp & 0x3) {
-	  case 0:
-	    nextLoadValue = (nextLoadValue & 0xffffff00) |
-		((value >> 24) & 0xff);
-	    break;
-	  case 1:
-	    nextLoadValue = (nextLoadValue & 0xffff0000) |
-		((value >> 16) & 0xffff);
-	    break;
-	  case 2:
-	    nextLoadValue = (nextLoadValue & 0xff000000)
-		| ((value >> 8) & 0xffffff);
-	    break;
-	  case 3:
-	    nextLoadValue = value;
-	    break;
-	}
-	nextLoadReg = instr->rt;
-	break;
-    	
-      case OP_MFHI:
-	registers[instr->rd] = registers[HiReg];
-	break;
-	
-      case OP_MFLO:
-	registers[instr->rd] = registers[LoReg];
-	break;
-	
-      case OP_MTHI:
-	registers[HiReg] = registers[instr->rs];
-	break;
-	
-      case OP_MTLO:
-	registers[LoReg] = registers[instr->rs];
-	break;
-	
-      case OP_MULT:
-	Mult(registers[instr->rs], registers[instr->rt], TRUE,
-	     &registers[HiReg], &registers[LoReg]);
-	break;
-	
-      case OP_MULTU:
-	Mult(registers[instr->rs], registers[instr->rt], FALSE,
-	     &registers[HiReg], &registers[LoReg]);
-	break;
-	
-      case OP_NOR:
-	registers[instr->rd] = ~(registers[instr->rs] | registers[instr->rt]);
-	break;
-	
-      case OP_OR:
-	registers[instr->rd] = registers[instr->rs] | registers[instr->rs];
-	break;
-	
-      case OP_ORI:
-	registers[instr->rt] = registers[instr->rs] | (instr->extra & 0xffff);
-	break;
-	
-      case OP_SB:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 1, registers[instr->rt]))
-	    return;
-	break;
-	
-      case OP_SH:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 2, registers[instr->rt]))
-	    return;
-	break;
-	
-      case OP_SLL:
-	registers[instr->rd] = registers[instr->rt] << instr->extra;
-	break;
-	
-      case OP_SLLV:
-	registers[instr->rd] = registers[instr->rt] <<
-	    (registers[instr->rs] & 0x1f);
-	break;
-	
-      case OP_SLT:
-	if (registers[instr->rs] < registers[instr->rt])
-	    registers[instr->rd] = 1;
-	else
-	    registers[instr->rd] = 0;
-	break;
-	
-      case OP_SLTI:
-	if (registers[instr->rs] < instr->extra)
-	    registers[instr->rt] = 1;
-	else
-	    registers[instr->rt] = 0;
-	break;
-	
-      case OP_SLTIU:	  
-	rs = registers[instr->rs];
-	imm = instr->extra;
-	if (rs < imm)
-	    registers[instr->rt] = 1;
-	else
-	    registers[instr->rt] = 0;
-	break;
-      	
-      case OP_SLTU:	  
-	rs = registers[instr->rs];
-	rt = registers[instr->rt];
-	if (rs < rt)
-	    registers[instr->rd] = 1;
-	else
-	    registers[instr->rd] = 0;
-	break;
-      	
-      case OP_SRA:
-	registers[instr->rd] = registers[instr->rt] >> instr->extra;
-	break;
-	
-      case OP_SRAV:
-	registers[instr->rd] = registers[instr->rt] >>
-	    (registers[instr->rs] & 0x1f);
-	break;
-	
-      case OP_SRL:
-	tmp = registers[instr->rt];
-	tmp >>= instr->extra;
-	registers[instr->rd] = tmp;
-	break;
-	
-      case OP_SRLV:
-	tmp = registers[instr->rt];
-	tmp >>= (registers[instr->rs] & 0x1f);
-	registers[instr->rd] = tmp;
-	break;
-	
-      case OP_SUB:	  
-	diff = registers[instr->rs] - registers[instr->rt];
-	if (((registers[instr->rs] ^ registers[instr->rt]) & SIGN_BIT) &&
-	    ((registers[instr->rs] ^ diff) & SIGN_BIT)) {
-	    RaiseException(OverflowException, 0);
-	    return;
-	}
-	registers[instr->rd] = diff;
-	break;
-      	
-      case OP_SUBU:
-	registers[instr->rd] = registers[instr->rs] - registers[instr->rt];
-	break;
-	
-      case OP_SW:
-	if (!machine->WriteMem((unsigned) 
-		(registers[instr->rs] + instr->extra), 4, registers[instr->rt]))
-	    return;
-	break;
-	
-      case OP_SWL:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// The little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
-	switch (tmp & 0x3) {
-	  case 0:
-	    value = registers[instr->rt];
-	    break;
-	  case 1:
-	    value = (value & 0xff000000) | ((registers[instr->rt] >> 8) &
-					    0xffffff);
-	    break;
-	  case 2:
-	    value = (value & 0xffff0000) | ((registers[instr->rt] >> 16) &
-					    0xffff);
-	    break;
-	  case 3:
-	    value = (value & 0xffffff00) | ((registers[instr->rt] >> 24) &
-					    0xff);
-	    break;
-	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
-	break;
-    	
-      case OP_SWR:	  
-	tmp = registers[instr->rs] + instr->extra;
-
-	// The little endian/big endian swap code would
-        // fail (I think) if the other cases are ever exercised.
-	ASSERT((tmp & 0x3) == 0);  
-
-	if (!machine->ReadMem((tmp & ~0x3), 4, &value))
-	    return;
-	switch (tmp & 0x3) {
-	  case 0:
-	    value = (value & 0xffffff) | (registers[instr->rt] << 24);
-	    break;
-	  case 1:
-	    value = (value & 0xffff) | (registers[instr->rt] << 16);
-	    break;
-	  case 2:
-	    value = (value & 0xff) | (registers[instr->rt] << 8);
-	    break;
-	  case 3:
-	    value = registers[instr->rt];
-	    break;
-	}
-	if (!machine->WriteMem((tmp & ~0x3), 4, value))
-	    return;
-	break;
-    	
-      case OP_SYSCALL:
-	RaiseException(SyscallException, 0);
-	return; 
-	
-      case OP_XOR:
-	registers[instr->rd] = registers[instr->rs] ^ registers[instr->rt];
-	break;
-	
-      case OP_XORI:
-	registers[instr->rt] = registers[instr->rs] ^ (instr->extra & 0xffff);
-	break;
-	
-      case OP_RES:
-      case OP_UNIMP:
-	RaiseException(IllegalInstrException, 0);
-	return;
-	
-      default:
-	ASSERT(FALSE);
-    }
-    
     // Now we have successfully executed the instruction.
-    
+
     // Do any delayed load operation
-    DelayedLoad(nextLoadReg, nextLoadValue);
-    
+    DelayedLoad(result.loadReg, result.loadValue);
+
     // Advance program counters.
     registers[PrevPCReg] = registers[PCReg];	// for debugging, in case we
 						// are jumping into lala-land
     registers[PCReg] = registers[NextPCReg];
-    registers[NextPCReg] = pcAfter;
+    registers[NextPCReg] = result.pcAfter;
+}
+
+//----------------------------------------------------------------------
+// Machine::RunBlock
+// 	Run the basic block starting at PC, if we can do so without
+//	the result being any different from running it one instruction
+//	at a time.
+//
+//	We dispatch straight to each instruction's pre-bound handler,
+//	and only call into the interrupt simulation once per block: the
+//	block is only run if no interrupt can come due before its last
+//	instruction, so the OneTick calls in between would have done
+//	nothing but advance the clock.  Instead, we add their ticks to
+//	unchargedTicks, and leave the last instruction's tick to the
+//	caller, as for OneInstruction.  If an instruction traps part way
+//	through, RaiseException charges the ticks of the ones before it.
+//
+// Returns:
+//	FALSE if the block couldn't be run (we are in a delay slot,
+//	PC doesn't translate, or an interrupt or the end of the time
+//	slice is too close), in which
+//	case nothing has been done and the caller should fall back to
+//	OneInstruction.  TRUE otherwise.
+//----------------------------------------------------------------------
+
+bool
+Machine::RunBlock()
+{
+    CompiledInstr *code, *start;
+    InstrResult result;
+    int physAddr, length, quiet, stop;
+
+    if (registers[NextPCReg] != registers[PCReg] + 4)
+	return FALSE;		// a branch is pending
+    if (Translate(registers[PCReg], &physAddr, 4, FALSE) != NoException)
+	return FALSE;		// OneInstruction will raise the exception
+    if (!frameDecoded[physAddr / PageSize])
+	DecodeFrame(physAddr / PageSize);
+
+    start = &decodeCache[physAddr / 4];
+    if (start->blockLength == 0)
+	FindBlock(physAddr);
+    length = start->blockLength;
+
+    // how many more instructions can we run before an interrupt is due,
+    // or (with more than one CPU) before the time slice is up?
+    stop = interrupt->NextDueTime();
+    if ((numCpus > 1) && (sliceEnd < stop))
+	stop = sliceEnd;
+    quiet = (stop - stats->totalTicks - 1) / UserTick - unchargedTicks;
+    if (length - 1 > quiet)
+	return FALSE;
+
+    blockChanged = FALSE;
+    for (code = start; code < start + length; code++) {
+	if (code != start)
+	    unchargedTicks++;	// for the previous instruction
+
+	result.pcAfter = registers[NextPCReg] + 4;
+	result.loadReg = 0;
+	result.loadValue = 0;
+	if (!(*code->handler)(this, &code->instr, &result))
+	    return TRUE;	// exception occurred
+
+	DelayedLoad(result.loadReg, result.loadValue);
+	registers[PrevPCReg] = registers[PCReg];
+	registers[PCReg] = registers[NextPCReg];
+	registers[NextPCReg] = result.pcAfter;
+
+	if (blockChanged)	// a store changed the shape of the block
+	    break;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::FindBlock
+// 	Work out the length of the basic block starting at "physAddr":
+//	the instructions up to and including the next branch or jump
+//	and its delay slot, or up to the next system call.  Blocks never
+//	cross a page boundary, since the next virtual page may map to
+//	any frame; a branch in the last word of a page ends its block
+//	without its delay slot.
+//----------------------------------------------------------------------
+
+void
+Machine::FindBlock(int physAddr)
+{
+    CompiledInstr *start = &decodeCache[physAddr / 4];
+    CompiledInstr *end = &decodeCache[(physAddr / PageSize + 1) * InstrsPerPage];
+    CompiledInstr *code = start;
+
+    while (code < end) {
+	if (EndsBlock((code++)->instr.opCode)) {
+	    if (code < end && code->instr.opCode != OP_SYSCALL)
+		code++;		// take the delay slot along
+	    break;
+	}
+    }
+    start->blockLength = code - start;
+}
+
+//----------------------------------------------------------------------
+// Machine::ChargeTicks
+// 	Add the time taken by the user instructions we haven't yet 
+//	charged for to the simulated clock.  Must be done before calling
+//	OneTick, or trapping into the kernel, which expect the clock to 
+//	be up to date.
+//----------------------------------------------------------------------
+
+void
+Machine::ChargeTicks()
+{
+    if (unchargedTicks > 0) {
+	interrupt->AdvanceUserTime(unchargedTicks);
+	unchargedTicks = 0;
+    }
+}
+
+//----------------------------------------------------------------------
+// Machine::FetchInstruction
+// 	Fetch the instruction at the current PC into "instr", already
+//	decoded.
+//
+//	Decoding is done once per physical page frame, the first time
+//	we execute out of it; after that we just copy the cached
+//	decoding.  The copy is kept up to date by WriteMem, and thrown 
+//	away by InvalidateFrame when the kernel changes a frame behind 
+//	our back.
+//
+//	Returns FALSE if the fetch caused an exception (which has 
+//	already been raised).
+//----------------------------------------------------------------------
+
+bool
+Machine::FetchInstruction(Instruction *instr)
+{
+    ExceptionType exception;
+    int physAddr;
+
+    exception = Translate(registers[PCReg], &physAddr, 4, FALSE);
+    if (exception != NoException) {
+	RaiseException(exception, registers[PCReg]);
+	return FALSE;
+    }
+    if (!frameDecoded[physAddr / PageSize])
+	DecodeFrame(physAddr / PageSize);
+    *instr = decodeCache[physAddr / 4].instr;
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodeFrame
+// 	Decode every word in a physical page frame into the decode cache.
+//	Some of the words may be data rather than code; decoding them is
+//	harmless, since we only ever look at words we jump to.
+//
+//	"frame" -- the physical page to decode
+//----------------------------------------------------------------------
+
+void
+Machine::DecodeFrame(int frame)
+{
+    for (int i = 0; i < InstrsPerPage; i++)
+	DecodeWord(frame * PageSize + i * 4);
+    frameDecoded[frame] = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::DecodeWord
+// 	Decode the word of mainMemory at "physAddr" into the decode
+//	cache, and bind it to the handler for its opcode.  Any basic
+//	block that starts at this word will have to be found again.
+//----------------------------------------------------------------------
+
+void
+Machine::DecodeWord(int physAddr)
+{
+    CompiledInstr *code = &decodeCache[physAddr / 4];
+
+    code->instr.value = WordToHost(*(unsigned int *) &mainMemory[physAddr]);
+    code->instr.Decode();
+    code->handler = opHandlers[code->instr.opCode];
+    code->blockLength = 0;
+}
+
+//----------------------------------------------------------------------
+// Machine::WordChanged
+// 	Called by WriteMem after a store into a frame we have decoded,
+//	to keep the decoded copy of the word up to date, in case we
+//	execute it later (self-modifying code, or a page holding both
+//	code and data).
+//
+//	Basic blocks only record where they end, so they stay valid
+//	unless the store turned a word into a branch or system call,
+//	or vice versa.  In that case, forget every block in the frame
+//	up to the word, since any of them might run into it.
+//
+//	"physAddr" -- the (word-aligned) physical address written
+//----------------------------------------------------------------------
+
+void
+Machine::WordChanged(int physAddr)
+{
+    CompiledInstr *code = &decodeCache[physAddr / 4];
+    bool endedBlock = EndsBlock(code->instr.opCode);
+    int blockLength = code->blockLength;
+
+    DecodeWord(physAddr);
+    if (EndsBlock(code->instr.opCode) == endedBlock) {
+	code->blockLength = blockLength;
+	return;
+    }
+    for (code = &decodeCache[(physAddr / PageSize) * InstrsPerPage];
+			code <= &decodeCache[physAddr / 4]; code++)
+	code->blockLength = 0;
+    blockChanged = TRUE;
+}
+
+//----------------------------------------------------------------------
+// Machine::InvalidateFrame
+// 	Throw away the cached decoding of a physical page frame, because
+//	the kernel has changed its contents directly (for instance, by
+//	loading a program into it).
+//
+//	"frame" -- the physical page that changed
+//----------------------------------------------------------------------
+
+void
+Machine::InvalidateFrame(int frame)
+{
+    ASSERT((frame >= 0) && (frame < NumPhysPages));
+    frameDecoded[frame] = FALSE;
 }
 
 //----------------------------------------------------------------------
@@ -19,9 +19,24 @@
 Statistics::Statistics()
 {
     totalTicks = idleTicks = systemTicks = userTicks = 0;
+    latestTicks = 0;
     numDiskReads = numDiskWrites = 0;
+    seekTracks = diskQueueLength = maxDiskQueue = 0;
     numConsoleCharsRead = numConsoleCharsWritten = 0;
     numPageFaults = numPacketsSent = numPacketsRecvd = 0;
+    numPageOuts = numTlbMisses = 0;
+    numCowFaults = numCowCopies = numTextShares = 0;
+    numAioRequests = maxAioInFlight = 0;
+    numSystemCalls = numBatchedCalls = 0;
+    numCacheHits = numCacheMisses = numReadAheads = 0;
+    numCpus = 1;
+    for (int i = 0; i < MaxCpus; i++)
+	cpuUserTicks[i] = cpuSystemTicks[i] = 0;
+    numLockAcquires = numLockWaits = lockWaitTicks = maxLockWaiters = 0;
+    numConditionWaits = conditionWaitTicks = maxConditionWaiters = 0;
+    numContextSwitches = numQueueLevels = 0;
+    for (int i = 0; i < MaxQueueLevels; i++)
+	levelTicks[i] = 0;
 }
 
 //----------------------------------------------------------------------
@@ -35,10 +50,105 @@ Statistics::Print()
 {
     printf("Ticks: total %d, idle %d, system %d, user %d\n", totalTicks, 
 	idleTicks, systemTicks, userTicks);
+    if (numCpus > 1)
+	for (int i = 0; i < numCpus; i++)
+	    printf("CPU %d: idle %d, system %d, user %d\n", i, 
+		totalTicks - cpuSystemTicks[i] - cpuUserTicks[i],
+		cpuSystemTicks[i], cpuUserTicks[i]);
     printf("Disk I/O: reads %d, writes %d\n", numDiskReads, numDiskWrites);
+    if (numDiskReads + numDiskWrites > 0)
+	printf("Disk scheduling: average seek %.2f tracks, average queue %.2f, "
+	    "longest queue %d\n",
+	    (double) seekTracks / (numDiskReads + numDiskWrites),
+	    (double) diskQueueLength / (numDiskReads + numDiskWrites),
+	    maxDiskQueue);
     printf("Console I/O: reads %d, writes %d\n", numConsoleCharsRead, 
 	numConsoleCharsWritten);
     printf("Paging: faults %d\n", numPageFaults);
+    if (numPageOuts > 0)
+	printf("Swap: pages written %d\n", numPageOuts);
+    if (numTlbMisses > 0)
+	printf("TLB: misses %d, %.2f per 1000 user instructions\n",
+	    numTlbMisses, (1000.0 * numTlbMisses) / userTicks);
+    if (numCowFaults > 0)
+	printf("Copy on write: faults %d, pages copied %d\n", numCowFaults,
+	    numCowCopies);
+    if (numTextShares > 0)
+	printf("Shared code: pages %d\n", numTextShares);
+    if (numAioRequests > 0)
+	printf("Asynchronous I/O: requests %d, most in progress %d\n",
+	    numAioRequests, maxAioInFlight);
+    if (numBatchedCalls > 0)
+	printf("System calls: traps %d, batched calls %d\n", numSystemCalls,
+	    numBatchedCalls);
+    if (numCacheHits + numCacheMisses > 0)
+	printf("Buffer cache: hits %d, misses %d, read ahead %d\n", 
+	    numCacheHits, numCacheMisses, numReadAheads);
     printf("Network I/O: packets received %d, sent %d\n", numPacketsRecvd, 
 	numPacketsSent);
+    if (numLockAcquires > 0)
+	printf("Locks: acquires %d, waits %d, wait ticks %d, max waiting %d\n",
+	    numLockAcquires, numLockWaits, lockWaitTicks, maxLockWaiters);
+    if (numConditionWaits > 0)
+	printf("Conditions: waits %d, wait ticks %d, max waiting %d\n",
+	    numConditionWaits, conditionWaitTicks, maxConditionWaiters);
+    if (numContextSwitches > 0)
+	printf("Context switches: %d\n", numContextSwitches);
+    for (int i = 0; i < numQueueLevels; i++)
+	printf("Queue level %d: ticks %d\n", i, levelTicks[i]);
+}
+
+//----------------------------------------------------------------------
+// Statistics::Add
+// 	Add the performance metrics of another run of Nachos to ours,
+//	to get the totals for a batch of runs.
+//----------------------------------------------------------------------
+
+void
+Statistics::Add(Statistics *other)
+{
+    totalTicks += other->totalTicks;
+    idleTicks += other->idleTicks;
+    systemTicks += other->systemTicks;
+    userTicks += other->userTicks;
+    numDiskReads += other->numDiskReads;
+    numDiskWrites += other->numDiskWrites;
+    seekTracks += other->seekTracks;
+    diskQueueLength += other->diskQueueLength;
+    if (other->maxDiskQueue > maxDiskQueue)
+	maxDiskQueue = other->maxDiskQueue;
+    numConsoleCharsRead += other->numConsoleCharsRead;
+    numConsoleCharsWritten += other->numConsoleCharsWritten;
+    numPageFaults += other->numPageFaults;
+    numPageOuts += other->numPageOuts;
+    numTlbMisses += other->numTlbMisses;
+    numCowFaults += other->numCowFaults;
+    numCowCopies += other->numCowCopies;
+    numTextShares += other->numTextShares;
+    numAioRequests += other->numAioRequests;
+    if (other->maxAioInFlight > maxAioInFlight)
+	maxAioInFlight = other->maxAioInFlight;
+    numSystemCalls += other->numSystemCalls;
+    numBatchedCalls += other->numBatchedCalls;
+    numCacheHits += other->numCacheHits;
+    numCacheMisses += other->numCacheMisses;
+    numReadAheads += other->numReadAheads;
+    numPacketsSent += other->numPacketsSent;
+    numPacketsRecvd += other->numPacketsRecvd;
+    for (int i = 0; i < MaxCpus; i++) {
+	cpuUserTicks[i] += other->cpuUserTicks[i];
+	cpuSystemTicks[i] += other->cpuSystemTicks[i];
+    }
+    numLockAcquires += other->numLockAcquires;
+    numLockWaits += other->numLockWaits;
+    lockWaitTicks += other->lockWaitTicks;
+    if (other->maxLockWaiters > maxLockWaiters)
+	maxLockWaiters = other->maxLockWaiters;
+    numConditionWaits += other->numConditionWaits;
+    conditionWaitTicks += other->conditionWaitTicks;
+    if (other->maxConditionWaiters > maxConditionWaiters)
+	maxConditionWaiters = other->maxConditionWaiters;
+    numContextSwitches += other->numContextSwitches;
+    for (int i = 0; i < MaxQueueLevels; i++)
+	levelTicks[i] += other->levelTicks[i];
 }
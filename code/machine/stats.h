@@ -13,6 +13,9 @@
 
 #include "copyright.h"
 
+#define MaxCpus		8	// most CPUs we can simulate at once
+#define MaxQueueLevels	8	// most levels of multilevel feedback queue
+
 // The following class defines the statistics that are to be kept
 // about Nachos behavior -- how much time (ticks) elapsed, how
 // many user instructions executed, etc.
@@ -22,6 +25,9 @@
 class Statistics {
   public:
     int totalTicks;      	// Total time running Nachos
+    int latestTicks;		// the latest time any CPU has got to;
+				// with several CPUs, totalTicks goes
+				// back for each one's turn (see Now)
     int idleTicks;       	// Time spent idle (no threads to run)
     int systemTicks;	 	// Time spent executing system code
     int userTicks;       	// Time spent executing user code
@@ -30,15 +36,55 @@ class Statistics {
 
     int numDiskReads;		// number of disk read requests
     int numDiskWrites;		// number of disk write requests
+    int seekTracks;		// how many tracks the disk head moved
+    int diskQueueLength;	// requests queued for the disk when each
+				// one arrived, counting itself
+    int maxDiskQueue;		// most requests queued at once
     int numConsoleCharsRead;	// number of characters read from the keyboard
     int numConsoleCharsWritten; // number of characters written to the display
     int numPageFaults;		// number of virtual memory page faults
+    int numPageOuts;		// number of pages written to swap
+    int numTlbMisses;		// number of TLB misses
+    int numCowFaults;		// number of writes to copy-on-write pages
+    int numCowCopies;		// number of those that copied the page
+    int numTextShares;		// number of code pages found already loaded
+    int numAioRequests;		// number of asynchronous reads and writes
+    int maxAioInFlight;		// most of them in progress at once
+    int numSystemCalls;		// number of traps for system calls
+    int numBatchedCalls;	// number of calls made by MultiCall
+    int numCacheHits;		// number of disk sectors found in the
+				// buffer cache
+    int numCacheMisses;		// number that weren't
+    int numReadAheads;		// number read into the cache before
+				// they were asked for
     int numPacketsSent;		// number of packets sent over the network
     int numPacketsRecvd;	// number of packets received over the network
 
+    int numCpus;		// number of simulated CPUs (-cpus)
+    int cpuUserTicks[MaxCpus];	// time each CPU spent executing user
+    int cpuSystemTicks[MaxCpus];	// and system code
+
+    int numLockAcquires;	// number of times a lock was acquired
+    int numLockWaits;		// number of those that had to wait
+    int lockWaitTicks;		// time threads spent waiting for locks
+    int maxLockWaiters;		// most threads waiting for one lock
+    int numConditionWaits;	// number of waits on condition variables
+    int conditionWaitTicks;	// time threads spent waiting to be signalled
+    int maxConditionWaiters;	// most threads waiting on one condition
+
+    int numContextSwitches;	// number of switches between threads
+    int numQueueLevels;		// levels of feedback queue (-mlfq), or 0
+    int levelTicks[MaxQueueLevels];	// time threads spent running at
+				// each level
+
     Statistics(); 		// initialize everything to zero
 
+    int Now()			// the time, as a clock that never goes
+				// backwards, for timing waits
+	{ return (totalTicks > latestTicks) ? totalTicks : latestTicks; }
+
     void Print();		// print collected statistics
+    void Add(Statistics *other);	// add in another run's statistics
 };
 
 // Constants used to reflect the relative time an operation would
@@ -56,5 +102,7 @@ class Statistics {
 #define ConsoleTime 	100	// time to read or write one character
 #define NetworkTime 	100   	// time to send or receive one packet
 #define TimerTicks 	100    	// (average) time between timer interrupts
+#define CpuSlice	100	// time each CPU runs before the next one
+				// gets a turn, when there are several
 
 #endif // STATS_H
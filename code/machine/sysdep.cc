@@ -35,6 +35,8 @@ extern "C" {
 #include <sys/file.h>
 #include <sys/un.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #ifdef HOST_i386
 #include <unistd.h>
 #include <sys/time.h>
@@ -254,6 +256,38 @@ Close(int fd)
     ASSERT(retVal >= 0); 
 }
 
+//----------------------------------------------------------------------
+// FileNumber
+// 	Return a number that identifies an open file on the host -- the
+//	same for every open file that is the same file.
+//----------------------------------------------------------------------
+
+int
+FileNumber(int fd)
+{
+    struct stat info;
+    int retVal = fstat(fd, &info);
+
+    ASSERT(retVal >= 0);
+    return (int) info.st_ino;
+}
+
+//----------------------------------------------------------------------
+// FileDevice
+// 	Return the number of the host device an open file is on; file
+//	numbers are only unique within a device.
+//----------------------------------------------------------------------
+
+int
+FileDevice(int fd)
+{
+    struct stat info;
+    int retVal = fstat(fd, &info);
+
+    ASSERT(retVal >= 0);
+    return (int) info.st_dev;
+}
+
 //----------------------------------------------------------------------
 // Unlink
 // 	Delete a file.
@@ -438,6 +472,68 @@ Exit(int exitCode)
     exit(exitCode);
 }
 
+//----------------------------------------------------------------------
+// StartHostProcess
+// 	Make a copy of the UNIX process running Nachos.  Return 0 in 
+//	the copy, and the copy's process id in the original.
+//----------------------------------------------------------------------
+
+int
+StartHostProcess()
+{
+    int pid = fork();
+
+    ASSERT(pid >= 0);
+    return pid;
+}
+
+//----------------------------------------------------------------------
+// WaitForHostProcess
+// 	Wait for one of the copies made by StartHostProcess to exit.
+//	Return its process id, and set "succeeded" if it exited normally.
+//----------------------------------------------------------------------
+
+int
+WaitForHostProcess(bool *succeeded)
+{
+    int status;
+    int pid = wait(&status);
+
+    ASSERT(pid > 0);
+    *succeeded = WIFEXITED(status) && (WEXITSTATUS(status) == 0);
+    return pid;
+}
+
+//----------------------------------------------------------------------
+// RedirectOutput
+// 	Send everything printed from now on to the open file "fd",
+//	instead of to the display.
+//----------------------------------------------------------------------
+
+void
+RedirectOutput(int fd)
+{
+    fflush(stdout);
+    int retVal = dup2(fd, 1);
+    ASSERT(retVal == 1);
+}
+
+//----------------------------------------------------------------------
+// OpenScratchFile
+// 	Create a temporary file, open for reading and writing, and
+//	return its file descriptor.  The file goes away when Nachos 
+//	(and any copies of it sharing the file) exit.
+//----------------------------------------------------------------------
+
+int
+OpenScratchFile()
+{
+    FILE *file = tmpfile();
+
+    ASSERT(file != NULL);
+    return fileno(file);
+}
+
 //----------------------------------------------------------------------
 // RandomInit
 // 	Initialize the pseudo-random number generator.  We use the
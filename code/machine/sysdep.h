@@ -27,6 +27,8 @@ extern void WriteFile(int fd, char *buffer, int nBytes);
 extern void Lseek(int fd, int offset, int whence);
 extern int Tell(int fd);
 extern void Close(int fd);
+extern int FileNumber(int fd);
+extern int FileDevice(int fd);
 extern bool Unlink(char *name);
 
 // Interprocess communication operations, for simulating the network
@@ -43,6 +45,12 @@ extern void Abort();
 extern void Exit(int exitCode);
 extern void Delay(int seconds);
 
+// Running copies of Nachos side by side, in separate host processes
+extern int StartHostProcess();
+extern int WaitForHostProcess(bool *succeeded);
+extern void RedirectOutput(int fd);
+extern int OpenScratchFile();
+
 // Initialize system so that cleanUp routine is called when user hits ctl-C
 extern void CallOnUserAbort(VoidNoArgFunctionPtr cleanUp);
 
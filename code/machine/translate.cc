@@ -71,6 +71,52 @@ unsigned short
 ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 
 
+//----------------------------------------------------------------------
+// ReadHost, WriteHost
+//      Read or write "size" (1, 2, or 4) bytes of simulated memory,
+//	at "hostAddr" in mainMemory, converting to and from the 
+//	simulated machine's byte order.
+//----------------------------------------------------------------------
+
+static int
+ReadHost(char *hostAddr, int size)
+{
+    switch (size) {
+      case 1:
+	return *hostAddr;
+	
+      case 2:
+	return ShortToHost(*(unsigned short *) hostAddr);
+	
+      case 4:
+	return WordToHost(*(unsigned int *) hostAddr);
+
+      default: ASSERT(FALSE);
+    }
+    return 0;
+}
+
+static void
+WriteHost(char *hostAddr, int size, int value)
+{
+    switch (size) {
+      case 1:
+	*hostAddr = (unsigned char) (value & 0xff);
+	break;
+
+      case 2:
+	*(unsigned short *) hostAddr
+		= ShortToMachine((unsigned short) (value & 0xffff));
+	break;
+      
+      case 4:
+	*(unsigned int *) hostAddr = WordToMachine((unsigned int) value);
+	break;
+	
+      default: ASSERT(FALSE);
+    }
+}
+
 //----------------------------------------------------------------------
 // Machine::ReadMem
 //      Read "size" (1, 2, or 4) bytes of virtual memory at "addr" into 
@@ -87,10 +133,16 @@ ShortToMachine(unsigned short shortword) { return ShortToHost(shortword); }
 bool
 Machine::ReadMem(int addr, int size, int *value)
 {
-    int data;
     ExceptionType exception;
     int physicalAddress;
+    char *hostAddr;
     
+    hostAddr = CachedTranslate(addr, size, FALSE);
+    if (hostAddr != NULL) {		// quick path; never taken when
+	*value = ReadHost(hostAddr, size);	// tracing ('a')
+	return TRUE;
+    }
+
     DEBUG('a', "Reading VA 0x%x, size %d\n", addr, size);
     
     exception = Translate(addr, &physicalAddress, size, FALSE);
@@ -98,24 +150,7 @@ Machine::ReadMem(int addr, int size, int *value)
 	machine->RaiseException(exception, addr);
 	return FALSE;
     }
-    switch (size) {
-      case 1:
-	data = machine->mainMemory[physicalAddress];
-	*value = data;
-	break;
-	
-      case 2:
-	data = *(unsigned short *) &machine->mainMemory[physicalAddress];
-	*value = ShortToHost(data);
-	break;
-	
-      case 4:
-	data = *(unsigned int *) &machine->mainMemory[physicalAddress];
-	*value = WordToHost(data);
-	break;
-
-      default: ASSERT(FALSE);
-    }
+    *value = ReadHost(&machine->mainMemory[physicalAddress], size);
     
     DEBUG('a', "\tvalue read = %8.8x\n", *value);
     return (TRUE);
@@ -139,31 +174,26 @@ Machine::WriteMem(int addr, int size, int value)
 {
     ExceptionType exception;
     int physicalAddress;
+    char *hostAddr;
      
-    DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
+    hostAddr = CachedTranslate(addr, size, TRUE);
+    if (hostAddr != NULL)		// quick path
+	physicalAddress = hostAddr - mainMemory;
+    else {
+	DEBUG('a', "Writing VA 0x%x, size %d, value 0x%x\n", addr, size, value);
 
-    exception = Translate(addr, &physicalAddress, size, TRUE);
-    if (exception != NoException) {
-	machine->RaiseException(exception, addr);
-	return FALSE;
+	exception = Translate(addr, &physicalAddress, size, TRUE);
+	if (exception != NoException) {
+	    machine->RaiseException(exception, addr);
+	    return FALSE;
+	}
+	hostAddr = &machine->mainMemory[physicalAddress];
     }
-    switch (size) {
-      case 1:
-	machine->mainMemory[physicalAddress] = (unsigned char) (value & 0xff);
-	break;
+    WriteHost(hostAddr, size, value);
 
-      case 2:
-	*(unsigned short *) &machine->mainMemory[physicalAddress]
-		= ShortToMachine((unsigned short) (value & 0xffff));
-	break;
-      
-      case 4:
-	*(unsigned int *) &machine->mainMemory[physicalAddress]
-		= WordToMachine((unsigned int) value);
-	break;
-	
-      default: ASSERT(FALSE);
-    }
+    // keep the decoded copy of the word up to date
+    if (frameDecoded[physicalAddress / PageSize])
+	WordChanged(physicalAddress & ~0x3);
     
     return TRUE;
 }
@@ -190,6 +220,13 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     unsigned int vpn, offset;
     TranslationEntry *entry;
     unsigned int pageFrame;
+    char *hostAddr;
+
+    hostAddr = CachedTranslate(virtAddr, size, writing);
+    if (hostAddr != NULL) {		// use and dirty bits are already set
+	*physAddr = hostAddr - mainMemory;
+	return NoException;
+    }
 
     DEBUG('a', "\tTranslate 0x%x, %s: ", virtAddr, writing ? "write" : "read");
 
@@ -219,9 +256,12 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
 	    return PageFaultException;
 	}
 	entry = &pageTable[vpn];
-    } else {
-        for (entry = NULL, i = 0; i < TLBSize; i++)
-    	    if (tlb[i].valid && (tlb[i].virtualPage == vpn)) {
+    } else {				// search the set vpn maps to
+	int set = vpn % (tlbSize / tlbWays);
+
+        for (entry = NULL, i = set * tlbWays; i < (set + 1) * tlbWays; i++)
+    	    if (tlb[i].valid && (tlb[i].virtualPage == vpn) 
+					&& (tlb[i].asid == asid)) {
 		entry = &tlb[i];			// FOUND!
 		break;
 	    }
@@ -251,5 +291,60 @@ Machine::Translate(int virtAddr, int* physAddr, int size, bool writing)
     *physAddr = pageFrame * PageSize + offset;
     ASSERT((*physAddr >= 0) && ((*physAddr + size) <= MemorySize));
     DEBUG('a', "phys addr = 0x%x\n", *physAddr);
+
+    // remember the translation, unless we're tracing every one; a
+    // translation for writing is good for reading as well
+    if (!DebugIsEnabled('a')) {
+	CachedTranslation *cached = &transCache[0][vpn % TransCacheSize];
+
+	cached->virtualPage = vpn;
+	cached->hostPage = &mainMemory[pageFrame * PageSize];
+	if (writing)
+	    transCache[1][vpn % TransCacheSize] = *cached;
+    }
     return NoException;
 }
+
+//----------------------------------------------------------------------
+// Machine::CachedTranslate
+// 	Translate a virtual address straight to its location in mainMemory,
+//	using the translation cache.  This is the common case of Translate,
+//	without any of the checks: the cache only holds translations that
+//	Translate has already checked, and whose use (and, for writing, 
+//	dirty) bits it has already set.
+//
+//	Returns NULL if there is no cached translation for the page, for 
+//	this kind of access, or if the address is misaligned; the caller
+//	must then go through Translate.
+//
+//	"virtAddr" -- the virtual address to translate
+//	"size" -- the amount of memory being read or written
+// 	"writing" -- TRUE if the memory is being written
+//----------------------------------------------------------------------
+
+char *
+Machine::CachedTranslate(int virtAddr, int size, bool writing)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    CachedTranslation *cached = &transCache[writing][vpn % TransCacheSize];
+
+    if ((cached->virtualPage != vpn) || (virtAddr & (size - 1)))
+	return NULL;
+    return cached->hostPage + (unsigned) virtAddr % PageSize;
+}
+
+//----------------------------------------------------------------------
+// Machine::FlushTranslations
+// 	Empty the translation cache, because the translations it holds 
+//	may no longer be right: the kernel has switched to another page
+//	table, or changed the page table or TLB.
+//----------------------------------------------------------------------
+
+void
+Machine::FlushTranslations()
+{
+    for (int i = 0; i < TransCacheSize; i++) {
+	transCache[0][i].virtualPage = NoPage;
+	transCache[1][i].virtualPage = NoPage;
+    }
+}
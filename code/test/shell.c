@@ -6,25 +6,33 @@ main()
     SpaceId newProc;
     OpenFileId input = ConsoleInput;
     OpenFileId output = ConsoleOutput;
-    char prompt[2], ch, buffer[60];
+    char prompt[2], buffer[60];
+    SysCall calls[2];
     int i;
 
     prompt[0] = '-';
     prompt[1] = '-';
 
+    /* write the prompt and read a line, with one trap */
+    calls[0].code = SC_Write;
+    calls[0].arg1 = (int) prompt;
+    calls[0].arg2 = 2;
+    calls[0].arg3 = output;
+    calls[1].code = SC_Read;
+    calls[1].arg1 = (int) buffer;
+    calls[1].arg2 = sizeof(buffer) - 1;
+    calls[1].arg3 = input;
+
     while( 1 )
     {
-	Write(prompt, 2, output);
-
-	i = 0;
-	
-	do {
-	
-	    Read(&buffer[i], 1, input); 
+	MultiCall(calls, 2);
 
-	} while( buffer[i++] != '\n' );
-
-	buffer[--i] = '\0';
+	i = calls[1].result;
+	if( i < 0 )
+		i = 0;
+	else if( i > 0 && buffer[i - 1] == '\n' )
+		i--;
+	buffer[i] = '\0';
 
 	if( i > 0 ) {
 		newProc = Exec(buffer);
@@ -32,4 +40,3 @@ main()
 	}
     }
 }
-
@@ -130,6 +130,54 @@ Yield:
 	j	$31
 	.end Yield
 
+	.globl ReadV
+	.ent	ReadV
+ReadV:
+	addiu $2,$0,SC_ReadV
+	syscall
+	j	$31
+	.end ReadV
+
+	.globl WriteV
+	.ent	WriteV
+WriteV:
+	addiu $2,$0,SC_WriteV
+	syscall
+	j	$31
+	.end WriteV
+
+	.globl AioSetup
+	.ent	AioSetup
+AioSetup:
+	addiu $2,$0,SC_AioSetup
+	syscall
+	j	$31
+	.end AioSetup
+
+	.globl AioSubmit
+	.ent	AioSubmit
+AioSubmit:
+	addiu $2,$0,SC_AioSubmit
+	syscall
+	j	$31
+	.end AioSubmit
+
+	.globl AioWait
+	.ent	AioWait
+AioWait:
+	addiu $2,$0,SC_AioWait
+	syscall
+	j	$31
+	.end AioWait
+
+	.globl MultiCall
+	.ent	MultiCall
+MultiCall:
+	addiu $2,$0,SC_MultiCall
+	syscall
+	j	$31
+	.end MultiCall
+
 /* dummy function to keep gcc happy */
         .globl  __main
         .ent    __main
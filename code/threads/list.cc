@@ -127,6 +127,34 @@ List::Remove()
     return SortedRemove(NULL);  // Same as SortedRemove, but ignore the key
 }
 
+//----------------------------------------------------------------------
+// List::RemoveItem
+//      Remove "item" from the list, wherever it is on it.  Sorted lists
+//	stay sorted.
+// 
+// Returns:
+//	TRUE if the item was on the list.
+//----------------------------------------------------------------------
+
+bool
+List::RemoveItem(void *item)
+{
+    ListElement *ptr, *prev = NULL;
+
+    for (ptr = first; ptr != NULL; prev = ptr, ptr = ptr->next)
+	if (ptr->item == item) {
+	    if (prev == NULL)
+		first = ptr->next;
+	    else
+		prev->next = ptr->next;
+	    if (last == ptr)
+		last = prev;
+	    delete ptr;
+	    return TRUE;
+	}
+    return FALSE;
+}
+
 //----------------------------------------------------------------------
 // List::Mapcar
 //	Apply a function to each item on the list, by walking through  
@@ -236,3 +264,25 @@ List::SortedRemove(int *keyPtr)
     return thing;
 }
 
+//----------------------------------------------------------------------
+// List::SortedPeek
+//      Return the first "item" of a sorted list, without removing it.
+//
+// Returns:
+//	Pointer to the first item, NULL if nothing on the list.
+//	Sets *keyPtr to the priority value of the item.
+//
+//	"keyPtr" is a pointer to the location in which to store the 
+//		priority of the item.
+//----------------------------------------------------------------------
+
+void *
+List::SortedPeek(int *keyPtr)
+{
+    if (IsEmpty()) 
+	return NULL;
+
+    if (keyPtr != NULL)
+        *keyPtr = first->key;
+    return first->item;
+}
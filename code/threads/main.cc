@@ -8,9 +8,12 @@
 //
 // 	Most of this file is not needed until later assignments.
 //
-// Usage: nachos -d <debugflags> -rs <random seed #>
-//		-s -x <nachos file> -c <consoleIn> <consoleOut>
-//		-f -cp <unix file> <nachos file>
+// Usage: nachos -d <debugflags> -rs <random seed #> -mlfq <quanta>
+//		-s -b -cpus <# of CPUs> -x <nachos file> 
+//		-j <# of host processes> -c <consoleIn> <consoleOut>
+//		-tlb <# of TLB entries> -assoc <ways> 
+//		-tlbr <random, fifo or lru> -rp <fifo, clock or lru>
+//		-f -ds <fcfs, sstf or clook> -cp <unix file> <nachos file>
 //		-p <nachos file> -r <nachos file> -l -D -t
 //              -n <network reliability> -m <machine id>
 //              -o <other machine id>
@@ -18,15 +21,33 @@
 //
 //    -d causes certain debugging messages to be printed (cf. utility.h)
 //    -rs causes Yield to occur at random (but repeatable) spots
+//    -mlfq schedules threads with a multilevel feedback queue; the
+//	argument is the quantum of each level, top first, e.g. 100,200,400
 //    -z prints the copyright message
 //
 //  USER_PROGRAM
 //    -s causes user programs to be executed in single-step mode
+//    -b runs user programs a basic block at a time (faster, same results)
+//    -cpus simulates several CPUs sharing the memory (default 1)
 //    -x runs a user program
+//    -j runs each -x program in a separate Nachos, this many at a time
+//	on separate host processes, and adds up their statistics (not
+//	with FILESYS, since they would all share the DISK)
 //    -c tests the console
+//    -tlb sets the size of the TLB, if there is one (default 4)
+//    -assoc sets the associativity of the TLB, at least 2 (default fully
+//	associative)
+//
+//  VM
+//    -rp chooses the page replacement policy: fifo, clock (the default)
+//	or lru
+//    -tlbr chooses the TLB replacement policy, with a TLB: random, fifo
+//	(the default) or lru
 //
 //  FILESYS
 //    -f causes the physical disk to be formatted
+//    -ds chooses the disk scheduling policy: fcfs, sstf or clook (the
+//	default)
 //    -cp copies a file from UNIX to Nachos
 //    -p prints a Nachos file to stdout
 //    -r removes a Nachos file from the file system
@@ -63,6 +84,7 @@ extern void ThreadTest(void), Copy(char *unixFile, char *nachosFile);
 extern void Print(char *file), PerformanceTest(void);
 extern void StartProcess(char *file), ConsoleTest(char *in, char *out);
 extern void MailTest(int networkID);
+extern void RunBatch(int argc, char **argv);
 
 //----------------------------------------------------------------------
 // main
@@ -104,6 +126,11 @@ main(int argc, char **argv)
     ThreadTest();
 #endif
 
+#ifdef USER_PROGRAM
+    if (hostJobs > 1)
+	RunBatch(argc, argv);		// doesn't return
+#endif
+
     for (argc--, argv++; argc > 0; argc -= argCount, argv += argCount) {
 	argCount = 1;
         if (!strcmp(*argv, "-z"))               // print copyright
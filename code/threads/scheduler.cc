@@ -11,8 +11,14 @@
 //	end up calling FindNextToRun(), and that would put us in an 
 //	infinite loop.
 //
-// 	Very simple implementation -- no priorities, straight FIFO.
-//	Might need to be improved in later assignments.
+//	There is a ready list for each priority, and a bitmap recording
+//	which of them have threads on, so finding the highest priority
+//	ready thread takes a constant number of steps, however many
+//	threads there are.  Within a priority, threads are run FIFO.
+//
+//	Optionally, threads can be scheduled with a multilevel feedback
+//	queue, which sets their priorities according to how much CPU
+//	time they use.  See StartFeedback.
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,28 +30,63 @@
 
 //----------------------------------------------------------------------
 // Scheduler::Scheduler
-// 	Initialize the list of ready but not running threads to empty.
+// 	Initialize the lists of ready but not running threads to empty.
 //----------------------------------------------------------------------
 
 Scheduler::Scheduler()
 { 
-    readyList = new List; 
+    for (int p = 0; p < NumPriorities; p++)
+	readyList[p] = new List; 
+    readyMask = 0;
+    numLevels = 0;
+    numBoosts = nextBoost = runStart = 0;
+#ifdef USER_PROGRAM
+    for (int cpu = 0; cpu < MaxCpus; cpu++)
+	cpuThread[cpu] = NULL;
+    roundStart = roundEnd = 0;
+    sliceUser = sliceSystem = 0;
+#endif
 } 
 
 //----------------------------------------------------------------------
 // Scheduler::~Scheduler
-// 	De-allocate the list of ready threads.
+// 	De-allocate the lists of ready threads.
 //----------------------------------------------------------------------
 
 Scheduler::~Scheduler()
 { 
-    delete readyList; 
+    for (int p = 0; p < NumPriorities; p++)
+	delete readyList[p]; 
 } 
 
+//----------------------------------------------------------------------
+// HighestBit
+// 	Return the number of the highest bit set in "mask", which must
+//	not be zero, by binary search.
+//----------------------------------------------------------------------
+
+static int
+HighestBit(unsigned int mask)
+{
+    int bit = 0;
+
+    if (mask & 0xffff0000) { mask >>= 16; bit += 16; }
+    if (mask & 0xff00) { mask >>= 8; bit += 8; }
+    if (mask & 0xf0) { mask >>= 4; bit += 4; }
+    if (mask & 0xc) { mask >>= 2; bit += 2; }
+    if (mask & 0x2) bit += 1;
+    return bit;
+}
+
 //----------------------------------------------------------------------
 // Scheduler::ReadyToRun
 // 	Mark a thread as ready, but not running.
-//	Put it on the ready list, for later scheduling onto the CPU.
+//	Put it on the ready list for its priority, for later scheduling 
+//	onto the CPU.
+//
+//	If an interrupt handler wakes up a thread of higher priority 
+//	than the one it interrupted, switch to it as soon as the 
+//	handler returns.
 //
 //	"thread" is the thread to be put on the ready list.
 //----------------------------------------------------------------------
@@ -55,13 +96,22 @@ Scheduler::ReadyToRun (Thread *thread)
 {
     DEBUG('t', "Putting thread %s on ready list.\n", thread->getName());
 
+    if ((numLevels > 0) && (thread->boostsSeen != numBoosts) 
+			&& (thread->getStatus() != READY))
+	ResetLevel(thread);		// missed a boost while blocked
     thread->setStatus(READY);
-    readyList->Append((void *)thread);
+    readyList[thread->getPriority()]->Append((void *)thread);
+    readyMask |= 1 << thread->getPriority();
+
+    if (interrupt->InHandler() && (interrupt->getStatus() != IdleMode)
+		&& (thread->getPriority() > currentThread->getPriority()))
+	interrupt->YieldOnReturn();
 }
 
 //----------------------------------------------------------------------
 // Scheduler::FindNextToRun
-// 	Return the next thread to be scheduled onto the CPU.
+// 	Return the next thread to be scheduled onto the CPU: the first 
+//	one on the highest priority ready list that isn't empty.
 //	If there are no ready threads, return NULL.
 // Side effect:
 //	Thread is removed from the ready list.
@@ -70,7 +120,189 @@ Scheduler::ReadyToRun (Thread *thread)
 Thread *
 Scheduler::FindNextToRun ()
 {
-    return (Thread *)readyList->Remove();
+    Thread *thread;
+    int p;
+
+    if (readyMask == 0)
+	return NULL;
+    p = HighestBit(readyMask);
+    thread = (Thread *)readyList[p]->Remove();
+    if (readyList[p]->IsEmpty())
+	readyMask &= ~(1 << p);
+    return thread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TopPriority
+// 	Return the priority of the thread FindNextToRun would return,
+//	or MinPriority - 1 if there are no ready threads.
+//----------------------------------------------------------------------
+
+int
+Scheduler::TopPriority ()
+{
+    if (readyMask == 0)
+	return MinPriority - 1;
+    return HighestBit(readyMask);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Withdraw
+// 	Take a ready thread off the ready list, so its priority can be
+//	changed.  The caller puts it back with ReadyToRun.
+//----------------------------------------------------------------------
+
+void
+Scheduler::Withdraw (Thread *thread)
+{
+    int p = thread->getPriority();
+    bool found = readyList[p]->RemoveItem((void *)thread);
+
+    ASSERT(found);
+    if (readyList[p]->IsEmpty())
+	readyMask &= ~(1 << p);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StartFeedback
+// 	Switch to multilevel feedback queue scheduling, with "levels"
+//	levels.  Threads start at the top level (0).  Once a thread has
+//	run for "quanta[level]" ticks in all at its level, it is moved
+//	down one level, until it reaches the bottom; so CPU-bound 
+//	threads sink, and threads that mostly wait for I/O stay on top.
+//	Every BoostInterval ticks, all threads are moved back to the top,
+//	so that nothing starves, and a thread that has become 
+//	interactive again doesn't stay stuck at the bottom.
+//
+//	The levels are just thread priorities, counting down from
+//	DefaultPriority, so the ready lists do the scheduling, and 
+//	priority inheritance through locks still works.  Time is
+//	measured in "busy" ticks, which leave out the time the CPU was
+//	idle, so a thread isn't charged for the time it spent blocked.
+//
+//	Threads only change level on timer interrupts, so the timer
+//	has to be running (see TimerTick).
+//----------------------------------------------------------------------
+
+void
+Scheduler::StartFeedback(int levels, int *quanta)
+{
+    ASSERT((levels > 0) && (levels <= MaxQueueLevels));
+    for (int i = 0; i < levels; i++) {
+	ASSERT(quanta[i] > 0);
+	quantum[i] = quanta[i];
+    }
+    numLevels = levels;
+    runStart = stats->systemTicks + stats->userTicks;
+    nextBoost = runStart + BoostInterval;
+    stats->numQueueLevels = levels;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::TimerTick
+// 	Called by the timer interrupt handler.  With a feedback queue,
+//	charge the current thread for its time, boost everyone if it is
+//	time to, and move the current thread down a level if it has
+//	used up its quantum.
+//
+// Returns:
+//	TRUE if the current thread should yield the CPU: with a 
+//	feedback queue, if it has used up its quantum, or if a thread
+//	at a higher level is ready.  Otherwise, always (round robin).
+//----------------------------------------------------------------------
+
+bool
+Scheduler::TimerTick()
+{
+    int level;
+
+    if (numLevels == 0)
+	return TRUE;
+    ChargeRunTime();
+    if (runStart >= nextBoost)
+	Boost();
+
+    level = currentThread->queueLevel;
+    if (currentThread->quantumUsed >= quantum[level]) {
+	if (level < numLevels - 1)
+	    level++;
+	DEBUG('t', "Thread \"%s\" used up its quantum, now at level %d\n",
+		currentThread->getName(), level);
+	SetLevel(currentThread, level);
+	return TRUE;
+    }
+    return (TopPriority() > currentThread->getPriority());
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ChargeRunTime
+// 	With a feedback queue, charge the current thread for the busy
+//	time since it was last charged, against its quantum and in the
+//	statistics for its level.
+//
+//	Busy time is the system and user time, which only the running
+//	thread adds to; unlike the clock, it never goes back when another
+//	CPU starts its slice of a round.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ChargeRunTime()
+{
+    int now = stats->systemTicks + stats->userTicks;
+
+    if ((numLevels > 0) && (now > runStart)) {
+	currentThread->quantumUsed += now - runStart;
+	stats->levelTicks[currentThread->queueLevel] += now - runStart;
+    }
+    runStart = now;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::SetLevel
+// 	Move "thread" to feedback queue level "level", with a fresh 
+//	quantum.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SetLevel(Thread *thread, int level)
+{
+    thread->queueLevel = level;
+    thread->quantumUsed = 0;
+    thread->setPriority(DefaultPriority - level);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::ResetLevel
+// 	Move "thread" back to the top level, as part of a boost.
+//----------------------------------------------------------------------
+
+void
+Scheduler::ResetLevel(Thread *thread)
+{
+    thread->boostsSeen = numBoosts;
+    SetLevel(thread, 0);
+}
+
+//----------------------------------------------------------------------
+// Scheduler::Boost
+// 	Move every thread back to the top level of the feedback queue.
+//	We do the running thread, and the ready threads below the top 
+//	level, now; the rest catch up when they next become ready or
+//	run (see ReadyToRun and Run).
+//----------------------------------------------------------------------
+
+void
+Scheduler::Boost()
+{
+    unsigned int belowTop = (1 << DefaultPriority) - 1;
+
+    DEBUG('t', "Moving all threads back to the top level\n");
+    numBoosts++;
+    nextBoost += BoostInterval;
+    ResetLevel(currentThread);
+    while ((readyMask & belowTop) != 0)
+	ResetLevel((Thread *)readyList[HighestBit(readyMask & belowTop)]
+							->SortedPeek(NULL));
 }
 
 //----------------------------------------------------------------------
@@ -92,6 +324,9 @@ Scheduler::Run (Thread *nextThread)
 {
     Thread *oldThread = currentThread;
     
+    ChargeRunTime();			// for the time oldThread has run
+    stats->numContextSwitches++;
+
 #ifdef USER_PROGRAM			// ignore until running user programs 
     if (currentThread->space != NULL) {	// if this thread is a user program,
         currentThread->SaveUserState(); // save the user's CPU registers
@@ -104,6 +339,8 @@ Scheduler::Run (Thread *nextThread)
 
     currentThread = nextThread;		    // switch to the next thread
     currentThread->setStatus(RUNNING);      // nextThread is now running
+    if ((numLevels > 0) && (nextThread->boostsSeen != numBoosts))
+	ResetLevel(nextThread);
     
     DEBUG('t', "Switching from thread \"%s\" to thread \"%s\"\n",
 	  oldThread->getName(), nextThread->getName());
@@ -143,5 +380,152 @@ void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
-    readyList->Mapcar((VoidFunctionPtr) ThreadPrint);
+    for (int p = MaxPriority; p >= MinPriority; p--)
+	if (!readyList[p]->IsEmpty()) {
+	    printf("priority %d: ", p);
+	    readyList[p]->Mapcar((VoidFunctionPtr) ThreadPrint);
+	    printf("\n");
+	}
 }
+
+#ifdef USER_PROGRAM
+//----------------------------------------------------------------------
+// Scheduler::SwitchCpu
+// 	Called from Machine::Run, when the current CPU's time slice is up.
+//	Move on to the next CPU that has something to run, and run it.
+//	(If all the other CPUs are idle, that is the current CPU again.)
+//
+//	The CPUs take turns in rounds.  Since they are really meant to 
+//	be running side by side, each CPU's slice in a round starts at
+//	the same time: the clock goes back to the start of the round for
+//	each slice, and only moves on at the end of the round.  This is
+//	deterministic, but within a round, a CPU may see the effects of
+//	things other CPUs did "later" in the same round.
+//
+//	The current thread stays put on its CPU; it runs again on that
+//	CPU's next turn.  As when the timer makes a user program yield
+//	(cf. Interrupt::OneTick), we switch threads as the kernel, with
+//	interrupts off, since that is how the next thread expects to
+//	carry on -- and then go back to running user code.
+//----------------------------------------------------------------------
+
+void
+Scheduler::SwitchCpu()
+{
+    Thread *nextThread;
+    MachineStatus oldStatus = interrupt->getStatus();
+    IntStatus oldLevel;
+
+    cpuThread[machine->currentCpu] = currentThread;
+    EndSlice();
+    nextThread = NextCpu();
+    if (nextThread != currentThread) {
+	interrupt->setStatus(SystemMode);
+	oldLevel = interrupt->SetLevel(IntOff);
+	Run(nextThread);
+	(void) interrupt->SetLevel(oldLevel);
+	interrupt->setStatus(oldStatus);
+    }
+}
+
+//----------------------------------------------------------------------
+// Scheduler::IdleCpu
+// 	Called from Thread::Sleep, when there are no ready threads for
+//	the current CPU to run.  With one CPU, that means waiting for an
+//	interrupt; with several, we can run another CPU's thread instead.
+//
+// Returns:
+//	The thread on the next CPU with something to run (which becomes
+//	the current CPU), or NULL if every CPU is idle.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::IdleCpu()
+{
+    Thread *nextThread;
+
+    if (machine->numCpus == 1)
+	return NULL;
+
+    EndSlice();
+    cpuThread[machine->currentCpu] = NULL;
+    nextThread = NextCpu();
+    if (nextThread == NULL)		// every CPU is idle; start afresh
+	StartSlice(machine->currentCpu, TRUE);	// when we get an interrupt
+    return nextThread;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::NextCpu
+// 	Find the next CPU after the current one, in turn, that has 
+//	something to run -- a thread it is already running, or else a
+//	thread from the ready list -- and start its time slice.
+//
+// Returns:
+//	The thread to run on that CPU, or NULL if there is none.
+//----------------------------------------------------------------------
+
+Thread *
+Scheduler::NextCpu()
+{
+    int cpu = machine->currentCpu;
+    int next;
+
+    for (int i = 1; i <= machine->numCpus; i++) {
+	next = (cpu + i) % machine->numCpus;
+	if (cpuThread[next] == NULL)		// idle; any work for it?
+	    cpuThread[next] = FindNextToRun();
+	if (cpuThread[next] != NULL) {
+	    DEBUG('t', "CPU %d takes its turn\n", next);
+	    StartSlice(next, (cpu + i) >= machine->numCpus);
+	    return cpuThread[next];
+	}
+    }
+    return NULL;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::StartSlice
+// 	Start a CPU's time slice, at the start of the current round.
+//
+//	"cpu" -- the CPU to run
+//	"newRound" -- if TRUE, every CPU has had its turn in the current
+//		round, so start a new one
+//----------------------------------------------------------------------
+
+void
+Scheduler::StartSlice(int cpu, bool newRound)
+{
+    if (newRound)
+	roundStart = roundEnd;
+    stats->totalTicks = roundStart;
+    machine->SetCpu(cpu);
+    machine->sliceEnd = roundStart + CpuSlice;
+}
+
+//----------------------------------------------------------------------
+// Scheduler::EndSlice
+// 	Charge the current CPU for the user and system time it has used
+//	since its slice started (or since we last did this).
+//
+//	The clock is moved on to the latest time any CPU has reached in
+//	this round, as the machine as a whole has got that far; if a new
+//	slice starts, it winds the clock back again.  Waits are timed
+//	from the latest time (see Statistics::Now), so that they never
+//	come out negative.
+//----------------------------------------------------------------------
+
+void
+Scheduler::EndSlice()
+{
+    int cpu = machine->currentCpu;
+
+    stats->cpuUserTicks[cpu] += stats->userTicks - sliceUser;
+    stats->cpuSystemTicks[cpu] += stats->systemTicks - sliceSystem;
+    sliceUser = stats->userTicks;
+    sliceSystem = stats->systemTicks;
+    if (stats->totalTicks > roundEnd)
+	roundEnd = stats->totalTicks;
+    stats->totalTicks = stats->latestTicks = roundEnd;
+}
+#endif
@@ -12,6 +12,11 @@
 #include "copyright.h"
 #include "list.h"
 #include "thread.h"
+#include "stats.h"
+
+// With multilevel feedback queue scheduling, every thread is moved 
+// back to the top level this often.
+#define BoostInterval	(20 * TimerTicks)
 
 // The following class defines the scheduler/dispatcher abstraction -- 
 // the data structures and operations needed to keep track of which 
@@ -25,12 +30,60 @@ class Scheduler {
     void ReadyToRun(Thread* thread);	// Thread can be dispatched.
     Thread* FindNextToRun();		// Dequeue first thread on the ready 
 					// list, if any, and return thread.
+    int TopPriority();			// Highest priority of any ready
+					// thread
+    void Withdraw(Thread* thread);	// Take a thread off the ready list
+
+    void StartFeedback(int levels, int *quanta);
+					// Schedule with a multilevel
+					// feedback queue
+    bool TimerTick();			// Called on each timer interrupt;
+					// should the current thread yield?
+    void ChargeRunTime();		// Charge the current thread for
+					// the time it has run
     void Run(Thread* nextThread);	// Cause nextThread to start running
     void Print();			// Print contents of ready list
+
+#ifdef USER_PROGRAM
+    void SwitchCpu();			// The current CPU's time slice is 
+					// up; run the next CPU
+    Thread* IdleCpu();			// The current CPU has nothing to run;
+					// return the next CPU's thread
+    void EndSlice();			// Charge the current CPU for the
+					// time it has used
+#endif
     
   private:
-    List *readyList;  		// queue of threads that are ready to run,
+    List *readyList[NumPriorities];  	// queues of threads of each 
+				// priority that are ready to run,
 				// but not running
+    unsigned int readyMask;	// bit p is set if readyList[p] is
+				// not empty
+
+    int numLevels;		// levels of feedback queue, 0 if off
+    int quantum[MaxQueueLevels];	// time a thread may run at each
+				// level, before it is moved down
+    int numBoosts;		// # of times all threads have been 
+				// moved back to the top level
+    int nextBoost;		// when to do that next
+    int runStart;		// busy time when the current thread 
+				// last started running, or was charged
+
+    void SetLevel(Thread *thread, int level);
+    void ResetLevel(Thread *thread);	// back to the top, after a boost
+    void Boost();		// move every thread back to the top
+
+#ifdef USER_PROGRAM
+    Thread *cpuThread[MaxCpus];	// the thread running on each CPU, 
+				// NULL if the CPU is idle
+    int roundStart;		// when the current round of slices began
+    int roundEnd;		// the latest time any CPU got to in it
+    int sliceUser, sliceSystem;	// user and system time at the start
+				// of the current slice
+
+    Thread* NextCpu();		// find the next CPU with work to do
+    void StartSlice(int cpu, bool newRound);
+#endif
 };
 
 #endif // SCHEDULER_H
@@ -1,8 +1,7 @@
 // synch.cc 
 //	Routines for synchronizing threads.  Three kinds of
 //	synchronization routines are defined here: semaphores, locks 
-//   	and condition variables (the implementation of the last two
-//	are left to the reader).
+//   	and condition variables.
 //
 // Any implementation of a synchronization routine needs some
 // primitive atomic operation.  We assume Nachos is running on
@@ -67,7 +66,8 @@ Semaphore::P()
     IntStatus oldLevel = interrupt->SetLevel(IntOff);	// disable interrupts
     
     while (value == 0) { 			// semaphore not available
-	queue->Append((void *)currentThread);	// so go to sleep
+	queue->SortedInsert((void *)currentThread, 	// so go to sleep
+				-currentThread->getPriority());
 	currentThread->Sleep();
     } 
     value--; 					// semaphore available, 
@@ -97,16 +97,283 @@ Semaphore::V()
     (void) interrupt->SetLevel(oldLevel);
 }
 
-// Dummy functions -- so we can compile our later assignments 
-// Note -- without a correct implementation of Condition::Wait(), 
-// the test case in the network assignment won't work!
-Lock::Lock(char* debugName) {}
-Lock::~Lock() {}
-void Lock::Acquire() {}
-void Lock::Release() {}
+//----------------------------------------------------------------------
+// Lock::Lock
+// 	Initialize a lock, so that it can be used for synchronization.
+//	The lock starts out FREE.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+Lock::Lock(char* debugName)
+{
+    name = debugName;
+    owner = NULL;
+    nextHeld = NULL;
+    queue = new List;
+    numWaiting = numAcquires = numWaits = waitTicks = maxWaiting = 0;
+}
+
+//----------------------------------------------------------------------
+// Lock::~Lock
+// 	De-allocate a lock, when no longer needed.  Assume no one
+//	holds it, or is waiting for it!
+//----------------------------------------------------------------------
+
+Lock::~Lock()
+{
+    ASSERT(owner == NULL);
+    DEBUG('s', "Lock \"%s\": acquired %d times, %d waits, "
+		"%d ticks waiting, at most %d waiting\n", name,
+		numAcquires, numWaits, waitTicks, maxWaiting);
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// Lock::Acquire
+// 	Wait until the lock is FREE, then take it.  As for semaphores,
+//	we disable interrupts to make this atomic.
+//
+//	Release hands the lock straight to the first thread waiting
+//	for it, so when we wake up, we already have it; that way a
+//	thread can't slip in and take the lock ahead of the waiters.
+//
+//	While we wait, the owner runs with our priority, if it is 
+//	higher than its own.
+//----------------------------------------------------------------------
+
+void
+Lock::Acquire()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int startTime;
+
+    ASSERT(!isHeldByCurrentThread());		// locks can't be nested
+    if (owner != NULL) {			// BUSY, so wait our turn
+	startTime = stats->Now();
+	currentThread->waitingFor = this;
+	queue->SortedInsert((void *)currentThread, 
+				-currentThread->getPriority());
+	numWaits++;
+	stats->numLockWaits++;
+	if (++numWaiting > maxWaiting)
+	    maxWaiting = numWaiting;
+	if (numWaiting > stats->maxLockWaiters)
+	    stats->maxLockWaiters = numWaiting;
+	owner->UpdatePriority();		// lend it our priority
+	currentThread->Sleep();
+	ASSERT(owner == currentThread);
+	waitTicks += stats->Now() - startTime;
+	stats->lockWaitTicks += stats->Now() - startTime;
+    } else
+	TakeOwnership(currentThread);
+    numAcquires++;
+    stats->numLockAcquires++;
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::Release
+// 	Set the lock FREE, or if anyone is waiting for it, give it to
+//	the first of them and wake them up.  Only the thread holding 
+//	the lock may release it.
+//----------------------------------------------------------------------
+
+void
+Lock::Release()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    Lock **ptr;
+    Thread *thread;
+
+    ASSERT(isHeldByCurrentThread());
+    for (ptr = &currentThread->locksHeld; *ptr != this; 
+						ptr = &(*ptr)->nextHeld)
+	;
+    *ptr = nextHeld;				// we no longer hold it
+    owner = NULL;
+
+    thread = (Thread *)queue->Remove();
+    if (thread != NULL) {
+	numWaiting--;
+	thread->waitingFor = NULL;
+	TakeOwnership(thread);
+	scheduler->ReadyToRun(thread);
+    }
+    currentThread->UpdatePriority();		// give back what we were
+						// lent through this lock
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Lock::TakeOwnership
+// 	Make "thread" the owner of the lock, and add the lock to the
+//	ones it holds.  If others are waiting for the lock, the thread
+//	inherits their priority.
+//----------------------------------------------------------------------
+
+void
+Lock::TakeOwnership(Thread *thread)
+{
+    owner = thread;
+    nextHeld = thread->locksHeld;
+    thread->locksHeld = this;
+    if (!queue->IsEmpty())
+	thread->UpdatePriority();
+}
+
+//----------------------------------------------------------------------
+// Lock::getWaiterPriority
+// 	Return the priority of the highest priority thread waiting for
+//	the lock, or MinPriority - 1 if there are none.
+//----------------------------------------------------------------------
+
+int
+Lock::getWaiterPriority()
+{
+    Thread *thread = (Thread *)queue->SortedPeek(NULL);
+
+    if (thread == NULL)
+	return MinPriority - 1;
+    return thread->getPriority();
+}
+
+//----------------------------------------------------------------------
+// Lock::Requeue
+// 	The priority of "thread", which is waiting for the lock, has
+//	changed: move it to its new place in the queue, and pass the
+//	change on to the owner.
+//----------------------------------------------------------------------
+
+void
+Lock::Requeue(Thread *thread)
+{
+    bool found = queue->RemoveItem((void *)thread);
 
-Condition::Condition(char* debugName) { }
-Condition::~Condition() { }
-void Condition::Wait(Lock* conditionLock) { ASSERT(FALSE); }
-void Condition::Signal(Lock* conditionLock) { }
-void Condition::Broadcast(Lock* conditionLock) { }
+    ASSERT(found);
+    queue->SortedInsert((void *)thread, -thread->getPriority());
+    owner->UpdatePriority();
+}
+
+//----------------------------------------------------------------------
+// Lock::isHeldByCurrentThread
+// 	Return TRUE if the current thread holds the lock.
+//----------------------------------------------------------------------
+
+bool
+Lock::isHeldByCurrentThread()
+{
+    return owner == currentThread;
+}
+
+//----------------------------------------------------------------------
+// Condition::Condition
+// 	Initialize a condition variable, with no one waiting on it.
+//
+//	"debugName" is an arbitrary name, useful for debugging.
+//----------------------------------------------------------------------
+
+Condition::Condition(char* debugName)
+{
+    name = debugName;
+    lock = NULL;
+    queue = new List;
+    numWaiting = numWaits = waitTicks = maxWaiting = 0;
+}
+
+//----------------------------------------------------------------------
+// Condition::~Condition
+// 	De-allocate a condition variable.  Assume no one is still 
+//	waiting on it!
+//----------------------------------------------------------------------
+
+Condition::~Condition()
+{
+    ASSERT(queue->IsEmpty());
+    DEBUG('s', "Condition \"%s\": %d waits, %d ticks waiting, "
+		"at most %d waiting\n", name, numWaits, waitTicks,
+		maxWaiting);
+    delete queue;
+}
+
+//----------------------------------------------------------------------
+// Condition::Wait
+// 	Release "conditionLock", wait until someone signals the 
+//	condition, then re-acquire the lock.
+//
+//	Interrupts are off from before we release the lock until we are
+//	asleep, so a Signal can't slip in between and be lost.
+//----------------------------------------------------------------------
+
+void
+Condition::Wait(Lock* conditionLock)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int startTime = stats->Now();
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    ASSERT((lock == NULL) || (lock == conditionLock));
+    lock = conditionLock;			// always the same lock
+
+    queue->SortedInsert((void *)currentThread, -currentThread->getPriority());
+    numWaits++;
+    stats->numConditionWaits++;
+    if (++numWaiting > maxWaiting)
+	maxWaiting = numWaiting;
+    if (numWaiting > stats->maxConditionWaiters)
+	stats->maxConditionWaiters = numWaiting;
+    conditionLock->Release();
+    currentThread->Sleep();			// until Signal or Broadcast
+    waitTicks += stats->Now() - startTime;
+    stats->conditionWaitTicks += stats->Now() - startTime;
+
+    conditionLock->Acquire();
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Condition::Signal
+// 	Wake up the first thread waiting on the condition, if any.
+//	It is only put on the ready list; it re-acquires the lock itself
+//	(Mesa semantics), so by the time it does, the condition may no
+//	longer hold.
+//----------------------------------------------------------------------
+
+void
+Condition::Signal(Lock* conditionLock)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    ASSERT((lock == NULL) || (lock == conditionLock));
+
+    thread = (Thread *)queue->Remove();
+    if (thread != NULL) {
+	numWaiting--;
+	scheduler->ReadyToRun(thread);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
+//----------------------------------------------------------------------
+// Condition::Broadcast
+// 	Wake up every thread waiting on the condition.
+//----------------------------------------------------------------------
+
+void
+Condition::Broadcast(Lock* conditionLock)
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    Thread *thread;
+
+    ASSERT(conditionLock->isHeldByCurrentThread());
+    ASSERT((lock == NULL) || (lock == conditionLock));
+
+    while ((thread = (Thread *)queue->Remove()) != NULL) {
+	numWaiting--;
+	scheduler->ReadyToRun(thread);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
@@ -2,10 +2,17 @@
 //	Data structures for synchronizing threads.
 //
 //	Three kinds of synchronization are defined here: semaphores,
-//	locks, and condition variables.  The implementation for
-//	semaphores is given; for the latter two, only the procedure
-//	interface is given -- they are to be implemented as part of 
-//	the first assignment.
+//	locks, and condition variables.
+//
+//	Threads waiting on any of them are woken highest priority first
+//	(and first come, first served within a priority).  A thread 
+//	waiting for a lock lends its priority to the thread holding it,
+//	so a low priority thread can't hold up a high priority one 
+//	indefinitely by holding a lock it needs.
+//
+//	Locks and condition variables keep count of how much they are
+//	waited for, so we can see where threads are held up; the totals
+//	for all of them are printed with the other statistics.
 //
 //	Note that all the synchronization objects take a "name" as
 //	part of the initialization.  This is solely for debugging purposes.
@@ -77,9 +84,31 @@ class Lock {
 					// checking in Release, and in
 					// Condition variable ops below.
 
+    Thread *getOwner() { return owner; }	// contention statistics
+    int getNumWaiting() { return numWaiting; }
+    int getWaitTicks() { return waitTicks; }
+    int getMaxWaiting() { return maxWaiting; }
+
+    // for priority inheritance
+    int getWaiterPriority();		// highest priority of a thread
+					// waiting for the lock
+    Lock *getNextHeld() { return nextHeld; }
+    void Requeue(Thread *thread);	// a waiting thread's priority 
+					// has changed
+
   private:
     char* name;				// for debugging
-    // plus some other stuff you'll need to define
+    Thread *owner;			// thread holding the lock, 
+					// or NULL if the lock is FREE
+    Lock *nextHeld;			// next lock held by the same owner
+    void TakeOwnership(Thread *thread);
+    List *queue;			// threads waiting in Acquire,
+					// highest priority first
+    int numWaiting;			// # of threads on the queue
+    int numAcquires;			// # of times the lock was acquired
+    int numWaits;			// # of those that had to wait
+    int waitTicks;			// total time spent waiting
+    int maxWaiting;			// most threads ever on the queue
 };
 
 // The following class defines a "condition variable".  A condition
@@ -129,8 +158,20 @@ class Condition {
     void Broadcast(Lock *conditionLock);// the currentThread for all of 
 					// these operations
 
+    Lock *getOwner() { return lock; }	// contention statistics
+    int getNumWaiting() { return numWaiting; }
+    int getWaitTicks() { return waitTicks; }
+    int getMaxWaiting() { return maxWaiting; }
+
   private:
     char* name;
-    // plus some other stuff you'll need to define
+    Lock *lock;				// the lock protecting the condition,
+					// once it has been used
+    List *queue;			// threads waiting to be signalled
+    int numWaiting;			// # of threads on the queue
+    int numWaits;			// # of calls to Wait
+    int waitTicks;			// total time spent waiting to be 
+					// signalled
+    int maxWaiting;			// most threads ever on the queue
 };
 #endif // SYNCH_H
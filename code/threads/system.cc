@@ -25,10 +25,28 @@ FileSystem  *fileSystem;
 
 #ifdef FILESYS
 SynchDisk   *synchDisk;
+BufferCache *bufferCache;
+#endif
+
+#ifdef VM
+CoreMap *coreMap;	// what is in each physical page frame
+SwapSpace *swapSpace;	// backing store for modified pages
+#endif
+
+#ifdef USE_TLB
+TlbManager *tlbManager;	// refills the TLB on a miss
 #endif
 
 #ifdef USER_PROGRAM	// requires either FILESYS or FILESYS_STUB
 Machine *machine;	// user program memory and registers
+BitMap *frameMap;	// which physical page frames are in use
+ProcessTable *processTable;	// the user programs that are running
+TextCache *textCache;		// code pages shared between programs
+SynchConsole *synchConsole;	// the console user programs read and write
+				// (never deleted: a program may still be
+				// waiting for a character when we halt)
+int hostJobs;		// # of host processes for a batch of programs
+int batchResults;	// file for our statistics, in a batch
 #endif
 
 #ifdef NETWORK
@@ -47,6 +65,10 @@ extern void Cleanup();
 //	This routine is called each time there is a timer interrupt,
 //	with interrupts disabled.
 //
+//	Normally, we just time-slice round robin; with a multilevel
+//	feedback queue, the scheduler decides whether it is time to
+//	switch.
+//
 //	Note that instead of calling Yield() directly (which would
 //	suspend the interrupt handler, not the interrupted thread
 //	which is what we wanted to context switch), we set a flag
@@ -60,7 +82,7 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(int dummy)
 {
-    if (interrupt->getStatus() != IdleMode)
+    if (scheduler->TimerTick() && (interrupt->getStatus() != IdleMode))
 	interrupt->YieldOnReturn();
 }
 
@@ -80,13 +102,33 @@ Initialize(int argc, char **argv)
     int argCount;
     char* debugArgs = "";
     bool randomYield = FALSE;
+    int numLevels = 0;		// levels of feedback queue, if any
+    int quanta[MaxQueueLevels];	// and the quantum at each level
+    char *q;
 
 #ifdef USER_PROGRAM
     bool debugUserProg = FALSE;	// single step user program
+    bool runBlocks = FALSE;	// run user code a basic block at a time
+    int numCpus = 1;		// # of simulated CPUs
+    int tlbEntries = TLBSize;	// size of each CPU's TLB
+    int tlbWays = 0;		// its associativity; 0 means fully
+				// associative
+
+    hostJobs = 1;
+    batchResults = -1;
 #endif
 #ifdef FILESYS_NEEDED
     bool format = FALSE;	// format disk
 #endif
+#ifdef FILESYS
+    DiskScheduling scheduling = CLookScheduling;
+#endif
+#ifdef VM
+    ReplacementPolicy policy = ClockReplacement;
+#endif
+#ifdef USE_TLB
+    TlbPolicy tlbPolicy = FifoTlb;
+#endif
 #ifdef NETWORK
     double rely = 1;		// network reliability
     int netname = 0;		// UNIX socket name
@@ -107,15 +149,91 @@ Initialize(int argc, char **argv)
 						// number generator
 	    randomYield = TRUE;
 	    argCount = 2;
+	} else if (!strcmp(*argv, "-mlfq")) {
+	    ASSERT(argc > 1);
+	    for (q = *(argv + 1); q != NULL; q = strchr(q, ',')) {
+		if (*q == ',')
+		    q++;
+		ASSERT(numLevels < MaxQueueLevels);
+		quanta[numLevels++] = atoi(q);
+	    }
+	    argCount = 2;
 	}
 #ifdef USER_PROGRAM
 	if (!strcmp(*argv, "-s"))
 	    debugUserProg = TRUE;
+	if (!strcmp(*argv, "-b"))
+	    runBlocks = TRUE;
+	else if (!strcmp(*argv, "-cpus")) {
+	    ASSERT(argc > 1);
+	    numCpus = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-j")) {
+	    ASSERT(argc > 1);
+	    hostJobs = atoi(*(argv + 1));
+	    argCount = 2;
+#ifdef FILESYS
+	    if (hostJobs > 1) {		// the copies would all use one DISK
+		printf("-j: can't run a batch with a real file system\n");
+		Exit(1);
+	    }
+#endif
+	} else if (!strcmp(*argv, "-tlb")) {
+	    ASSERT(argc > 1);
+	    tlbEntries = atoi(*(argv + 1));
+	    argCount = 2;
+	} else if (!strcmp(*argv, "-assoc")) {
+	    ASSERT(argc > 1);
+	    tlbWays = atoi(*(argv + 1));
+	    argCount = 2;
+	}
+#endif
+#ifdef USE_TLB
+	if (!strcmp(*argv, "-tlbr")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "random"))
+		tlbPolicy = RandomTlb;
+	    else if (!strcmp(*(argv + 1), "lru"))
+		tlbPolicy = LruTlb;
+	    else {
+		ASSERT(!strcmp(*(argv + 1), "fifo"));
+		tlbPolicy = FifoTlb;
+	    }
+	    argCount = 2;
+	}
+#endif
+#ifdef VM
+	if (!strcmp(*argv, "-rp")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fifo"))
+		policy = FifoReplacement;
+	    else if (!strcmp(*(argv + 1), "lru"))
+		policy = LruReplacement;
+	    else {
+		ASSERT(!strcmp(*(argv + 1), "clock"));
+		policy = ClockReplacement;
+	    }
+	    argCount = 2;
+	}
 #endif
 #ifdef FILESYS_NEEDED
 	if (!strcmp(*argv, "-f"))
 	    format = TRUE;
 #endif
+#ifdef FILESYS
+	if (!strcmp(*argv, "-ds")) {
+	    ASSERT(argc > 1);
+	    if (!strcmp(*(argv + 1), "fcfs"))
+		scheduling = FcfsScheduling;
+	    else if (!strcmp(*(argv + 1), "sstf"))
+		scheduling = SstfScheduling;
+	    else {
+		ASSERT(!strcmp(*(argv + 1), "clook"));
+		scheduling = CLookScheduling;
+	    }
+	    argCount = 2;
+	}
+#endif
 #ifdef NETWORK
 	if (!strcmp(*argv, "-l")) {
 	    ASSERT(argc > 1);
@@ -133,7 +251,9 @@ Initialize(int argc, char **argv)
     stats = new Statistics();			// collect statistics
     interrupt = new Interrupt;			// start up interrupt handling
     scheduler = new Scheduler();		// initialize the ready queue
-    if (randomYield)				// start the timer (if needed)
+    if (numLevels > 0)
+	scheduler->StartFeedback(numLevels, quanta);
+    if (randomYield || (numLevels > 0))	// start the timer (if needed)
 	timer = new Timer(TimerInterruptHandler, 0, randomYield);
 
     threadToBeDestroyed = NULL;
@@ -148,17 +268,35 @@ Initialize(int argc, char **argv)
     CallOnUserAbort(Cleanup);			// if user hits ctl-C
     
 #ifdef USER_PROGRAM
-    machine = new Machine(debugUserProg);	// this must come first
+    if (tlbWays == 0)
+	tlbWays = tlbEntries;
+    machine = new Machine(debugUserProg, runBlocks, numCpus, tlbEntries,
+			tlbWays);		// this must come first
+    stats->numCpus = numCpus;
+    frameMap = new BitMap(NumPhysPages);
+    processTable = new ProcessTable();
+    textCache = new TextCache();
+    synchConsole = NULL;		// made when a program first uses it
+#endif
+
+#ifdef USE_TLB
+    tlbManager = new TlbManager(tlbPolicy);
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    synchDisk = new SynchDisk("DISK", scheduling);
+    bufferCache = new BufferCache;
 #endif
 
 #ifdef FILESYS_NEEDED
     fileSystem = new FileSystem(format);
 #endif
 
+#ifdef VM
+    coreMap = new CoreMap(policy);
+    swapSpace = new SwapSpace();
+#endif
+
 #ifdef NETWORK
     postOffice = new PostOffice(netname, rely, 10);
 #endif
@@ -172,16 +310,40 @@ void
 Cleanup()
 {
     printf("\nCleaning up...\n");
+    threadToBeDestroyed = NULL;	// if we halted because the last thread
+				// finished, we are still on its stack --
+				// and we may wait for the disk, below
 #ifdef NETWORK
     delete postOffice;
 #endif
     
 #ifdef USER_PROGRAM
-    delete machine;
+    if (batchResults >= 0)	// leave our statistics for RunBatch
+	WriteFile(batchResults, (char *) stats, sizeof(Statistics));
 #endif
 
+#ifdef VM
+    delete swapSpace;		// first: removing the swap file may mean
+    delete coreMap;		// waiting for the disk, and so idling the
+#endif				// machine
+
 #ifdef FILESYS_NEEDED
-    delete fileSystem;
+    delete fileSystem;		// writing back the files still open
+#endif				// waits for the disk, too
+
+#ifdef FILESYS
+    delete bufferCache;		// and so does writing back the cache
+#endif
+
+#ifdef USER_PROGRAM
+    delete textCache;
+    delete processTable;
+    delete frameMap;
+    delete machine;
+#endif
+
+#ifdef USE_TLB
+    delete tlbManager;
 #endif
 
 #ifdef FILESYS
@@ -31,7 +31,20 @@ extern Timer *timer;				// the hardware alarm clock
 
 #ifdef USER_PROGRAM
 #include "machine.h"
+#include "bitmap.h"
+#include "process.h"
+#include "textcache.h"
+#include "synchconsole.h"
 extern Machine* machine;	// user program memory and registers
+extern BitMap *frameMap;	// which physical page frames are in use
+extern ProcessTable *processTable;	// the user programs that are running
+extern TextCache *textCache;	// code pages shared between programs
+extern SynchConsole *synchConsole;	// the console, once a user program
+				// has used it; else NULL
+extern int hostJobs;		// # of host processes to run a batch of
+				// user programs on (-j)
+extern int batchResults;	// where to leave our statistics, if we
+				// are one program of a batch, else -1
 #endif
 
 #ifdef FILESYS_NEEDED 		// FILESYS or FILESYS_STUB 
@@ -39,9 +52,24 @@ extern Machine* machine;	// user program memory and registers
 extern FileSystem  *fileSystem;
 #endif
 
+#ifdef VM
+#include "coremap.h"
+#include "swap.h"
+extern CoreMap *coreMap;	// what is in each physical page frame
+extern SwapSpace *swapSpace;	// where modified pages go when they
+				// are paged out
+#endif
+
+#ifdef USE_TLB
+#include "tlbmanager.h"
+extern TlbManager *tlbManager;	// refills the TLB on a miss
+#endif
+
 #ifdef FILESYS
 #include "synchdisk.h"
+#include "buffercache.h"
 extern SynchDisk   *synchDisk;
+extern BufferCache *bufferCache;	// recently used disk sectors
 #endif
 
 #ifdef NETWORK
@@ -38,6 +38,10 @@ Thread::Thread(char* threadName)
     stackTop = NULL;
     stack = NULL;
     status = JUST_CREATED;
+    priority = effectivePriority = DefaultPriority;
+    waitingFor = NULL;
+    locksHeld = NULL;
+    queueLevel = quantumUsed = boostsSeen = 0;
 #ifdef USER_PROGRAM
     space = NULL;
 #endif
@@ -155,12 +159,12 @@ Thread::Finish ()
 
 //----------------------------------------------------------------------
 // Thread::Yield
-// 	Relinquish the CPU if any other thread is ready to run.
-//	If so, put the thread on the end of the ready list, so that
-//	it will eventually be re-scheduled.
+// 	Relinquish the CPU if any other thread of at least our priority
+//	is ready to run.  If so, put the thread on the end of the ready 
+//	list for its priority, so that it will eventually be re-scheduled.
 //
-//	NOTE: returns immediately if no other thread on the ready queue.
-//	Otherwise returns when the thread eventually works its way
+//	NOTE: returns immediately if there is no such thread on the ready
+//	queue.  Otherwise returns when the thread eventually works its way
 //	to the front of the ready list and gets re-scheduled.
 //
 //	NOTE: we disable interrupts, so that looking at the thread
@@ -181,14 +185,67 @@ Thread::Yield ()
     
     DEBUG('t', "Yielding thread \"%s\"\n", getName());
     
-    nextThread = scheduler->FindNextToRun();
-    if (nextThread != NULL) {
+    if (scheduler->TopPriority() >= effectivePriority) {
+	nextThread = scheduler->FindNextToRun();
 	scheduler->ReadyToRun(this);
 	scheduler->Run(nextThread);
     }
     (void) interrupt->SetLevel(oldLevel);
 }
 
+//----------------------------------------------------------------------
+// Thread::setPriority
+// 	Change the thread's own priority.  It may still run at a higher
+//	one, inherited from a thread waiting for a lock it holds.
+//
+//	Note that this does not preempt the current thread, even if a
+//	ready thread now has a higher priority; that happens the next 
+//	time it yields.
+//----------------------------------------------------------------------
+
+void
+Thread::setPriority(int newPriority)
+{
+    ASSERT((newPriority >= MinPriority) && (newPriority <= MaxPriority));
+    priority = newPriority;
+    UpdatePriority();
+}
+
+//----------------------------------------------------------------------
+// Thread::UpdatePriority
+// 	Work out the priority the thread should run at -- the highest
+//	of its own and those of the threads waiting for locks it holds
+//	-- and if that has changed, move the thread to its new place in 
+//	the ready list (if it is on it).  If the thread is waiting for
+//	a lock itself, pass the change on to the owner of that lock.
+//----------------------------------------------------------------------
+
+void
+Thread::UpdatePriority()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+    int newPriority = priority;
+    Lock *lock;
+
+    for (lock = locksHeld; lock != NULL; lock = lock->getNextHeld())
+	if (lock->getWaiterPriority() > newPriority)
+	    newPriority = lock->getWaiterPriority();
+
+    if (newPriority != effectivePriority) {
+	DEBUG('t', "Thread \"%s\" now has priority %d\n", name, 
+							newPriority);
+	if (status == READY) {
+	    scheduler->Withdraw(this);
+	    effectivePriority = newPriority;
+	    scheduler->ReadyToRun(this);
+	} else
+	    effectivePriority = newPriority;
+	if (waitingFor != NULL)
+	    waitingFor->Requeue(this);
+    }
+    (void) interrupt->SetLevel(oldLevel);
+}
+
 //----------------------------------------------------------------------
 // Thread::Sleep
 // 	Relinquish the CPU, because the current thread is blocked
@@ -197,7 +254,8 @@ Thread::Yield ()
 //	back on the ready queue, so that it can be re-scheduled.
 //
 //	NOTE: if there are no threads on the ready queue, that means
-//	we have no thread to run.  "Interrupt::Idle" is called
+//	we have no thread to run.  If there are other CPUs, we go and
+//	run one of them instead; otherwise "Interrupt::Idle" is called
 //	to signify that we should idle the CPU until the next I/O interrupt
 //	occurs (the only thing that could cause a thread to become
 //	ready to run).
@@ -219,8 +277,13 @@ Thread::Sleep ()
     DEBUG('t', "Sleeping thread \"%s\"\n", getName());
 
     status = BLOCKED;
-    while ((nextThread = scheduler->FindNextToRun()) == NULL)
+    while ((nextThread = scheduler->FindNextToRun()) == NULL) {
+#ifdef USER_PROGRAM
+	if ((nextThread = scheduler->IdleCpu()) != NULL)
+	    break;		// another CPU has something to run
+#endif
 	interrupt->Idle();	// no one to run, wait for an interrupt
+    }
         
     scheduler->Run(nextThread); // returns when we've been signalled
 }
@@ -59,6 +59,15 @@
 // Thread state
 enum ThreadStatus { JUST_CREATED, RUNNING, READY, BLOCKED };
 
+// Thread priorities.  The scheduler always runs a thread of the 
+// highest priority that is ready; threads of equal priority take turns.
+#define NumPriorities	32
+#define MinPriority	0
+#define MaxPriority	(NumPriorities - 1)
+#define DefaultPriority	(NumPriorities / 2)
+
+class Lock;
+
 // external function, dummy routine whose sole job is to call Thread::Print
 extern void ThreadPrint(int arg);	 
 
@@ -99,9 +108,28 @@ class Thread {
     void CheckOverflow();   			// Check if thread has 
 						// overflowed its stack
     void setStatus(ThreadStatus st) { status = st; }
+    ThreadStatus getStatus() { return status; }
     char* getName() { return (name); }
     void Print() { printf("%s, ", name); }
 
+    int getPriority() { return effectivePriority; }
+    int getBasePriority() { return priority; }
+    void setPriority(int newPriority);		// Change base priority
+    void UpdatePriority();			// Recompute the priority 
+						// we have inherited
+
+    // Priority inheritance: a thread waiting for a lock lends its
+    // priority to the lock's owner, and to whoever the owner is 
+    // waiting for, and so on.  These are maintained by Lock.
+    Lock *waitingFor;			// lock we are waiting to acquire
+    Lock *locksHeld;			// locks we hold, linked through 
+					// Lock::getNextHeld
+
+    // Multilevel feedback queue state, maintained by the Scheduler
+    int queueLevel;			// 0 is the top level
+    int quantumUsed;			// time we have run at this level
+    int boostsSeen;			// last priority boost applied to us
+
   private:
     // some of the private data for this class is listed above
     
@@ -110,6 +138,10 @@ class Thread {
 					// (If NULL, don't deallocate stack)
     ThreadStatus status;		// ready, running or blocked
     char* name;
+    int priority;			// our own priority
+    int effectivePriority;		// priority we run at: our own, or
+					// that of a thread waiting for a
+					// lock we hold, if that is higher
 
     void StackAllocate(VoidFunctionPtr func, int arg);
     					// Allocate a stack for thread.
@@ -52,6 +52,291 @@ ThreadTest1()
     SimpleThread(0);
 }
 
+//----------------------------------------------------------------------
+// QueueTest
+// 	Benchmark the queue of pending interrupts, by keeping it 
+//	busy the way the devices do: every interrupt that fires 
+//	schedules another, a pseudo-random time into the future, until
+//	"queueTestEvents" interrupts have been scheduled in all.
+//
+//	Time with "time nachos -q 2".
+//----------------------------------------------------------------------
+
+static const int queueTestEvents = 4000000;	// interrupts in all
+static const int queueTestDepth = 1000;		// interrupts pending at once
+static int queueTestScheduled, queueTestFired;
+
+static void
+QueueTestHandler(int dummy)
+{
+    queueTestFired++;
+    if (queueTestScheduled < queueTestEvents) {
+	interrupt->Schedule(QueueTestHandler, 0, 1 + Random() % 1000, DiskInt);
+	queueTestScheduled++;
+    }
+}
+
+void
+QueueTest()
+{
+    IntStatus oldLevel = interrupt->SetLevel(IntOff);
+
+    for (queueTestScheduled = 0; queueTestScheduled < queueTestDepth; 
+						queueTestScheduled++)
+	interrupt->Schedule(QueueTestHandler, 0, 1 + Random() % 1000, DiskInt);
+    while (queueTestFired < queueTestEvents)
+	interrupt->Idle();		// fire the next interrupt(s)
+    (void) interrupt->SetLevel(oldLevel);
+
+    printf("Pending interrupt queue: %d interrupts scheduled and fired, "
+		"by time %d\n", queueTestFired, stats->totalTicks);
+}
+
+//----------------------------------------------------------------------
+// LockTest
+// 	Exercise locks and condition variables with a bounded buffer:
+//	several producers and consumers pass "lockTestItems" items
+//	through a buffer of "lockTestSlots" slots, yielding inside the
+//	critical section now and then so that the lock is contended.
+//	At the end, check that every item got through exactly once, and
+//	that no waiting took negative time -- which the clock, going back
+//	for each CPU's turn, could make it seem to (cf. Scheduler::EndSlice).
+//
+//	The waiting shows up in the statistics printed when Nachos 
+//	halts; run with "nachos -q 3" (add "-rs" for some randomness, or
+//	"-cpus 3" for several CPUs).
+//----------------------------------------------------------------------
+
+#include "synch.h"
+
+static const int lockTestItems = 1000;	// items per producer
+static const int lockTestSlots = 4;	// size of the buffer
+static const int lockTestThreads = 3;	// producers, and consumers
+static int lockTestBuffer[lockTestSlots];
+static int lockTestCount, lockTestIn, lockTestOut;
+static int lockTestSum, lockTestDone;
+static Lock *lockTestLock;
+static Condition *lockTestNotFull, *lockTestNotEmpty;
+
+static void
+LockTestProducer(int which)
+{
+    for (int i = 1; i <= lockTestItems; i++) {
+	lockTestLock->Acquire();
+	while (lockTestCount == lockTestSlots)
+	    lockTestNotFull->Wait(lockTestLock);
+	lockTestBuffer[lockTestIn] = i;
+	if (i % 7 == which)
+	    currentThread->Yield();	// hold the lock a while
+	lockTestIn = (lockTestIn + 1) % lockTestSlots;
+	lockTestCount++;
+	lockTestNotEmpty->Signal(lockTestLock);
+	lockTestLock->Release();
+    }
+}
+
+static void
+LockTestConsumer(int which)
+{
+    for (int i = 1; i <= lockTestItems; i++) {
+	lockTestLock->Acquire();
+	while (lockTestCount == 0)
+	    lockTestNotEmpty->Wait(lockTestLock);
+	lockTestSum += lockTestBuffer[lockTestOut];
+	if (i % 5 == which)
+	    currentThread->Yield();
+	lockTestOut = (lockTestOut + 1) % lockTestSlots;
+	lockTestCount--;
+	lockTestNotFull->Signal(lockTestLock);
+	lockTestLock->Release();
+    }
+    lockTestLock->Acquire();
+    lockTestDone++;
+    lockTestLock->Release();
+}
+
+void
+LockTest()
+{
+    lockTestLock = new Lock("buffer lock");
+    lockTestNotFull = new Condition("buffer not full");
+    lockTestNotEmpty = new Condition("buffer not empty");
+
+    for (int i = 0; i < lockTestThreads; i++) {
+	(new Thread("producer"))->Fork(LockTestProducer, i);
+	(new Thread("consumer"))->Fork(LockTestConsumer, i);
+    }
+    while (lockTestDone < lockTestThreads)
+	currentThread->Yield();
+
+    ASSERT(lockTestSum == 
+		lockTestThreads * lockTestItems * (lockTestItems + 1) / 2);
+    ASSERT((lockTestLock->getWaitTicks() >= 0) &&
+		(lockTestNotFull->getWaitTicks() >= 0) &&
+		(lockTestNotEmpty->getWaitTicks() >= 0));
+    ASSERT((stats->lockWaitTicks >= 0) && (stats->conditionWaitTicks >= 0));
+    printf("Bounded buffer: %d items passed through %d slots\n",
+		lockTestThreads * lockTestItems, lockTestSlots);
+    delete lockTestNotEmpty;
+    delete lockTestNotFull;
+    delete lockTestLock;
+}
+
+//----------------------------------------------------------------------
+// PriorityTest
+// 	Check priority scheduling, and priority inheritance through
+//	locks, with the classic inversion: a low priority thread holds a
+//	lock that a high priority thread needs, while a medium priority
+//	thread has plenty to do.  Without inheritance, the medium thread
+//	would run first, holding up the high priority one.  With it, 
+//	the low thread runs at high priority until it lets go of the 
+//	lock, so the order must be low, high, medium.
+//
+//	Run with "nachos -q 4".
+//----------------------------------------------------------------------
+
+static Lock *priorityTestLock;
+static char priorityTestOrder[4];	// who finished, in order
+static int priorityTestFinished;
+
+static void
+PriorityTestFinish(char who)
+{
+    printf("%c thread done, at priority %d\n", who, 
+					currentThread->getPriority());
+    priorityTestOrder[priorityTestFinished++] = who;
+}
+
+static void
+PriorityTestHigh(int dummy)
+{
+    priorityTestLock->Acquire();	// lends "low" our priority
+    priorityTestLock->Release();
+    PriorityTestFinish('H');
+}
+
+static void
+PriorityTestMedium(int dummy)
+{
+    for (int i = 0; i < 10; i++)
+	currentThread->Yield();		// busy, but never blocks
+    PriorityTestFinish('M');
+}
+
+static void
+PriorityTestLow(int dummy)
+{
+    Thread *t;
+
+    priorityTestLock->Acquire();
+    t = new Thread("high");
+    t->setPriority(DefaultPriority + 10);
+    t->Fork(PriorityTestHigh, 0);
+    t = new Thread("medium");
+    t->setPriority(DefaultPriority + 5);
+    t->Fork(PriorityTestMedium, 0);
+
+    for (int i = 0; i < 10; i++)
+	currentThread->Yield();		// "high" runs, and waits for us
+    ASSERT(currentThread->getPriority() == DefaultPriority + 10);
+    priorityTestLock->Release();
+    ASSERT(currentThread->getPriority() == DefaultPriority);
+    PriorityTestFinish('L');
+}
+
+void
+PriorityTest()
+{
+    Thread *t = new Thread("low");
+
+    priorityTestLock = new Lock("inversion lock");
+    t->Fork(PriorityTestLow, 0);
+    currentThread->setPriority(MinPriority);	// let everyone else run
+    currentThread->Yield();
+    while (priorityTestFinished < 3)
+	currentThread->Yield();
+
+    priorityTestOrder[3] = '\0';
+    printf("Finishing order: %s\n", priorityTestOrder);
+    ASSERT(!strcmp(priorityTestOrder, "LHM"));
+    delete priorityTestLock;
+}
+
+//----------------------------------------------------------------------
+// FeedbackTest
+// 	A mix of CPU-bound and interactive threads, to compare round 
+//	robin with the multilevel feedback queue.  Two threads just
+//	compute; a third waits for a "keystroke" (a console interrupt
+//	every feedbackTestThink ticks), then does a little work in
+//	response.  We print how long, on average, the responses took,
+//	and when each thread finished.
+//
+//	Compare "nachos -rs 1 -q 5" with "nachos -mlfq 100,200,400 -q 5".
+//	Kernel code only advances the clock when interrupts are
+//	re-enabled, so that is how the threads "compute".
+//----------------------------------------------------------------------
+
+static const int feedbackTestWork = 2000;	// units of work per
+						// CPU-bound thread
+static const int feedbackTestKeys = 20;		// keystrokes to respond to
+static const int feedbackTestThink = 500;	// time between them
+static Semaphore *feedbackTestKey, *feedbackTestDone;
+static int feedbackTestPressed, feedbackTestLatency;
+
+static void
+FeedbackTestCompute(int units)
+{
+    for (int i = 0; i < units; i++) {
+	interrupt->SetLevel(IntOff);
+	interrupt->SetLevel(IntOn);		// one SystemTick of work
+    }
+}
+
+static void
+FeedbackTestKeystroke(int dummy)
+{
+    feedbackTestPressed = stats->totalTicks;
+    feedbackTestKey->V();
+}
+
+static void
+FeedbackTestInteractive(int dummy)
+{
+    for (int i = 0; i < feedbackTestKeys; i++) {
+	interrupt->Schedule(FeedbackTestKeystroke, 0, feedbackTestThink, 
+							ConsoleReadInt);
+	feedbackTestKey->P();
+	FeedbackTestCompute(3);
+	feedbackTestLatency += stats->totalTicks - feedbackTestPressed;
+    }
+    printf("Interactive thread done at %d, average response %d ticks\n",
+	stats->totalTicks, feedbackTestLatency / feedbackTestKeys);
+    feedbackTestDone->V();
+}
+
+static void
+FeedbackTestBatch(int which)
+{
+    FeedbackTestCompute(feedbackTestWork);
+    printf("CPU-bound thread %d done at %d\n", which, stats->totalTicks);
+    feedbackTestDone->V();
+}
+
+void
+FeedbackTest()
+{
+    feedbackTestKey = new Semaphore("keystroke", 0);
+    feedbackTestDone = new Semaphore("done", 0);
+    (new Thread("batch 0"))->Fork(FeedbackTestBatch, 0);
+    (new Thread("batch 1"))->Fork(FeedbackTestBatch, 1);
+    (new Thread("interactive"))->Fork(FeedbackTestInteractive, 0);
+
+    for (int i = 0; i < 3; i++)
+	feedbackTestDone->P();
+    delete feedbackTestDone;
+    delete feedbackTestKey;
+}
+
 //----------------------------------------------------------------------
 // ThreadTest
 // 	Invoke a test routine.
@@ -64,6 +349,18 @@ ThreadTest()
     case 1:
 	ThreadTest1();
 	break;
+    case 2:
+	QueueTest();
+	break;
+    case 3:
+	LockTest();
+	break;
+    case 4:
+	PriorityTest();
+	break;
+    case 5:
+	FeedbackTest();
+	break;
     default:
 	printf("No test specified.\n");
 	break;
@@ -18,11 +18,23 @@
 #include "copyright.h"
 #include "system.h"
 #include "addrspace.h"
-#include "noff.h"
+#include "synch.h"
+#include "aio.h"
 #ifdef HOST_SPARC
 #include <strings.h>
 #endif
 
+#ifndef VM
+static int frameRefs[NumPhysPages];	// # of address spaces using each
+					// frame (with virtual memory, the
+					// core map keeps track of this)
+static int framesReserved = 0;		// # of free frames promised to
+					// address spaces: one for each page
+					// not yet zero filled, and one for
+					// each copy-on-write copy that may
+					// yet be made
+#endif
+
 //----------------------------------------------------------------------
 // SwapHeader
 // 	Do little endian to big endian conversion on the bytes in the 
@@ -45,17 +57,108 @@ SwapHeader (NoffHeader *noffH)
 	noffH->uninitData.inFileAddr = WordToHost(noffH->uninitData.inFileAddr);
 }
 
+//----------------------------------------------------------------------
+// ReadHeader
+// 	Read the object file header at the start of an executable into
+//	"noffH", swapping its bytes if need be.  Return FALSE if the file
+//	isn't in NOFF format at all, so that it can't be run.
+//
+//	"executable" -- the file to read it from
+//	"noffH" -- where to put it
+//----------------------------------------------------------------------
+
+bool
+ReadHeader(OpenFile *executable, NoffHeader *noffH)
+{
+    if (executable->ReadAt((char *) noffH, sizeof(NoffHeader), 0) !=
+		sizeof(NoffHeader))
+	return FALSE;
+    if ((noffH->noffMagic != NOFFMAGIC) &&
+		(WordToHost(noffH->noffMagic) == NOFFMAGIC))
+	SwapHeader(noffH);
+    return (noffH->noffMagic == NOFFMAGIC) && (noffH->code.size >= 0) &&
+	(noffH->initData.size >= 0) && (noffH->uninitData.size >= 0);
+}
+
+//----------------------------------------------------------------------
+// InSegment, IsLoaded
+// 	Return TRUE if any of a segment of the executable falls within a
+//	virtual page; and if any of its code or initialized data does, so
+//	that the page has to be loaded from the file, rather than just
+//	zero filled.
+//
+//	"segment" -- the segment
+//	"noffH" -- where the executable's segments are
+//	"vpn" -- the virtual page
+//----------------------------------------------------------------------
+
+static bool
+InSegment(Segment *segment, int vpn)
+{
+    return (segment->size > 0) && 
+	(segment->virtualAddr < (vpn + 1) * PageSize) &&
+	(segment->virtualAddr + segment->size > vpn * PageSize);
+}
+
+static bool
+IsLoaded(NoffHeader *noffH, int vpn)
+{
+    return InSegment(&noffH->code, vpn) || InSegment(&noffH->initData, vpn);
+}
+
+//----------------------------------------------------------------------
+// LoadSegment
+// 	Copy whatever part of a segment of the executable falls within 
+//	a virtual page, into the frame holding that page.  Frames needn't
+//	be contiguous, so we load programs a page at a time.
+//
+//	"executable" -- the file containing the object code
+//	"segment" -- the segment to copy from
+//	"vpn" -- the virtual page being loaded
+//	"page" -- where the page is in main memory
+//----------------------------------------------------------------------
+
+static void
+LoadSegment(OpenFile *executable, Segment *segment, int vpn, char *page)
+{
+    int start = max(segment->virtualAddr, vpn * PageSize);
+    int end = min(segment->virtualAddr + segment->size, (vpn + 1) * PageSize);
+
+    if (start < end)
+	executable->ReadAt(page + start - vpn * PageSize, end - start,
+			segment->inFileAddr + start - segment->virtualAddr);
+}
+
 //----------------------------------------------------------------------
 // AddrSpace::AddrSpace
 // 	Create an address space to run a user program.
 //	Load the program from a file "executable", and set everything
 //	up so that we can start executing user instructions.
 //
-//	Assumes that the object code file is in NOFF format.
+//	Assumes that the object code file is in NOFF format; the caller
+//	checks, with ReadHeader.
 //
 //	First, set up the translation from program memory to physical 
-//	memory.  For now, this is really simple (1:1), since we are
-//	only uniprogramming, and we have a single unsegmented page table
+//	memory.  Each page gets whatever frame is free, so that many
+//	programs can be in memory at once; we have a single unsegmented
+//	page table.  Code pages that another address space running the
+//	same executable has already loaded aren't loaded again: we share
+//	its frames, read-only.
+//
+//	Pages of uninitialized data and stack that have nothing from the
+//	executable on them get no frame yet: they start out invalid, and
+//	are zero filled by PageIn when the program first touches them --
+//	if it ever does.  But we reserve a frame for each of them now, so
+//	that there is sure to be one then.  If there aren't enough free
+//	frames, the program isn't loaded, and "loaded" is FALSE.
+//
+//	With virtual memory, we load nothing yet: every page starts out
+//	invalid, and is loaded by PageIn when it is first touched.
+//
+//	Once the program is loaded, the address space keeps "executable"
+//	open -- to load pages from, with virtual memory, and so that the
+//	file stays the one the text cache knows it as -- and closes it
+//	when it goes away.  If it isn't loaded, the caller must close it.
 //
 //	"executable" is the file containing the object code to load into memory
 //----------------------------------------------------------------------
@@ -64,12 +167,13 @@ AddrSpace::AddrSpace(OpenFile *executable)
 {
     NoffHeader noffH;
     unsigned int i, size;
+#ifndef VM
+    unsigned int numLoaded = 0, numZero = 0;
+    char *page;
+#endif
 
-    executable->ReadAt((char *)&noffH, sizeof(noffH), 0);
-    if ((noffH.noffMagic != NOFFMAGIC) && 
-		(WordToHost(noffH.noffMagic) == NOFFMAGIC))
-    	SwapHeader(&noffH);
-    ASSERT(noffH.noffMagic == NOFFMAGIC);
+    if (!ReadHeader(executable, &noffH))
+	ASSERT(FALSE);			// the caller checked it
 
 // how big is address space?
     size = noffH.code.size + noffH.initData.size + noffH.uninitData.size 
@@ -77,55 +181,261 @@ AddrSpace::AddrSpace(OpenFile *executable)
 						// to leave room for the stack
     numPages = divRoundUp(size, PageSize);
     size = numPages * PageSize;
+    text = textCache->Attach(executable, &noffH);
+    loaded = TRUE;
 
-    ASSERT(numPages <= NumPhysPages);		// check we're not trying
-						// to run anything too big --
-						// at least until we have
-						// virtual memory
+#ifndef VM
+    for (i = 0; i < numPages; i++)
+	if (!IsLoaded(&noffH, i))
+	    numZero++;
+	else if (!(IsText(i) && (*text->FrameOf(i) != -1)))
+	    numLoaded++;
+    if (numLoaded + numZero >
+		(unsigned int) (frameMap->NumClear() - framesReserved)) {
+	DEBUG('a', "No room for %d pages\n", numLoaded + numZero);
+	if (text != NULL)		// too big -- at least until we
+	    textCache->Detach(text);	// have virtual memory
+	text = NULL;
+	numPages = 0;
+	loaded = FALSE;
+    } else
+	framesReserved += numZero;
+#endif
 
     DEBUG('a', "Initializing address space, num pages %d, size %d\n", 
 					numPages, size);
 // first, set up the translation 
     pageTable = new TranslationEntry[numPages];
+    copyOnWrite = new bool[numPages];
+    openFiles = new OpenFileTable();
+    aio = NULL;
     for (i = 0; i < numPages; i++) {
-	pageTable[i].virtualPage = i;	// for now, virtual page # = phys page #
-	pageTable[i].physicalPage = i;
-	pageTable[i].valid = TRUE;
+	pageTable[i].virtualPage = i;
+#ifdef VM
+	pageTable[i].physicalPage = 0;	// not in memory yet
+	pageTable[i].valid = FALSE;
+#else
+	if (!IsLoaded(&noffH, i)) {
+	    pageTable[i].physicalPage = 0;	// zero filled when touched
+	    pageTable[i].valid = FALSE;
+	} else if (IsText(i) && (*text->FrameOf(i) != -1)) {
+	    pageTable[i].physicalPage = *text->FrameOf(i);
+	    frameRefs[pageTable[i].physicalPage]++;
+	    stats->numTextShares++;
+	    pageTable[i].valid = TRUE;
+	} else {
+	    pageTable[i].physicalPage = frameMap->Find();
+	    frameRefs[pageTable[i].physicalPage] = 1;
+	    pageTable[i].valid = TRUE;
+	}
+#endif
 	pageTable[i].use = FALSE;
 	pageTable[i].dirty = FALSE;
-	pageTable[i].readOnly = FALSE;  // if the code segment was entirely on 
-					// a separate page, we could set its 
-					// pages to be read-only
+	pageTable[i].readOnly = IsText(i);	// code is never written
+	copyOnWrite[i] = FALSE;
     }
-    
-// zero out the entire address space, to zero the unitialized data segment 
-// and the stack segment
-    bzero(machine->mainMemory, size);
 
-// then, copy in the code and data segments into memory
-    if (noffH.code.size > 0) {
+#ifdef USE_TLB
+    asid = tlbManager->NewAsid(pageTable);
+#endif
+
+    if (loaded) {
+	program = new Executable;
+	program->file = executable;
+	program->header = noffH;
+	program->refs = 1;
+    } else
+	program = NULL;
+#ifdef VM
+    swapSpace->Open();
+    swapSlot = new int[numPages];
+    for (i = 0; i < numPages; i++)
+	swapSlot[i] = -1;
+    pagingLock = new Lock("paging");
+#else
+    if (noffH.code.size > 0)
         DEBUG('a', "Initializing code segment, at 0x%x, size %d\n", 
 			noffH.code.virtualAddr, noffH.code.size);
-        executable->ReadAt(&(machine->mainMemory[noffH.code.virtualAddr]),
-			noffH.code.size, noffH.code.inFileAddr);
-    }
-    if (noffH.initData.size > 0) {
+    if (noffH.initData.size > 0)
         DEBUG('a', "Initializing data segment, at 0x%x, size %d\n", 
 			noffH.initData.virtualAddr, noffH.initData.size);
-        executable->ReadAt(&(machine->mainMemory[noffH.initData.virtualAddr]),
-			noffH.initData.size, noffH.initData.inFileAddr);
+
+// zero out each page that has code or data on it, to zero whatever of
+// the uninitialized data segment shares the page, and copy in the code
+// and data segments -- except for the code pages we are sharing, which
+// are already loaded
+    for (i = 0; i < numPages; i++) {
+	if (!pageTable[i].valid)
+	    continue;
+	if (IsText(i)) {
+	    if (*text->FrameOf(i) == pageTable[i].physicalPage)
+		continue;
+	    *text->FrameOf(i) = pageTable[i].physicalPage;
+	}
+	page = &machine->mainMemory[pageTable[i].physicalPage * PageSize];
+	bzero(page, PageSize);
+	LoadSegment(executable, &noffH.code, i, page);
+	LoadSegment(executable, &noffH.initData, i, page);
+
+// we changed physical memory behind the machine's back, so make sure 
+// it doesn't run stale instructions out of its decode cache
+	machine->InvalidateFrame(pageTable[i].physicalPage);
     }
+#endif
+}
 
+//----------------------------------------------------------------------
+// AddrSpace::AddrSpace
+// 	Create an address space that is a copy of another -- for a process
+//	forked from the one running in "parent".
+//
+//	Rather than copy every page, the two address spaces share the
+//	frames of the parent's pages, until one of them writes to one.
+//	We mark the pages read-only in both page tables, so that the write
+//	traps, and remember that they are only copy-on-write (see
+//	CopyOnWrite).
+//
+//	Pages that aren't in memory aren't shared: the child loads its own
+//	copy when it needs one, from wherever the parent would -- the
+//	executable, or with virtual memory a swap slot, which the two now
+//	share until one of them has to write the page out again.  Without
+//	virtual memory, such a page has never been touched, and the child
+//	just zero fills it.  Then we reserve frames, as for a program we
+//	load: for each such page, and for each page that one of the two
+//	may now have to copy.  If there aren't enough free frames, the
+//	copy isn't made, and "loaded" is FALSE.
+//
+//	"parent" -- the address space to copy
+//----------------------------------------------------------------------
+
+AddrSpace::AddrSpace(AddrSpace *parent)
+{
+    TranslationEntry *entry;
+    unsigned int i;
+#ifndef VM
+    int numNeeded = 0;
+
+    for (i = 0; i < parent->numPages; i++)
+	if (!parent->pageTable[i].valid || !parent->pageTable[i].readOnly ||
+		parent->copyOnWrite[i])
+	    numNeeded++;
+#endif
+
+    numPages = parent->numPages;
+    loaded = TRUE;
+#ifndef VM
+    if (numNeeded > frameMap->NumClear() - framesReserved) {
+	DEBUG('a', "No room to fork, %d pages\n", numNeeded);
+	numPages = 0;
+	loaded = FALSE;
+    } else
+	framesReserved += numNeeded;
+#endif
+    text = (numPages > 0) ? parent->text : NULL;
+    if (text != NULL)
+	text->refs++;
+    DEBUG('a', "Forking address space, num pages %d\n", numPages);
+    pageTable = new TranslationEntry[numPages];
+    copyOnWrite = new bool[numPages];
+    openFiles = new OpenFileTable();
+    aio = NULL;
+    program = (numPages > 0) ? parent->program : NULL;
+    if (program != NULL)
+	program->refs++;
+#ifdef USE_TLB
+    asid = tlbManager->NewAsid(pageTable);
+#endif
+#ifdef VM
+    swapSlot = new int[numPages];
+    pagingLock = new Lock("paging");
+    parent->pagingLock->Acquire();	// no page of the parent's may be
+					// half way through being paged in 
+					// or copied, by another thread
+#endif
+
+    for (i = 0; i < numPages; i++) {
+	entry = &parent->pageTable[i];
+#ifdef USE_TLB
+	tlbManager->Forget(parent->asid, i);	// it may become read-only
+#endif
+#ifdef VM
+	swapSlot[i] = parent->swapSlot[i];
+	if (swapSlot[i] != -1)
+	    swapSpace->Share(swapSlot[i]);
+#endif
+	if (!entry->valid) {
+	    pageTable[i] = *entry;
+	    copyOnWrite[i] = FALSE;
+	    continue;
+	}
+#ifdef VM
+	coreMap->Share(entry->physicalPage, this, i, &pageTable[i]);
+#else
+	frameRefs[entry->physicalPage]++;
+#endif
+	if (!entry->readOnly) {
+	    entry->readOnly = TRUE;
+	    parent->copyOnWrite[i] = TRUE;
+	}
+	pageTable[i] = *entry;
+	copyOnWrite[i] = parent->copyOnWrite[i];
+    }
+    machine->FlushTranslations();	// the parent's pages are read-only
+#ifdef VM
+    parent->pagingLock->Release();
+#endif
 }
 
 //----------------------------------------------------------------------
 // AddrSpace::~AddrSpace
-// 	Dealloate an address space.  Nothing for now!
+// 	Dealloate an address space.  Give back its ASID, if it has one,
+//	and the frames (and with virtual memory, the swap space) its pages
+//	are using -- unless they are shared, copy-on-write or as code, 
+//	with another address space, which is still using them.
+//
+//	Any asynchronous I/O still in progress is using our pages, so we
+//	first wait for it to finish.
 //----------------------------------------------------------------------
 
 AddrSpace::~AddrSpace()
 {
+    delete aio;
+#ifdef USE_TLB
+    tlbManager->FreeAsid(asid);
+#endif
+#ifdef VM
+    for (unsigned int i = 0; i < numPages; i++) {
+	if (pageTable[i].valid)
+	    coreMap->Unmap(pageTable[i].physicalPage, this);
+	if (swapSlot[i] != -1)
+	    swapSpace->Free(swapSlot[i]);
+    }
+    delete [] swapSlot;
+    delete pagingLock;
+#else
+    for (unsigned int i = 0; i < numPages; i++) {
+	if (!pageTable[i].valid) {
+	    framesReserved--;		// never touched
+	    continue;
+	}
+	if (copyOnWrite[i] && (frameRefs[pageTable[i].physicalPage] > 1))
+	    framesReserved--;		// one copy fewer may be needed
+	if (--frameRefs[pageTable[i].physicalPage] == 0) {
+	    frameMap->Clear(pageTable[i].physicalPage);
+	    if (IsText(i))
+		*text->FrameOf(i) = -1;
+	}
+    }
+#endif
+    if (text != NULL)
+	textCache->Detach(text);
+    if ((program != NULL) && (--program->refs == 0)) {
+	delete program->file;
+	delete program;
+    }
    delete pageTable;
+   delete [] copyOnWrite;
+   delete openFiles;
 }
 
 //----------------------------------------------------------------------
@@ -176,11 +486,438 @@ void AddrSpace::SaveState()
 // 	On a context switch, restore the machine state so that
 //	this address space can run.
 //
-//      For now, tell the machine where to find the page table.
+//      For now, tell the machine where to find the page table, and
+//	make it forget the translations it cached from the old one.
+//
+//	With a TLB, there's no page table to tell it about; instead we
+//	load our ASID, so that the TLB entries that are ours match again
+//	and the others don't.  They can all stay in the TLB.
 //----------------------------------------------------------------------
 
 void AddrSpace::RestoreState() 
 {
+#ifdef USE_TLB
+    machine->asid = asid;
+#else
     machine->pageTable = pageTable;
     machine->pageTableSize = numPages;
+#endif
+    machine->FlushTranslations();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyOnWrite
+// 	The user program tried to write to a read-only page.  If the page
+//	is really copy-on-write, give this address space a copy of its
+//	own, which it can write to -- or if no other address space is
+//	sharing the page any more, just let it write to the page.
+//
+//	Returns FALSE if the page really is read-only.  With virtual 
+//	memory, the page may have been paged out while we waited for
+//	someone else to finish paging; then we return TRUE, and the write
+//	is tried again, faulting in a copy of our own.
+//
+//	"vpn" -- the virtual page the program tried to write
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyOnWrite(int vpn)
+{
+    TranslationEntry *entry;
+    int oldFrame, frame;
+    char copy[PageSize];
+    bool shared;
+
+    if ((vpn < 0) || ((unsigned int) vpn >= numPages))
+	return FALSE;
+#ifdef VM
+    pagingLock->Acquire();
+#endif
+    entry = &pageTable[vpn];
+    if (!entry->valid || !copyOnWrite[vpn]) {
+#ifdef VM
+	pagingLock->Release();
+#endif
+	return !entry->valid;
+    }
+    oldFrame = entry->physicalPage;
+    stats->numCowFaults++;
+#ifdef USE_TLB
+    tlbManager->Forget(asid, vpn);	// its TLB entry is read-only
+#endif
+
+#ifdef VM
+    shared = coreMap->IsShared(oldFrame);
+#else
+    shared = (frameRefs[oldFrame] > 1);
+#endif
+    if (shared) {
+	bcopy(&machine->mainMemory[oldFrame * PageSize], copy, PageSize);
+#ifdef VM
+	entry->valid = FALSE;		// while we may wait for a frame
+	coreMap->Unmap(oldFrame, this);
+	frame = coreMap->Allocate(this, vpn, entry);
+	entry->valid = TRUE;
+#else
+	framesReserved--;
+	frame = frameMap->Find();
+	ASSERT(frame != -1);		// we reserved it
+	frameRefs[oldFrame]--;
+	frameRefs[frame] = 1;
+#endif
+	DEBUG('a', "Copying page %d from frame %d to frame %d\n", vpn,
+			oldFrame, frame);
+	bcopy(copy, &machine->mainMemory[frame * PageSize], PageSize);
+	machine->InvalidateFrame(frame);
+#ifdef VM
+	coreMap->Unpin(frame);
+#endif
+	entry->physicalPage = frame;
+	stats->numCowCopies++;
+    }
+    entry->readOnly = FALSE;
+    copyOnWrite[vpn] = FALSE;
+    machine->FlushTranslations();
+#ifdef VM
+    pagingLock->Release();
+#endif
+    return TRUE;
 }
+
+//----------------------------------------------------------------------
+// AddrSpace::Locate
+// 	Find where a byte of this address space is in main memory, so
+//	that the kernel can read or write it directly, on behalf of the
+//	program -- from the program's own thread, during a system call,
+//	or from another thread (see aio.cc).  The page is brought into
+//	memory if need be, and if we are going to write it and it is
+//	copy-on-write, we make a copy of our own first.
+//
+//	Returns a pointer to the byte, and sets "*count" to the # of bytes
+//	from there to the end of the page, all of which follow it in main
+//	memory; or returns NULL if the program can't use the address.  
+//	With virtual memory, the page stays put only until the caller next
+//	waits for anything, unless the caller pins its frame.
+//
+//	"virtAddr" -- the virtual address
+//	"writing" -- are we going to write to the page?
+//	"count" -- where to put the # of bytes left on the page
+//----------------------------------------------------------------------
+
+char *
+AddrSpace::Locate(int virtAddr, bool writing, int *count)
+{
+    unsigned int vpn = (unsigned) virtAddr / PageSize;
+    TranslationEntry *entry;
+
+    if (vpn >= numPages)
+	return NULL;
+    entry = &pageTable[vpn];
+    for (;;) {
+	while (!entry->valid)		// it may be paged out again while
+	    PageIn(vpn);		// we give up the paging lock
+	if (!writing || !entry->readOnly)
+	    break;
+	if (!CopyOnWrite(vpn))
+	    return NULL;		// really read-only
+    }
+    entry->use = TRUE;			// as the hardware would
+    if (writing)
+	entry->dirty = TRUE;
+    *count = PageSize - (unsigned) virtAddr % PageSize;
+    return &machine->mainMemory[entry->physicalPage * PageSize + 
+				(unsigned) virtAddr % PageSize];
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::CopyIn, AddrSpace::CopyOut
+// 	Copy a buffer from this address space into the kernel, or from
+//	the kernel into this address space, a page at a time.  Return
+//	FALSE if part of the buffer isn't in the address space.
+//
+//	"virtAddr" -- where the buffer is in the address space
+//	"buffer" -- where it is in the kernel
+//	"size" -- the # of bytes to copy
+//----------------------------------------------------------------------
+
+bool
+AddrSpace::CopyIn(int virtAddr, char *buffer, int size)
+{
+    char *user;
+    int n;
+
+    while (size > 0) {
+	if ((user = Locate(virtAddr, FALSE, &n)) == NULL)
+	    return FALSE;
+	n = min(n, size);
+	bcopy(user, buffer, n);
+	virtAddr += n;
+	buffer += n;
+	size -= n;
+    }
+    return TRUE;
+}
+
+bool
+AddrSpace::CopyOut(int virtAddr, char *buffer, int size)
+{
+    char *user;
+    int n;
+
+    while (size > 0) {
+	if ((user = Locate(virtAddr, TRUE, &n)) == NULL)
+	    return FALSE;
+	n = min(n, size);
+	bcopy(buffer, user, n);
+	machine->InvalidateFrame((user - machine->mainMemory) / PageSize);
+	virtAddr += n;
+	buffer += n;
+	size -= n;
+    }
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::Transfer
+// 	Read data from a file into a buffer in this address space, or
+//	write data from the buffer to the file, in place: the file reads
+//	or writes each page's span of the buffer directly in its frame.
+//	With virtual memory, the frame is pinned while the file uses it,
+//	so that the page can't be replaced if the file has to wait for
+//	the disk.
+//
+//	Returns the # of bytes read or written, which is less than "size"
+//	at the end of the file, or if the rest of the buffer isn't in the
+//	address space; -1 if none of the buffer is.
+//
+//	"file" -- the file to read or write
+//	"virtAddr" -- where the buffer is in the address space
+//	"size" -- the # of bytes to read or write
+//	"position" -- where in the file, or -1 for the file's current
+//		position (which is then moved on past the data)
+//	"reading" -- read from the file, rather than write to it?
+//----------------------------------------------------------------------
+
+int
+AddrSpace::Transfer(OpenFile *file, int virtAddr, int size, int position,
+			bool reading)
+{
+    int done = 0, n, result, frame;
+    char *user;
+
+    while (done < size) {
+	if ((user = Locate(virtAddr + done, reading, &n)) == NULL)
+	    return (done > 0) ? done : -1;
+	n = min(n, size - done);
+	frame = (user - machine->mainMemory) / PageSize;
+#ifdef VM
+	coreMap->Pin(frame);
+#endif
+	if (position == -1)
+	    result = reading ? file->Read(user, n) : file->Write(user, n);
+	else if (reading)
+	    result = file->ReadAt(user, n, position + done);
+	else
+	    result = file->WriteAt(user, n, position + done);
+	if (reading)
+	    machine->InvalidateFrame(frame);
+#ifdef VM
+	coreMap->Unpin(frame);
+#endif
+	done += result;
+	if (result < n)			// end of file
+	    break;
+    }
+    return done;
+}
+
+#ifdef USE_TLB
+//----------------------------------------------------------------------
+// AddrSpace::TlbMiss
+// 	Handle a TLB miss: the user program touched a page that has no
+//	entry in the TLB.  Load the page's translation into the TLB --
+//	first loading the page itself, with virtual memory, if it isn't
+//	in memory.
+//
+//	"vpn" -- the virtual page the program touched
+//----------------------------------------------------------------------
+
+void
+AddrSpace::TlbMiss(int vpn)
+{
+    ASSERT((vpn >= 0) && ((unsigned int) vpn < numPages));
+					// else it's an address error
+    while (!pageTable[vpn].valid)	// it may be paged out again while
+	PageIn(vpn);			// we give up the paging lock
+    tlbManager->Refill(vpn, &pageTable[vpn]);
+}
+#endif
+
+#ifndef VM
+//----------------------------------------------------------------------
+// AddrSpace::PageIn
+// 	Give a page of uninitialized data or stack a frame, and zero it,
+//	because the user program touched it for the first time (a page
+//	fault).  Without virtual memory, these are the only pages that
+//	aren't always in memory.  A frame was reserved for the page when
+//	the address space was made, so there is sure to be one.
+//
+//	"vpn" -- the virtual page the program touched
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PageIn(int vpn)
+{
+    TranslationEntry *entry = &pageTable[vpn];
+    int frame;
+
+    if (entry->valid)
+	return;
+    stats->numPageFaults++;
+    framesReserved--;
+    frame = frameMap->Find();
+    ASSERT(frame != -1);		// we reserved it
+    frameRefs[frame] = 1;
+    DEBUG('a', "Zero filling page %d in frame %d\n", vpn, frame);
+    bzero(&machine->mainMemory[frame * PageSize], PageSize);
+    machine->InvalidateFrame(frame);
+    entry->physicalPage = frame;
+    entry->valid = TRUE;
+    entry->use = FALSE;
+    entry->dirty = FALSE;
+    entry->readOnly = FALSE;
+    copyOnWrite[vpn] = FALSE;
+}
+#else
+//----------------------------------------------------------------------
+// AddrSpace::PageIn
+// 	Bring a page into memory, because the user program touched it
+//	and it wasn't there (a page fault).  Find it a frame, paging 
+//	something else out if need be, and load it: from the swap space, 
+//	if it has been written there, else from the executable -- zero 
+//	filling whatever isn't code or initialized data.
+//
+//	Only one thread at a time pages in (or copies) our pages; if the
+//	page was brought in while we waited our turn, there's nothing to
+//	do.
+//
+//	"vpn" -- the virtual page to load
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PageIn(int vpn)
+{
+    TranslationEntry *entry = &pageTable[vpn];
+    int frame;
+    char *page;
+
+    pagingLock->Acquire();
+    if (entry->valid) {
+	pagingLock->Release();
+	return;
+    }
+    stats->numPageFaults++;
+    if (IsText(vpn) && (*text->FrameOf(vpn) != -1)) {
+	frame = *text->FrameOf(vpn);	// someone else has loaded it
+	DEBUG('a', "Sharing code page %d in frame %d\n", vpn, frame);
+	coreMap->Share(frame, this, vpn, entry);
+	stats->numTextShares++;
+    } else {
+	frame = coreMap->Allocate(this, vpn, entry);
+	page = &machine->mainMemory[frame * PageSize];
+	DEBUG('a', "Loading page %d into frame %d\n", vpn, frame);
+
+	if (swapSlot[vpn] != -1)
+	    swapSpace->ReadPage(swapSlot[vpn], page);
+	else {
+	    bzero(page, PageSize);
+	    LoadSegment(program->file, &program->header.code, vpn, page);
+	    LoadSegment(program->file, &program->header.initData, vpn, page);
+	}
+	machine->InvalidateFrame(frame);
+	if (IsText(vpn)) {		// others can share it now
+	    *text->FrameOf(vpn) = frame;
+	    coreMap->Cache(frame, text->FrameOf(vpn));
+	}
+	coreMap->Unpin(frame);		// Allocate pinned it
+    }
+
+    entry->physicalPage = frame;
+    entry->valid = TRUE;
+    entry->use = FALSE;
+    entry->dirty = FALSE;
+    entry->readOnly = IsText(vpn);	// any other copy is our own
+    copyOnWrite[vpn] = FALSE;
+    pagingLock->Release();
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageOut
+// 	Take a page out of memory, so that its frame can be used for
+//	another page.  If the page has been modified since it was loaded,
+//	write it to the swap space; otherwise, whatever it was loaded
+//	from still has a good copy.  If the page's swap slot is shared
+//	with a forked address space, that one still needs what is in the
+//	slot, so the page gets a slot of its own.
+//
+//	"vpn" -- the virtual page to take out of memory
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PageOut(int vpn)
+{
+    TranslationEntry *entry = &pageTable[vpn];
+
+    ASSERT(entry->valid);
+#ifdef USE_TLB
+    tlbManager->Forget(asid, vpn);	// and get its dirty bit up to date
+#endif
+    entry->valid = FALSE;		// before we wait for the disk; if the
+    machine->FlushTranslations();	// page is wanted meanwhile, it will
+					// be read back after it is written
+    if (entry->dirty) {
+	if ((swapSlot[vpn] != -1) && swapSpace->IsShared(swapSlot[vpn])) {
+	    swapSpace->Free(swapSlot[vpn]);
+	    swapSlot[vpn] = -1;
+	}
+	if (swapSlot[vpn] == -1)
+	    swapSlot[vpn] = swapSpace->Allocate();
+	DEBUG('a', "Writing page %d to swap slot %d\n", vpn, swapSlot[vpn]);
+	swapSpace->WritePage(swapSlot[vpn], 
+			&machine->mainMemory[entry->physicalPage * PageSize]);
+    }
+}
+
+//----------------------------------------------------------------------
+// AddrSpace::PageOutShared
+// 	Take a page out of memory, when its frame is shared copy-on-write
+//	with other address spaces, so that the frame can be used for
+//	another page.  The core map writes the page to swap once, for all
+//	of them, if need be; our copy is then in that slot, rather than in
+//	whatever we would have loaded it from.
+//
+//	The caller must flush the machine's cached translations.
+//
+//	"vpn" -- the virtual page to take out of memory
+//	"slot" -- the swap slot the page was written to, or -1 if it
+//		wasn't modified
+//----------------------------------------------------------------------
+
+void
+AddrSpace::PageOutShared(int vpn, int slot)
+{
+    TranslationEntry *entry = &pageTable[vpn];
+
+    ASSERT(entry->valid);
+#ifdef USE_TLB
+    tlbManager->Forget(asid, vpn);
+#endif
+    if (slot != -1) {
+	if (swapSlot[vpn] != -1)
+	    swapSpace->Free(swapSlot[vpn]);
+	swapSpace->Share(slot);
+	swapSlot[vpn] = slot;
+    }
+    entry->valid = FALSE;
+}
+#endif
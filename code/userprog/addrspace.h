@@ -2,10 +2,31 @@
 //	Data structures to keep track of executing user programs 
 //	(address spaces).
 //
-//	For now, we don't keep any information about address spaces.
 //	The user level CPU state is saved and restored in the thread
 //	executing the user program (see thread.h).
 //
+//	Pages of uninitialized data and stack are only given a frame, and
+//	zero filled, when they are first touched.  With virtual memory,
+//	every page is only loaded when it is first touched, and may be
+//	paged out again to make room for others; so an address space also
+//	keeps where each page is in the swap space.  In any case, it keeps
+//	its executable open.
+//
+//	A process can fork a copy of itself.  The copy shares its parent's
+//	pages, copy-on-write: the pages are marked read-only in both page
+//	tables, and the first one to write a page gets a private copy of
+//	it, when the hardware traps the write.
+//
+//	Code pages are read-only too, and are shared by every address
+//	space running the same executable (see textcache.h).
+//
+//	Each address space is one process, so it also keeps the files
+//	the process has open (see filetable.h), and its asynchronous I/O
+//	requests, if it makes any (see aio.h).  Since kernel threads other
+//	than the process's own may read and write its pages on its behalf,
+//	the address space lets them find where each byte is (Locate),
+//	paging it in or copying it first, if need be.
+//
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
 // of liability and disclaimer of warranty provisions.
@@ -15,14 +36,34 @@
 
 #include "copyright.h"
 #include "filesys.h"
+#include "noff.h"
+#include "textcache.h"
+#include "filetable.h"
+
+class Lock;
+class AsyncIO;
 
 #define UserStackSize		1024 	// increase this as necessary!
 
+// The following class defines an executable that is kept open by the
+// address space that opened it and any forked from it: with virtual
+// memory, to load pages from; and in any case, so that no other file
+// can take its identity while the text cache has its code.
+
+class Executable {
+  public:
+    OpenFile *file;			// the file with the object code
+    NoffHeader header;			// where its segments are
+    int refs;				// # of address spaces running it
+};
+
 class AddrSpace {
   public:
     AddrSpace(OpenFile *executable);	// Create an address space,
 					// initializing it with the program
 					// stored in the file "executable"
+    AddrSpace(AddrSpace *parent);	// Create a copy of "parent", sharing
+					// its pages copy-on-write
     ~AddrSpace();			// De-allocate an address space
 
     void InitRegisters();		// Initialize user-level CPU registers,
@@ -31,11 +72,79 @@ class AddrSpace {
     void SaveState();			// Save/restore address space-specific
     void RestoreState();		// info on a context switch 
 
+    bool CopyOnWrite(int vpn);		// Give the address space its own
+					// copy of page "vpn", which it tried
+					// to write; FALSE if the page isn't
+					// copy-on-write
+
+    char *Locate(int virtAddr, bool writing, int *count);
+					// Where "virtAddr" is in main memory,
+					// and the # of bytes left on its
+					// page; NULL if it isn't ours
+    bool CopyIn(int virtAddr, char *buffer, int size);
+    bool CopyOut(int virtAddr, char *buffer, int size);
+					// Copy between the kernel and the
+					// address space; FALSE if "virtAddr"
+					// isn't ours
+    int Transfer(OpenFile *file, int virtAddr, int size, int position,
+		bool reading);		// Read or write a file directly from
+					// a buffer in the address space
+
+    bool loaded;			// FALSE if there wasn't room in
+					// memory for the program, and the
+					// address space is empty
+    OpenFileTable *openFiles;		// the files the program has open
+    AsyncIO *aio;			// its asynchronous I/O, or NULL if
+					// it hasn't asked for any
+
+#ifdef USE_TLB
+    void TlbMiss(int vpn);		// Load the translation for page
+					// "vpn" into the TLB
+#endif
+    void PageIn(int vpn);		// Load page "vpn" into a frame, on
+					// a page fault (without virtual
+					// memory, just zero fill it)
+#ifdef VM
+    void PageOut(int vpn);		// Take page "vpn" out of its frame,
+					// writing it to swap if need be
+    void PageOutShared(int vpn, int slot);
+					// Take page "vpn" out of the frame
+					// it shares with other address
+					// spaces; "slot" is where it was
+					// written, if anywhere
+#endif
+
   private:
+    bool IsText(int vpn)		// Is page "vpn" shared code?
+	{ return (text != NULL) && text->Contains(vpn); }
+
     TranslationEntry *pageTable;	// Assume linear page table translation
 					// for now!
     unsigned int numPages;		// Number of pages in the virtual 
 					// address space
+    bool *copyOnWrite;			// which read-only pages are really
+					// shared with another address space,
+					// until one of them writes the page
+    SharedText *text;			// the code pages we share with other
+					// address spaces running the same
+					// executable, or NULL
+    Executable *program;		// where to find the code and the
+					// initialized data, or NULL if
+					// nothing was loaded
+#ifdef USE_TLB
+    int asid;				// tags our entries in the TLB
+#endif
+#ifdef VM
+    int *swapSlot;			// where each page is in the swap
+					// space, or -1 if it has never been
+					// written there
+    Lock *pagingLock;			// held while one of our pages is
+					// being paged in or copied
+#endif
 };
 
+extern bool ReadHeader(OpenFile *executable, NoffHeader *noffH);
+					// Read the header of "executable";
+					// FALSE if it isn't one
+
 #endif // ADDRSPACE_H
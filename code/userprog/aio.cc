@@ -0,0 +1,250 @@
+// aio.cc
+//	Routines to do a user program's I/O asynchronously, with a pool
+//	of kernel threads, and a ring of requests and completions shared
+//	with the program.
+//
+//	The pool is started when a program first sets up asynchronous
+//	I/O, and the workers never finish; each waits for a request on a
+//	queue they all share, does it, and goes back for another.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "aio.h"
+#include "synchlist.h"
+
+static SynchList *pending = NULL;	// requests waiting for a worker
+
+//----------------------------------------------------------------------
+// AioWorker
+// 	The life of an I/O worker thread: do requests, forever.
+//
+//	"dummy" is because every thread procedure takes one argument.
+//----------------------------------------------------------------------
+
+static void
+AioWorker(int dummy)
+{
+    AsyncRequest *request;
+
+    for (;;) {
+	request = (AsyncRequest *) pending->Remove();
+	request->owner->Perform(request);
+	delete request;
+    }
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::AsyncIO
+// 	Initialize a program's asynchronous I/O, starting the workers if
+//	nobody has needed them before.  The caller has checked that the
+//	ring is in the address space; the program has zeroed it, so
+//	nothing has been submitted or completed yet.
+//
+//	"addrSpace" -- the program's address space
+//	"ringAddr" -- where the ring is in it
+//----------------------------------------------------------------------
+
+AsyncIO::AsyncIO(AddrSpace *addrSpace, int ringAddr)
+{
+    Thread *worker;
+
+    space = addrSpace;
+    ring = ringAddr;
+    sqHead = cqTail = 0;
+    inFlight = 0;
+    lock = new Lock("aio");
+    completed = new Condition("aio completed");
+    if (pending == NULL) {
+	pending = new SynchList;
+	for (int i = 0; i < NumAioWorkers; i++) {
+	    worker = new Thread("aio worker");
+	    worker->Fork(AioWorker, 0);
+	}
+    }
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::~AsyncIO
+// 	De-allocate a program's asynchronous I/O, once the requests still
+//	in progress are done with its buffers.
+//----------------------------------------------------------------------
+
+AsyncIO::~AsyncIO()
+{
+    Drain();
+    delete completed;
+    delete lock;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::GetWord, AsyncIO::PutWord
+// 	Read or write a word of the ring.  The ring was checked to be in
+//	the address space when it was set up, and address spaces don't
+//	shrink, so this can't fail.
+//
+//	"offset" -- where the word is, in bytes from the start of the ring
+//	"value" -- what to write
+//----------------------------------------------------------------------
+
+unsigned int
+AsyncIO::GetWord(int offset)
+{
+    unsigned int word;
+    bool inSpace = space->CopyIn(ring + offset, (char *) &word, sizeof(int));
+
+    ASSERT(inSpace);
+    return WordToHost(word);
+}
+
+void
+AsyncIO::PutWord(int offset, unsigned int value)
+{
+    unsigned int word = WordToMachine(value);
+    bool inSpace = space->CopyOut(ring + offset, (char *) &word, sizeof(int));
+
+    ASSERT(inSpace);
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Submit
+// 	Take the requests the program has put on the ring since it last
+//	submitted, and queue them for the workers; bad ones complete
+//	right away, with -1.  We stop early if the completion queue might
+//	not have room for another completion.
+//
+//	Returns the # of requests taken; we tell the program by moving
+//	sqHead on past them.
+//----------------------------------------------------------------------
+
+int
+AsyncIO::Submit()
+{
+    unsigned int sqTail, cqHead;
+    AsyncRequest *request;
+    int opcode, id, taken = 0;
+
+    lock->Acquire();
+    sqTail = GetWord(4);
+    cqHead = GetWord(8);
+    while ((sqHead != sqTail) && (sqTail - sqHead <= AioRingSize) &&
+	    (inFlight + (int) (cqTail - cqHead) < AioRingSize)) {
+	request = new AsyncRequest;
+	request->owner = this;
+	opcode = GetWord(AioRequestAt(sqHead));
+	id = GetWord(AioRequestAt(sqHead) + 4);
+	request->buffer = GetWord(AioRequestAt(sqHead) + 8);
+	request->size = GetWord(AioRequestAt(sqHead) + 12);
+	request->position = GetWord(AioRequestAt(sqHead) + 16);
+	request->tag = GetWord(AioRequestAt(sqHead) + 20);
+	request->reading = (opcode == AioRead);
+	request->file = space->openFiles->Get(id);
+	sqHead++;
+	taken++;
+	stats->numAioRequests++;
+	if ((request->file == NULL) || (request->size < 0) ||
+		(request->position < 0) ||
+		((opcode != AioRead) && (opcode != AioWrite))) {
+	    Complete(request->tag, -1);
+	    delete request;
+	    continue;
+	}
+	DEBUG('a', "Async %s of %d bytes at %d, tag %d\n",
+		request->reading ? "read" : "write", request->size,
+		request->position, request->tag);
+	inFlight++;
+	if (inFlight > stats->maxAioInFlight)
+	    stats->maxAioInFlight = inFlight;
+	pending->Append((void *) request);
+    }
+    PutWord(0, sqHead);
+    lock->Release();
+    return taken;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Perform
+// 	Do a request, on behalf of the program, and post its completion.
+//	Called by an I/O worker; the worker, not the program, waits for
+//	the disk.
+//
+//	"request" -- what to do
+//----------------------------------------------------------------------
+
+void
+AsyncIO::Perform(AsyncRequest *request)
+{
+    int result = space->Transfer(request->file, request->buffer,
+				request->size, request->position,
+				request->reading);
+
+    lock->Acquire();
+    Complete(request->tag, result);
+    inFlight--;
+    completed->Broadcast(lock);
+    lock->Release();
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Complete
+// 	Post a completion on the ring: write it into the next slot, then
+//	move cqTail on past it, so the program never sees it half written.
+//	Submit made sure there is room.
+//
+//	"tag" -- the request's tag
+//	"result" -- the # of bytes read or written, or -1
+//----------------------------------------------------------------------
+
+void
+AsyncIO::Complete(int tag, int result)
+{
+    PutWord(AioCompletionAt(cqTail), tag);
+    PutWord(AioCompletionAt(cqTail) + 4, result);
+    cqTail++;
+    PutWord(12, cqTail);
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Wait
+// 	Wait until the program has at least "count" completions to
+//	consume, or until nothing it submitted is still in progress (so
+//	that waiting any longer would be forever).
+//
+//	Returns the # of completions the program has to consume.
+//
+//	"count" -- how many completions the program wants
+//----------------------------------------------------------------------
+
+int
+AsyncIO::Wait(int count)
+{
+    int ready;
+
+    lock->Acquire();
+    for (;;) {
+	ready = cqTail - GetWord(8);
+	if ((ready >= count) || (inFlight == 0))
+	    break;
+	completed->Wait(lock);
+    }
+    lock->Release();
+    return ready;
+}
+
+//----------------------------------------------------------------------
+// AsyncIO::Drain
+// 	Wait until nothing the program submitted is still in progress --
+//	before it closes a file, or goes away.
+//----------------------------------------------------------------------
+
+void
+AsyncIO::Drain()
+{
+    lock->Acquire();
+    while (inFlight > 0)
+	completed->Wait(lock);
+    lock->Release();
+}
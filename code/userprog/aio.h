@@ -0,0 +1,102 @@
+// aio.h
+//	Data structures for a user program's asynchronous I/O.
+//
+//	The program and the kernel share a ring of requests and
+//	completions, in the program's own memory (see AioRing in
+//	syscall.h).  When the program submits requests, the kernel takes
+//	them off the ring, and queues them for a pool of kernel threads
+//	-- the I/O workers -- which read and write the files, waiting for
+//	the disk while the program (or anything else) runs.  When a worker
+//	finishes a request, it posts its completion on the ring, and wakes
+//	up the program, if it is waiting.
+//
+//	The workers read and write the program's buffers (and the ring)
+//	through its address space, not the machine's translation, since
+//	the program isn't necessarily the one running (see
+//	AddrSpace::Locate).
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef AIO_H
+#define AIO_H
+
+#include "copyright.h"
+#include "synch.h"
+#include "openfile.h"
+#include "syscall.h"
+
+#define NumAioWorkers	4	// # of kernel threads doing asynchronous
+				// I/O, for all the programs
+
+// Where things are in an AioRing, in bytes: it is all words, in the
+// machine's byte order.
+
+#define AioHeaderWords	4	// sqHead, sqTail, cqHead, cqTail
+#define AioRequestWords	6
+#define AioCompletionWords	2
+#define AioRequests	(4 * AioHeaderWords)
+#define AioCompletions	(AioRequests + 4 * AioRequestWords * AioRingSize)
+#define AioRingBytes	(AioCompletions + 4 * AioCompletionWords * AioRingSize)
+
+#define AioRequestAt(i)	\
+	(AioRequests + 4 * AioRequestWords * ((i) % AioRingSize))
+#define AioCompletionAt(i) \
+	(AioCompletions + 4 * AioCompletionWords * ((i) % AioRingSize))
+
+class AddrSpace;
+class AsyncIO;
+
+// The following class defines one request, queued for the workers.
+
+class AsyncRequest {
+  public:
+    AsyncIO *owner;		// the program that asked for it
+    OpenFile *file;		// the file to read or write
+    bool reading;		// read it, rather than write it?
+    int buffer;			// where the data is, in the program
+    int size;			// # of bytes
+    int position;		// where in the file
+    int tag;			// what to tell the program, when it's done
+};
+
+// The following class defines a user program's asynchronous I/O.
+
+class AsyncIO {
+  public:
+    AsyncIO(AddrSpace *space, int ringAddr);
+				// Initialize asynchronous I/O for the
+				// program in "space", which shares the
+				// ring at "ringAddr"
+    ~AsyncIO();			// Wait for requests still in progress,
+				// and de-allocate
+
+    int Submit();		// Start the requests the program has
+				// put on the ring; return # taken
+    int Wait(int count);	// Wait for "count" completions, or for
+				// nothing to be in progress; return
+				// # ready
+    void Drain();		// Wait for nothing to be in progress
+
+    void Perform(AsyncRequest *request);
+				// Called by an I/O worker, to do
+				// a request and post its completion
+
+  private:
+    void Complete(int tag, int result);
+				// Post a completion on the ring
+    unsigned int GetWord(int offset);	// Read and write a word of the
+    void PutWord(int offset, unsigned int value);
+				// ring, "offset" bytes into it
+
+    AddrSpace *space;		// the program's address space
+    int ring;			// where the ring is in it
+    unsigned int sqHead;	// next request to take from the ring
+    unsigned int cqTail;	// where to put the next completion
+    int inFlight;		// # of requests taken, but not completed
+    Lock *lock;			// protects all of the above
+    Condition *completed;	// signalled when a request completes
+};
+
+#endif // AIO_H
@@ -102,6 +102,68 @@ BitMap::Find()
     return -1;
 }
 
+//----------------------------------------------------------------------
+// BitMap::FindRun
+// 	Find a run of consecutive clear bits, and set them.  We take the
+//	first run of at least "count" bits (just the first "count" of 
+//	them); if there is no such run, we take the longest run there is,
+//	so that the caller needs as few runs as possible to get "count"
+//	bits.  (This is how a file's sectors are kept together on disk.)
+//
+//	Return the number of the first bit of the run, and set "*length"
+//	to the number of bits in it; or if no bits are clear, return -1.
+//
+//	"count" is the number of bits wanted.
+//	"length" is where to put the number of bits found.
+//----------------------------------------------------------------------
+
+int
+BitMap::FindRun(int count, int *length)
+{
+    int start = -1, longest = 0;
+    int i, j;
+
+    for (i = 0; i < numBits; i = j + 1) {
+	for (j = i; (j < numBits) && !Test(j) && (j - i < count); j++)
+	    ;
+	if (j - i == count) {		// long enough
+	    start = i;
+	    longest = count;
+	    break;
+	}
+	if (j - i > longest) {
+	    start = i;
+	    longest = j - i;
+	}
+    }
+    for (i = 0; i < longest; i++)
+	Mark(start + i);
+    *length = longest;
+    return start;
+}
+
+//----------------------------------------------------------------------
+// BitMap::MarkRun
+// 	Set the clear bits starting at "start", up to "count" of them,
+//	stopping at the first bit that is already set (or at the end of
+//	the bitmap).  Return how many were set.  (This is how a file
+//	grows on from its last sector, if the ones after it are free.)
+//
+//	"start" is the number of the first bit to set.
+//	"count" is the most bits to set.
+//----------------------------------------------------------------------
+
+int
+BitMap::MarkRun(int start, int count)
+{
+    int i;
+
+    for (i = 0; (i < count) && (start + i < numBits) && !Test(start + i); 
+	    i++)
+	Mark(start + i);
+    return i;
+}
+
 //----------------------------------------------------------------------
 // BitMap::NumClear
 // 	Return the number of clear bits in the bitmap.
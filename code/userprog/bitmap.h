@@ -43,6 +43,16 @@ class BitMap {
     int Find();            	// Return the # of a clear bit, and as a side
 				// effect, set the bit. 
 				// If no bits are clear, return -1.
+    int FindRun(int count, int *length);
+				// Return the # of the first bit of a run
+				// of "count" clear bits -- or if there is
+				// none, of the longest run -- and set them;
+				// "*length" is how many.
+				// If no bits are clear, return -1.
+    int MarkRun(int start, int count);
+				// Set up to "count" clear bits from
+				// "start" on, stopping at a set bit;
+				// return how many were set
     int NumClear();		// Return the number of clear bits
 
     void Print();		// Print contents of bitmap
@@ -4,8 +4,12 @@
 //	transfer back to here from user code:
 //
 //	syscall -- The user code explicitly requests to call a procedure
-//	in the Nachos kernel.  Right now, the only function we support is
-//	"Halt".
+//	in the Nachos kernel.  We support all of those in syscall.h: 
+//	"Halt", the process operations "Exit", "Exec", "Join", "Fork" 
+//	and "Yield", the file operations "Create", "Open", "Read",
+//	"Write" and "Close", their vectored versions "ReadV" and "WriteV",
+//	asynchronous I/O, "AioSetup", "AioSubmit" and "AioWait", and
+//	"MultiCall", which makes a batch of the others in one trap.
 //
 //	exceptions -- The user code does something that the CPU can't handle.
 //	For instance, accessing memory that doesn't exist, arithmetic errors,
@@ -14,8 +18,16 @@
 //	Interrupts (which can also cause control to transfer from user
 //	code into the Nachos kernel) are handled elsewhere.
 //
-// For now, this only handles the Halt() system call.
-// Everything else core dumps.
+// For now, this only handles those system calls, page faults (without
+// virtual memory, only on the first touch of an uninitialized data or
+// stack page), TLB misses (with a TLB), and writes to pages shared
+// copy-on-write by forked processes.  Everything else core dumps.
+//
+// Read and Write move data straight between the user program's memory
+// and the file (or console), without copying it through the kernel: 
+// each page of the buffer is translated once, and its frame is handed 
+// to the file system to read into or write from.  Asynchronous reads
+// and writes do the same, from a kernel thread (see aio.h).
 //
 // Copyright (c) 1992-1993 The Regents of the University of California.
 // All rights reserved.  See copyright.h for copyright notice and limitation 
@@ -24,6 +36,524 @@
 #include "copyright.h"
 #include "system.h"
 #include "syscall.h"
+#include "aio.h"
+
+#define MaxStringLength	128	// longest string argument (including
+				// the '\0') we will copy in from a
+				// user program
+
+//----------------------------------------------------------------------
+// AdvancePC
+// 	Move the user program on past the syscall instruction, so that
+//	it continues after the system call when we return to it.
+//----------------------------------------------------------------------
+
+static void
+AdvancePC()
+{
+    int nextPC = machine->ReadRegister(NextPCReg);
+
+    machine->WriteRegister(PrevPCReg, machine->ReadRegister(PCReg));
+    machine->WriteRegister(PCReg, nextPC);
+    machine->WriteRegister(NextPCReg, nextPC + 4);
+}
+
+//----------------------------------------------------------------------
+// ReadString
+// 	Copy a null-terminated string out of the user program's memory,
+//	a page at a time, truncating it if it doesn't fit in "into".
+//	Return FALSE if it runs off the end of the program's address 
+//	space.
+//
+//	"from" -- the user virtual address of the string
+//	"into" -- where to put it
+//	"size" -- the size of "into"
+//----------------------------------------------------------------------
+
+static bool
+ReadString(int from, char *into, int size)
+{
+    char *user, *end;
+    int n;
+
+    while (size > 1) {
+	if ((user = currentThread->space->Locate(from, FALSE, &n)) == NULL)
+	    return FALSE;
+	n = min(n, size - 1);
+	if ((end = (char *) memchr(user, '\0', n)) != NULL) {
+	    bcopy(user, into, end - user + 1);
+	    return TRUE;
+	}
+	bcopy(user, into, n);
+	from += n;
+	into += n;
+	size -= n;
+    }
+    *into = '\0';
+    return TRUE;
+}
+
+//----------------------------------------------------------------------
+// StartExec, StartFork
+// 	The first thing a new process's thread does: get the machine
+//	ready to run the process, and jump to it.  A process started by
+//	Exec starts from the beginning of its program; a forked one starts
+//	from the registers its parent's thread gave it.
+//
+//	A forked thread only takes on its address space here, just before
+//	it loads those registers into the machine: until then, if it were
+//	switched out, the scheduler would save the machine's registers --
+//	some other program's -- over them.
+//
+//	"id" -- the forked process
+//----------------------------------------------------------------------
+
+static void
+StartExec(int dummy)
+{
+    currentThread->space->InitRegisters();
+    currentThread->space->RestoreState();
+    machine->Run();
+    ASSERT(FALSE);			// machine->Run never returns
+}
+
+static void
+StartFork(int id)
+{
+    currentThread->space = processTable->Space(id);
+    currentThread->RestoreUserState();
+    currentThread->space->RestoreState();
+    machine->Run();
+    ASSERT(FALSE);
+}
+
+//----------------------------------------------------------------------
+// ExecProcess
+// 	Start a process running the program in the file "name", with a
+//	thread of its own, and return its SpaceId; or -1 if there is no
+//	such file.
+//
+//	"nameAddr" -- the user virtual address of the file name
+//----------------------------------------------------------------------
+
+static SpaceId
+ExecProcess(int nameAddr)
+{
+    char name[MaxStringLength];
+    OpenFile *executable;
+    NoffHeader noffH;
+    AddrSpace *space;
+    Thread *thread;
+    SpaceId id;
+
+    if (!ReadString(nameAddr, name, MaxStringLength))
+	return -1;
+    executable = fileSystem->Open(name);
+    if (executable == NULL) {
+	DEBUG('a', "Exec: unable to open file %s\n", name);
+	return -1;
+    }
+    if (!ReadHeader(executable, &noffH) || processTable->IsFull()) {
+	DEBUG('a', "Exec: %s isn't executable, or too many processes\n",
+			name);
+	delete executable;
+	return -1;
+    }
+    space = new AddrSpace(executable);
+    if (!space->loaded) {
+	DEBUG('a', "Exec: not enough memory for %s\n", name);
+	delete space;
+	delete executable;
+	return -1;
+    }
+    if ((id = processTable->Add(space)) == -1) {
+	delete space;			// the table filled up while we
+	return -1;			// loaded the program
+    }
+    thread = new Thread("exec");
+    thread->space = space;
+    thread->Fork(StartExec, 0);
+    return id;
+}
+
+//----------------------------------------------------------------------
+// ForkProcess
+// 	Start a process that is a copy of this one, sharing its pages
+//	copy-on-write, and return its SpaceId.  The copy has a thread of
+//	its own, which starts out with this thread's registers, except
+//	that it jumps to the procedure "func" -- as if "func" had been
+//	called instead of Fork, so that when "func" returns, the copy
+//	returns from Fork.  Returns -1 if there isn't enough memory for
+//	the copy, or there are too many processes already.
+//
+//	"func" -- the user virtual address of the procedure to call
+//----------------------------------------------------------------------
+
+static SpaceId
+ForkProcess(int func)
+{
+    AddrSpace *space;
+    Thread *thread;
+    int pc = machine->ReadRegister(PCReg);
+    SpaceId id;
+
+    if (processTable->IsFull())
+	return -1;
+    space = new AddrSpace(currentThread->space);
+    if (!space->loaded || ((id = processTable->Add(space)) == -1)) {
+	delete space;
+	return -1;
+    }
+    thread = new Thread("fork");
+
+    machine->WriteRegister(PCReg, func);
+    machine->WriteRegister(NextPCReg, func + 4);
+    thread->SaveUserState();		// the copy's registers
+    machine->WriteRegister(PCReg, pc);
+    machine->WriteRegister(NextPCReg, pc + 4);
+    thread->Fork(StartFork, id);
+    return id;
+}
+
+//----------------------------------------------------------------------
+// ExitProcess
+// 	The current process is done.  Let anyone waiting for it know its
+//	exit status, throw away its address space, and finish its thread.
+//	When the last process exits, so does Nachos.
+//
+//	"status" -- the exit status
+//----------------------------------------------------------------------
+
+static void
+ExitProcess(int status)
+{
+    AddrSpace *space = currentThread->space;
+
+    DEBUG('a', "Process exiting, status %d\n", status);
+    if (space->aio != NULL)
+	space->aio->Drain();		// finish writing its output first
+    currentThread->space = NULL;	// no user registers to save from
+					// now on, even if we halt, and wait
+					// for the disk while cleaning up
+    if (processTable->Exit(space, status))
+	interrupt->Halt();		// that was the last one
+    delete space;
+    currentThread->Finish();
+}
+
+//----------------------------------------------------------------------
+// UserConsole
+// 	Return the console that user programs read and write, starting it
+//	up the first time it is needed.  (Until then, there is no point
+//	in polling the keyboard.)
+//----------------------------------------------------------------------
+
+static SynchConsole *
+UserConsole()
+{
+    if (synchConsole == NULL)
+	synchConsole = new SynchConsole(NULL, NULL);
+    return synchConsole;
+}
+
+//----------------------------------------------------------------------
+// CreateUserFile
+// 	Create an empty file called "name"; return 0, or -1 if it couldn't
+//	be created.
+//
+//	"nameAddr" -- the user virtual address of the file name
+//----------------------------------------------------------------------
+
+static int
+CreateUserFile(int nameAddr)
+{
+    char name[MaxStringLength];
+
+    if (!ReadString(nameAddr, name, MaxStringLength) ||
+	    !fileSystem->Create(name, 0))
+	return -1;
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// OpenUserFile
+// 	Open the file called "name" for the current process, and return
+//	the id it is to use for it; or -1 if there is no such file, or
+//	the process has too many files open.
+//
+//	"nameAddr" -- the user virtual address of the file name
+//----------------------------------------------------------------------
+
+static OpenFileId
+OpenUserFile(int nameAddr)
+{
+    char name[MaxStringLength];
+    OpenFile *file;
+    OpenFileId id;
+
+    if (!ReadString(nameAddr, name, MaxStringLength))
+	return -1;
+    if ((file = fileSystem->Open(name)) == NULL) {
+	DEBUG('a', "Open: unable to open file %s\n", name);
+	return -1;
+    }
+    if ((id = currentThread->space->openFiles->Add(file)) == -1)
+	delete file;			// too many open
+    return id;
+}
+
+//----------------------------------------------------------------------
+// TransferUserFile
+// 	Read data from an open file (or the console) into the user
+//	program's buffer, or write data from the buffer to the file, in
+//	place (see AddrSpace::Transfer).  The console goes through a
+//	page-sized kernel buffer instead: it may wait for as long as it
+//	takes someone to type a line, or for other processes using it, and
+//	a frame pinned all that time would be lost to paging.
+//
+//	Returns the # of bytes read or written, which is less than "size"
+//	at the end of the file (or of a line of console input), or if the
+//	rest of the buffer isn't in the program's address space; -1 if
+//	the file isn't open for it, or none of the buffer is.
+//
+//	"bufferAddr" -- the user virtual address of the buffer
+//	"size" -- the # of bytes to read or write
+//	"id" -- the open file
+//	"reading" -- read from the file, rather than write to it?
+//----------------------------------------------------------------------
+
+static int
+TransferUserFile(int bufferAddr, int size, OpenFileId id, bool reading)
+{
+    AddrSpace *space = currentThread->space;
+    OpenFile *file = space->openFiles->Get(id);
+    int done = 0, n, result;
+    char buffer[PageSize];		// each page's span of the buffer,
+					// on its way to or from the console
+
+    if (((file == NULL) && (id != (reading ? ConsoleInput : ConsoleOutput)))
+	    || (size < 0))
+	return -1;
+    if (file != NULL)
+	return space->Transfer(file, bufferAddr, size, -1, reading);
+    while (done < size) {
+	if (space->Locate(bufferAddr + done, reading, &n) == NULL)
+	    return (done > 0) ? done : -1;
+	n = min(n, size - done);
+	if (reading) {
+	    result = UserConsole()->Read(buffer, n);
+	    space->CopyOut(bufferAddr + done, buffer, result);
+	} else {
+	    space->CopyIn(bufferAddr + done, buffer, n);
+	    UserConsole()->Write(buffer, n);
+	    result = n;
+	}
+	done += result;
+	if ((result < n) || (reading && (buffer[n - 1] == '\n')))
+	    break;			// nothing more for now
+    }
+    return done;
+}
+
+//----------------------------------------------------------------------
+// TransferUserVector
+// 	Read data from an open file (or the console) into a list of the 
+//	user program's buffers, or write data from them to the file, as 
+//	if by one TransferUserFile after another -- stopping after a
+//	short one.  The list is an array of IoVecs in the program's
+//	memory.
+//
+//	Returns the total # of bytes read or written; -1 if the file
+//	isn't open, or the list (or its first buffer) isn't in the
+//	program's address space.
+//
+//	"vectorAddr" -- the user virtual address of the list
+//	"count" -- the # of buffers in it
+//	"id" -- the open file
+//	"reading" -- read from the file, rather than write to it?
+//----------------------------------------------------------------------
+
+static int
+TransferUserVector(int vectorAddr, int count, OpenFileId id, bool reading)
+{
+    unsigned int vector[2 * MaxIoVecs];	// each buffer's address and size,
+					// as the program's 32-bit words
+    int done = 0, size, result;
+
+    if ((count < 0) || (count > MaxIoVecs) || 
+	    !currentThread->space->CopyIn(vectorAddr, (char *) vector,
+					2 * count * sizeof(int)))
+	return -1;
+    for (int i = 0; i < count; i++) {
+	size = WordToHost(vector[2 * i + 1]);
+	result = TransferUserFile(WordToHost(vector[2 * i]), size, id, 
+				reading);
+	if (result == -1)
+	    return (i > 0) ? done : -1;
+	done += result;
+	if (result < size)
+	    break;
+    }
+    return done;
+}
+
+//----------------------------------------------------------------------
+// CloseUserFile
+// 	Close one of the current process's open files; return 0, or -1 if
+//	it has no file open with that id.
+//
+//	"id" -- the open file
+//----------------------------------------------------------------------
+
+static int
+CloseUserFile(OpenFileId id)
+{
+    AddrSpace *space = currentThread->space;
+
+    if (space->aio != NULL)
+	space->aio->Drain();		// the file may still be in use
+    return space->openFiles->Remove(id) ? 0 : -1;
+}
+
+//----------------------------------------------------------------------
+// SetupUserAio
+// 	Start asynchronous I/O for the current process, with the ring it
+//	shares with the kernel at "ringAddr"; return 0, or -1 if the ring 
+//	isn't all in its address space, or it already has one.
+//
+//	"ringAddr" -- the user virtual address of the AioRing
+//----------------------------------------------------------------------
+
+static int
+SetupUserAio(int ringAddr)
+{
+    AddrSpace *space = currentThread->space;
+    int n;
+
+    if ((space->aio != NULL) || (ringAddr < 0) ||
+	    (space->Locate(ringAddr, TRUE, &n) == NULL) ||
+	    (space->Locate(ringAddr + AioRingBytes - 1, TRUE, &n) == NULL))
+	return -1;
+    space->aio = new AsyncIO(space, ringAddr);
+    return 0;
+}
+
+//----------------------------------------------------------------------
+// Batchable
+// 	Return TRUE if the system call "type" can be made from a
+//	MultiCall: it is one we know (they are numbered from 0), and it
+//	doesn't need the registers of the trap that made it.
+//----------------------------------------------------------------------
+
+static bool
+Batchable(int type)
+{
+    switch (type) {
+      case SC_Halt:
+      case SC_Exit:
+      case SC_Fork:			// starts from the trap's registers
+      case SC_MultiCall:
+	return FALSE;
+      default:
+	return (type >= 0) && (type < SC_MultiCall);
+    }
+}
+
+//----------------------------------------------------------------------
+// SystemCall
+// 	Make one of the system calls that just take arguments and return
+//	a result, whether from its own trap or from a MultiCall; return
+//	what it is to return (0, if it returns nothing).
+//
+//	"type" -- which system call
+//	"arg1", "arg2", "arg3" -- its arguments
+//----------------------------------------------------------------------
+
+static int
+SystemCall(int type, int arg1, int arg2, int arg3)
+{
+    AddrSpace *space = currentThread->space;
+
+    switch (type) {
+      case SC_Exec:
+	return ExecProcess(arg1);
+      case SC_Join:
+	return processTable->Join(arg1);
+      case SC_Yield:
+	currentThread->Yield();
+	return 0;
+      case SC_Create:
+	return CreateUserFile(arg1);
+      case SC_Open:
+	return OpenUserFile(arg1);
+      case SC_Read:
+	return TransferUserFile(arg1, arg2, arg3, TRUE);
+      case SC_Write:
+	return TransferUserFile(arg1, arg2, arg3, FALSE);
+      case SC_Close:
+	return CloseUserFile(arg1);
+      case SC_ReadV:
+	return TransferUserVector(arg1, arg2, arg3, TRUE);
+      case SC_WriteV:
+	return TransferUserVector(arg1, arg2, arg3, FALSE);
+      case SC_AioSetup:
+	return SetupUserAio(arg1);
+      case SC_AioSubmit:
+	return (space->aio != NULL) ? space->aio->Submit() : -1;
+      case SC_AioWait:
+	return (space->aio != NULL) ? space->aio->Wait(arg1) : -1;
+      default:
+	printf("Unexpected system call %d\n", type);
+	ASSERT(FALSE);
+	return -1;
+    }
+}
+
+//----------------------------------------------------------------------
+// MultiCall
+// 	Make a batch of system calls, described by an array of SysCalls
+//	in the user program's memory, in order; put each one's result in
+//	its SysCall.  One that can't be batched gets -1.
+//
+//	Each result is written back as soon as its call is made, and only
+//	the result, in case an earlier call read into the array.
+//
+//	Returns the # of calls made, or -1 if there are too many of them,
+//	or the array isn't in the program's address space (or, once the
+//	first call is made, can't be written).
+//
+//	"callsAddr" -- the user virtual address of the array
+//	"count" -- the # of SysCalls in it
+//----------------------------------------------------------------------
+
+#define SysCallWords	5		// code, 3 arguments, result
+
+static int
+MultiCall(int callsAddr, int count)
+{
+    unsigned int calls[SysCallWords * MaxMultiCalls];
+    unsigned int *call, result;
+
+    if ((count < 0) || (count > MaxMultiCalls) ||
+	    !currentThread->space->CopyIn(callsAddr, (char *) calls,
+					SysCallWords * count * sizeof(int)))
+	return -1;
+    for (int i = 0; i < count; i++) {
+	call = &calls[SysCallWords * i];
+	if (Batchable(WordToHost(call[0])))
+	    result = SystemCall(WordToHost(call[0]), WordToHost(call[1]), 
+				WordToHost(call[2]), WordToHost(call[3]));
+	else
+	    result = (unsigned int) -1;
+	result = WordToMachine(result);
+	if (!currentThread->space->CopyOut(
+		callsAddr + (SysCallWords * i + 4) * sizeof(int),
+		(char *) &result, sizeof(int)))
+	    return -1;			// the array is read-only
+    }
+    stats->numBatchedCalls += count;
+    return count;
+}
 
 //----------------------------------------------------------------------
 // ExceptionHandler
@@ -46,16 +576,57 @@
 //
 //	"which" is the kind of exception.  The list of possible exceptions 
 //	are in machine.h.
+//
+// A page fault (or TLB miss) is different: we load the missing page (or
+// translation), and return
+// *without* incrementing the pc, so that the instruction that faulted
+// is tried again.  So is a write to a copy-on-write page, once we have
+// made a copy of the page that can be written.
 //----------------------------------------------------------------------
 
 void
 ExceptionHandler(ExceptionType which)
 {
     int type = machine->ReadRegister(2);
+    int arg1 = machine->ReadRegister(4);
+    int arg2 = machine->ReadRegister(5);
+    int arg3 = machine->ReadRegister(6);
 
-    if ((which == SyscallException) && (type == SC_Halt)) {
-	DEBUG('a', "Shutdown, initiated by user program.\n");
-   	interrupt->Halt();
+    if (which == SyscallException) {
+	stats->numSystemCalls++;
+	switch (type) {
+	  case SC_Halt:
+	    DEBUG('a', "Shutdown, initiated by user program.\n");
+	    interrupt->Halt();
+	    break;
+	  case SC_Exit:
+	    ExitProcess(arg1);
+	    break;
+	  case SC_Fork:
+	    machine->WriteRegister(2, ForkProcess(arg1));
+	    break;
+	  case SC_MultiCall:
+	    machine->WriteRegister(2, MultiCall(arg1, arg2));
+	    break;
+	  default:
+	    machine->WriteRegister(2, SystemCall(type, arg1, arg2, arg3));
+	}
+	AdvancePC();
+    } else if ((which == ReadOnlyException) &&
+		currentThread->space->CopyOnWrite(
+		(unsigned) machine->ReadRegister(BadVAddrReg) / PageSize)) {
+	;				// we made a copy to write to, so
+					// try the write again
+#ifdef USE_TLB
+    } else if (which == PageFaultException) {	// really a TLB miss
+	stats->numTlbMisses++;
+	currentThread->space->TlbMiss(
+		(unsigned) machine->ReadRegister(BadVAddrReg) / PageSize);
+#else
+    } else if (which == PageFaultException) {
+	currentThread->space->PageIn(
+			machine->ReadRegister(BadVAddrReg) / PageSize);
+#endif
     } else {
 	printf("Unexpected user mode exception %d %d\n", which, type);
 	ASSERT(FALSE);
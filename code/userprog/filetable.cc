@@ -0,0 +1,93 @@
+// filetable.cc
+//	Routines to keep track of the files a user program has open.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "filetable.h"
+#include "syscall.h"
+
+//----------------------------------------------------------------------
+// OpenFileTable::OpenFileTable
+// 	Initialize an open file table.  Only the console is open, and it
+//	doesn't need an entry.
+//----------------------------------------------------------------------
+
+OpenFileTable::OpenFileTable()
+{
+    for (int i = 0; i < MaxOpenFiles; i++)
+	files[i] = NULL;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::~OpenFileTable
+// 	Close any files the program left open.
+//----------------------------------------------------------------------
+
+OpenFileTable::~OpenFileTable()
+{
+    for (int i = 0; i < MaxOpenFiles; i++)
+	if (files[i] != NULL)
+	    delete files[i];
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Add
+// 	Put a file that has just been opened in the table, and return
+//	the id it is to be known by: the smallest one that isn't in use.
+//	Returns -1 if there are no ids left; the caller should then close
+//	the file.
+//
+//	"file" -- the open file
+//----------------------------------------------------------------------
+
+int
+OpenFileTable::Add(OpenFile *file)
+{
+    for (int id = ConsoleOutput + 1; id < MaxOpenFiles; id++)
+	if (files[id] == NULL) {
+	    files[id] = file;
+	    return id;
+	}
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Get
+// 	Return the open file known by an id, or NULL if the id is out of
+//	range, or no file is open with it.  The console isn't a file, so
+//	its ids give NULL too.
+//
+//	"id" -- the id the user program gave
+//----------------------------------------------------------------------
+
+OpenFile *
+OpenFileTable::Get(int id)
+{
+    if ((id < 0) || (id >= MaxOpenFiles))
+	return NULL;
+    return files[id];
+}
+
+//----------------------------------------------------------------------
+// OpenFileTable::Remove
+// 	Close the file known by an id, so that the id can be used again.
+//	Returns FALSE if there is no such file.
+//
+//	"id" -- the id the user program gave
+//----------------------------------------------------------------------
+
+bool
+OpenFileTable::Remove(int id)
+{
+    OpenFile *file = Get(id);
+
+    if (file == NULL)
+	return FALSE;
+    delete file;
+    files[id] = NULL;
+    return TRUE;
+}
@@ -0,0 +1,45 @@
+// filetable.h
+//	Data structures to keep track of the files a user program has
+//	open.
+//
+//	A user program names an open file by its OpenFileId, which is
+//	its slot in the program's open file table.  The first two ids
+//	are the console (see syscall.h), which is always open, and never
+//	in the table.
+//
+//	A process started by Exec or Fork starts out with only the
+//	console open.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef FILETABLE_H
+#define FILETABLE_H
+
+#include "copyright.h"
+#include "openfile.h"
+
+#define MaxOpenFiles	16	// # of files a program can have open,
+				// counting the console
+
+// The following class defines a user program's open file table.
+
+class OpenFileTable {
+  public:
+    OpenFileTable();			// Initialize the table, with no files
+					// open but the console
+    ~OpenFileTable();			// Close whatever files are still open
+
+    int Add(OpenFile *file);		// Give "file" an id, and return it;
+					// -1 if the table is full
+    OpenFile *Get(int id);		// The file with id "id", or NULL if
+					// there isn't one
+    bool Remove(int id);		// Close the file with id "id"; FALSE
+					// if there isn't one
+
+  private:
+    OpenFile *files[MaxOpenFiles];	// the file with each id, or NULL
+};
+
+#endif // FILETABLE_H
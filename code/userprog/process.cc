@@ -0,0 +1,198 @@
+// process.cc
+//	Routines to keep track of the running user programs.
+//
+//	A slot is given back once its process has exited and either its
+//	status has been collected, or its parent has exited too.  Exiting
+//	also gives back the slots of the process's children that have
+//	already exited and not been joined.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "process.h"
+
+//----------------------------------------------------------------------
+// ProcessTable::ProcessTable
+// 	Initialize the process table; every slot starts out unused.
+//----------------------------------------------------------------------
+
+ProcessTable::ProcessTable()
+{
+    lock = new Lock("process table");
+    exited = new Condition("process exited");
+    for (int i = 0; i < MaxProcesses; i++)
+	state[i] = SLOT_FREE;
+    numRunning = 0;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::~ProcessTable
+// 	De-allocate the process table.
+//----------------------------------------------------------------------
+
+ProcessTable::~ProcessTable()
+{
+    delete lock;
+    delete exited;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Add
+// 	Record that a process is starting, and return its SpaceId; or -1
+//	if there are MaxProcesses processes already.  Its parent is the
+//	process running in the current thread, if any.
+//
+//	"space" -- the address space the process runs in
+//----------------------------------------------------------------------
+
+SpaceId
+ProcessTable::Add(AddrSpace *space)
+{
+    SpaceId id;
+
+    lock->Acquire();
+    for (id = 0; id < MaxProcesses; id++)
+	if (state[id] == SLOT_FREE)
+	    break;
+    if (id == MaxProcesses) {		// out of processes
+	lock->Release();
+	return -1;
+    }
+    state[id] = PROCESS_RUNNING;
+    spaces[id] = space;
+    parent[id] = (currentThread->space == NULL) ? -1
+					: Find(currentThread->space);
+    numRunning++;
+    lock->Release();
+    DEBUG('a', "Starting process %d, parent %d\n", id, parent[id]);
+    return id;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::IsFull
+// 	Return TRUE if there is no slot for another process -- so that
+//	there's no point in loading one.
+//----------------------------------------------------------------------
+
+bool
+ProcessTable::IsFull()
+{
+    bool full = TRUE;
+
+    lock->Acquire();
+    for (int id = 0; id < MaxProcesses; id++)
+	if (state[id] == SLOT_FREE)
+	    full = FALSE;
+    lock->Release();
+    return full;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Exit
+// 	Record that a process has finished, and wake up anyone waiting
+//	for it.  Returns TRUE if no processes are left running.
+//
+//	"space" -- the address space the process ran in
+//	"status" -- its exit status
+//----------------------------------------------------------------------
+
+bool
+ProcessTable::Exit(AddrSpace *space, int status)
+{
+    SpaceId id;
+    bool last;
+
+    lock->Acquire();
+    id = Find(space);
+    DEBUG('a', "Process %d exiting, status %d\n", id, status);
+    for (int i = 0; i < MaxProcesses; i++)
+	if ((state[i] != SLOT_FREE) && (parent[i] == id)) {
+	    if (state[i] == PROCESS_EXITED)
+		state[i] = SLOT_FREE;	// no one will join it now
+	    else
+		parent[i] = -1;
+	}
+    if (parent[id] == -1)
+	state[id] = SLOT_FREE;
+    else
+	state[id] = PROCESS_EXITED;
+    spaces[id] = NULL;
+    exitStatus[id] = status;
+    last = (--numRunning == 0);
+    exited->Broadcast(lock);
+    lock->Release();
+    return last;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Join
+// 	Wait for a process to exit, and return its exit status.  Its
+//	slot can then be used again.  Only the process that started it
+//	can wait for it; for any other process -- including the caller
+//	itself, which would wait forever -- return -1 at once.
+//
+//	"id" -- the process to wait for
+//----------------------------------------------------------------------
+
+int
+ProcessTable::Join(SpaceId id)
+{
+    int status;
+
+    if ((id < 0) || (id >= MaxProcesses))
+	return -1;
+    lock->Acquire();
+    if ((state[id] == SLOT_FREE) || (currentThread->space == NULL) ||
+		(parent[id] != Find(currentThread->space))) {
+	lock->Release();
+	return -1;			// not our child
+    }
+    while (state[id] == PROCESS_RUNNING)
+	exited->Wait(lock);
+    if (state[id] == PROCESS_EXITED) {
+	status = exitStatus[id];
+	state[id] = SLOT_FREE;
+    } else
+	status = -1;			// no such process
+    lock->Release();
+    return status;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Space
+// 	Return the address space of a process that is running.
+//
+//	"id" -- the process
+//----------------------------------------------------------------------
+
+AddrSpace *
+ProcessTable::Space(SpaceId id)
+{
+    AddrSpace *space;
+
+    lock->Acquire();
+    ASSERT((id >= 0) && (id < MaxProcesses) && 
+		(state[id] == PROCESS_RUNNING));
+    space = spaces[id];
+    lock->Release();
+    return space;
+}
+
+//----------------------------------------------------------------------
+// ProcessTable::Find
+// 	Return the SpaceId of the running process with address space
+//	"space".  The caller must hold the lock.
+//----------------------------------------------------------------------
+
+SpaceId
+ProcessTable::Find(AddrSpace *space)
+{
+    for (SpaceId id = 0; id < MaxProcesses; id++)
+	if ((state[id] == PROCESS_RUNNING) && (spaces[id] == space))
+	    return id;
+    ASSERT(FALSE);
+    return -1;
+}
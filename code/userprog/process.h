@@ -0,0 +1,64 @@
+// process.h
+//	Data structures to keep track of the user programs (processes)
+//	that are running, so that one can wait for another to finish.
+//
+//	Each process has an address space of its own, and runs in one
+//	thread; its SpaceId is its slot in the process table.  When a
+//	process exits, its slot keeps its exit status until the status
+//	is collected by Join -- or until the process that started it
+//	exits, after which there is no one left to care.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include "copyright.h"
+#include "synch.h"
+#include "addrspace.h"
+#include "syscall.h"
+
+#define MaxProcesses	64	// # of processes that can exist at once
+
+// The states a slot of the process table can be in.
+
+enum ProcessState { SLOT_FREE, PROCESS_RUNNING, PROCESS_EXITED };
+
+// The following class defines the process table.
+
+class ProcessTable {
+  public:
+    ProcessTable();			// Initialize the table, empty
+    ~ProcessTable();			// De-allocate the table
+
+    SpaceId Add(AddrSpace *space);	// A process is starting, in "space";
+					// the current process started it
+					// (-1 if the table is full)
+    bool IsFull();			// Is there no room for another?
+    bool Exit(AddrSpace *space, int status);
+					// The process running in "space" is
+					// done; return TRUE if it was the
+					// last one
+    int Join(SpaceId id);		// Wait for process "id" to finish,
+					// and return its exit status (-1 if
+					// it isn't the current process's
+					// child)
+    AddrSpace *Space(SpaceId id);	// The address space of running
+					// process "id"
+
+  private:
+    SpaceId Find(AddrSpace *space);	// Which process runs in "space"
+
+    Lock *lock;				// synchronizes access to the table
+    Condition *exited;			// signalled when a process exits
+    ProcessState state[MaxProcesses];
+    AddrSpace *spaces[MaxProcesses];	// address space of each process
+    SpaceId parent[MaxProcesses];	// the process that started each one,
+					// or -1 if it has exited
+    int exitStatus[MaxProcesses];
+    int numRunning;			// # of processes not yet exited
+};
+
+#endif // PROCESS_H
@@ -24,17 +24,28 @@ void
 StartProcess(char *filename)
 {
     OpenFile *executable = fileSystem->Open(filename);
+    NoffHeader noffH;
     AddrSpace *space;
 
     if (executable == NULL) {
 	printf("Unable to open file %s\n", filename);
 	return;
     }
+    if (!ReadHeader(executable, &noffH)) {
+	printf("%s is not a Nachos executable\n", filename);
+	delete executable;
+	return;
+    }
     space = new AddrSpace(executable);    
+    if (!space->loaded) {
+	printf("Not enough memory for %s\n", filename);
+	delete space;
+	delete executable;
+	return;
+    }
+    processTable->Add(space);
     currentThread->space = space;
 
-    delete executable;			// close file
-
     space->InitRegisters();		// set the initial register values
     space->RestoreState();		// load page table register
 
@@ -44,6 +55,91 @@ StartProcess(char *filename)
 					// by doing the syscall "exit"
 }
 
+//----------------------------------------------------------------------
+// RunBatch
+// 	Run each of the user programs named by a "-x" on the command
+//	line in a Nachos of its own, "hostJobs" of them at a time, in
+//	separate host processes -- so that a large batch of independent
+//	test programs can use all of the host's processors.
+//
+//	Each copy of Nachos is forked from this one once it has been
+//	initialized, so a program runs just as it would with "nachos -x".
+//	The copies share nothing, so a program can't see what the others
+//	do.  That is why there are no batches under FILESYS: the copies
+//	would all share the one DISK (and its file offset), each with its
+//	own idea of which sectors are free.
+//
+//	The output of each program is saved, and printed in order once
+//	the whole batch is done, followed by the statistics of all the
+//	programs that ran to completion, added together.
+//----------------------------------------------------------------------
+
+#define MaxBatch	256
+
+void
+RunBatch(int argc, char **argv)
+{
+    char *file[MaxBatch];		// the programs to run
+    int pid[MaxBatch];			// host process running each one
+    int output[MaxBatch];		// scratch file for its output
+    int results[MaxBatch];		// scratch file for its statistics
+    bool succeeded[MaxBatch];		// did it run to completion?
+    bool ok;
+    int numJobs = 0, next = 0, running = 0;
+    int i, n;
+    char buffer[512];
+    Statistics total, jobStats;
+
+    for (argc--, argv++; argc > 0; argc--, argv++)
+	if (!strcmp(*argv, "-x") && (argc > 1)) {
+	    ASSERT(numJobs < MaxBatch);
+	    file[numJobs++] = *(argv + 1);
+	}
+
+    fflush(stdout);			// or each copy will print it again
+    while ((next < numJobs) || (running > 0)) {
+	if ((next < numJobs) && (running < hostJobs)) {
+	    output[next] = OpenScratchFile();
+	    results[next] = OpenScratchFile();
+	    pid[next] = StartHostProcess();
+	    if (pid[next] == 0) {	// we're the copy; run the program
+		RedirectOutput(output[next]);
+		batchResults = results[next];
+		StartProcess(file[next]);
+		Exit(1);		// couldn't open the program
+	    }
+	    next++;
+	    running++;
+	} else {			// wait for one of them to finish
+	    n = WaitForHostProcess(&ok);
+	    for (i = 0; pid[i] != n; i++)
+		;
+	    succeeded[i] = ok;
+	    running--;
+	}
+    }
+
+    for (i = 0; i < numJobs; i++) {
+	printf("=== %s%s\n", file[i], succeeded[i] ? "" : " (failed)");
+	fflush(stdout);
+	Lseek(output[i], 0, 0);
+	while ((n = ReadPartial(output[i], buffer, sizeof(buffer))) > 0)
+	    WriteFile(1, buffer, n);
+	if (succeeded[i]) {
+	    Lseek(results[i], 0, 0);
+	    Read(results[i], (char *) &jobStats, sizeof(Statistics));
+	    total.Add(&jobStats);
+	}
+	Close(output[i]);
+	Close(results[i]);
+    }
+    printf("=== %d programs\n", numJobs);
+    total.numCpus = stats->numCpus;
+    total.numQueueLevels = stats->numQueueLevels;
+    total.Print();
+    Cleanup();
+}
+
 // Data structures needed for the console test.  Threads making
 // I/O requests wait on a Semaphore to delay until the I/O completes.
 
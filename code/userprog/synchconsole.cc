@@ -0,0 +1,138 @@
+// synchconsole.cc 
+//	Routines to synchronously access the console.  The console is an
+//	asynchronous device (characters are written, and arrive, with an
+//	interrupt later on); this is a layer on top of it providing a 
+//	synchronous interface (requests wait until the characters have 
+//	been read or written).
+//
+//	As with the synchronous disk, semaphores synchronize the interrupt
+//	handlers with the pending requests, and locks enforce mutual
+//	exclusion.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "synchconsole.h"
+
+//----------------------------------------------------------------------
+// ConsoleReadAvail, ConsoleWriteDone
+// 	Console interrupt handlers.  Need these to be C routines, because 
+//	C++ can't handle pointers to member functions.
+//----------------------------------------------------------------------
+
+static void
+ConsoleReadAvail(int arg)
+{
+    SynchConsole *console = (SynchConsole *) arg;
+
+    console->ReadAvail();
+}
+
+static void
+ConsoleWriteDone(int arg)
+{
+    SynchConsole *console = (SynchConsole *) arg;
+
+    console->WriteDone();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::SynchConsole
+// 	Initialize the synchronous interface to the console, in turn
+//	initializing the console device.
+//
+//	"readFile" -- UNIX file simulating the keyboard (NULL -> stdin)
+//	"writeFile" -- UNIX file simulating the display (NULL -> stdout)
+//----------------------------------------------------------------------
+
+SynchConsole::SynchConsole(char *readFile, char *writeFile)
+{
+    readAvail = new Semaphore("console read avail", 0);
+    writeDone = new Semaphore("console write done", 0);
+    readLock = new Lock("console read lock");
+    writeLock = new Lock("console write lock");
+    console = new Console(readFile, writeFile, ConsoleReadAvail,
+				ConsoleWriteDone, (int) this);
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::~SynchConsole
+// 	De-allocate data structures needed for the synchronous console
+//	abstraction.
+//----------------------------------------------------------------------
+
+SynchConsole::~SynchConsole()
+{
+    delete console;
+    delete writeLock;
+    delete readLock;
+    delete writeDone;
+    delete readAvail;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Read
+// 	Read characters typed at the console into a buffer: up to
+//	"numBytes" of them, or up to the end of a line, whichever comes
+//	first.  Wait for at least one to arrive; return how many were
+//	read.
+//
+//	"into" -- the buffer to put the characters in
+//	"numBytes" -- the most characters to read
+//----------------------------------------------------------------------
+
+int
+SynchConsole::Read(char *into, int numBytes)
+{
+    int i;
+
+    readLock->Acquire();		// only one reader at a time
+    for (i = 0; i < numBytes; ) {
+	readAvail->P();			// wait for a character
+	into[i] = console->GetChar();
+	if (into[i++] == '\n')
+	    break;
+    }
+    readLock->Release();
+    return i;
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::Write
+// 	Write characters to the console display, returning only after
+//	the last of them has been written.
+//
+//	"from" -- the characters to write
+//	"numBytes" -- how many there are
+//----------------------------------------------------------------------
+
+void
+SynchConsole::Write(char *from, int numBytes)
+{
+    writeLock->Acquire();		// only one writer at a time
+    for (int i = 0; i < numBytes; i++) {
+	console->PutChar(from[i]);
+	writeDone->P();			// wait for interrupt
+    }
+    writeLock->Release();
+}
+
+//----------------------------------------------------------------------
+// SynchConsole::ReadAvail, SynchConsole::WriteDone
+// 	Console interrupt handlers.  Wake up the thread waiting for a
+//	character to arrive, or to be written.
+//----------------------------------------------------------------------
+
+void
+SynchConsole::ReadAvail()
+{
+    readAvail->V();
+}
+
+void
+SynchConsole::WriteDone()
+{
+    writeDone->V();
+}
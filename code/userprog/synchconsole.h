@@ -0,0 +1,52 @@
+// synchconsole.h 
+// 	Data structures to export a synchronous interface to the console
+//	device, for user programs to read and write.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation 
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+
+#ifndef SYNCHCONSOLE_H
+#define SYNCHCONSOLE_H
+
+#include "console.h"
+#include "synch.h"
+
+// The following class defines a "synchronous" console.  Like the disk,
+// the raw console is asynchronous -- a character is written, or arrives,
+// and an interrupt happens later (see console.h).  A thread reading or
+// writing the synchronous console waits until all of its characters 
+// have been read or written, while other threads run.
+//
+// Only one thread at a time reads, and one writes, so that the
+// characters of one Read or Write aren't mixed up with another's.
+
+class SynchConsole {
+  public:
+    SynchConsole(char *readFile, char *writeFile);
+					// Initialize a synchronous console,
+					// by initializing the raw Console;
+					// NULL means stdin/stdout
+    ~SynchConsole();			// De-allocate the synch console data
+
+    int Read(char *into, int numBytes);	// Read up to "numBytes" characters,
+					// stopping after a newline; wait for
+					// at least one.  Return the # read.
+    void Write(char *from, int numBytes);
+					// Write "numBytes" characters
+
+    void ReadAvail();			// Called by the console interrupt
+    void WriteDone();			// handlers, when a character arrives
+					// or has been written
+
+  private:
+    Console *console;			// Raw console device
+    Semaphore *readAvail;		// To synchronize requesting threads
+    Semaphore *writeDone;		// with the interrupt handlers
+    Lock *readLock;			// Only one thread reading, and one
+    Lock *writeLock;			// writing, at a time
+};
+
+#endif // SYNCHCONSOLE_H
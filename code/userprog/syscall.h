@@ -29,6 +29,12 @@
 #define SC_Close	8
 #define SC_Fork		9
 #define SC_Yield	10
+#define SC_ReadV	11
+#define SC_WriteV	12
+#define SC_AioSetup	13
+#define SC_AioSubmit	14
+#define SC_AioWait	15
+#define SC_MultiCall	16
 
 #ifndef IN_ASM
 
@@ -55,12 +61,14 @@ void Exit(int status);
 typedef int SpaceId;	
  
 /* Run the executable, stored in the Nachos file "name", and return the 
- * address space identifier
+ * address space identifier; or -1 if "name" isn't a Nachos executable,
+ * or there is no room to run it.
  */
 SpaceId Exec(char *name);
  
 /* Only return once the the user program "id" has finished.  
- * Return the exit status.
+ * Return the exit status; or -1 at once if "id" isn't a child of this
+ * program.
  */
 int Join(SpaceId id); 	
  
@@ -108,16 +116,130 @@ int Read(char *buffer, int size, OpenFileId id);
 /* Close the file, we're done reading and writing to it. */
 void Close(OpenFileId id);
 
+/* Vectored I/O: ReadV and WriteV.  Like Read and Write, but the data 
+ * is scattered across (or gathered from) "count" buffers, each
+ * described by an IoVec, filled (or written) in order.  Return the
+ * total number of bytes read or written, which is less than the sum 
+ * of the sizes only if one of the buffers was read short; -1 if the
+ * file isn't open, or the first buffer is bad.
+ */
+typedef struct {
+    char *buffer;		/* where the data is */
+    int size;			/* how many bytes of it */
+} IoVec;
+
+#define MaxIoVecs	16	/* most buffers in one ReadV or WriteV */
+
+int ReadV(IoVec *vector, int count, OpenFileId id);
+int WriteV(IoVec *vector, int count, OpenFileId id);
+
+
+/* Asynchronous I/O: AioSetup, AioSubmit, AioWait.
+ *
+ * A program that wants to keep several reads and writes in progress
+ * at once, while it gets on with something else, shares a ring of
+ * requests with the kernel.  The program fills in a request at
+ * sq[sqTail % AioRingSize] and then increments sqTail, for as many
+ * requests as it likes (up to AioRingSize beyond sqHead), and calls
+ * AioSubmit to tell the kernel about them.  The kernel consumes them
+ * from sqHead, and hands each one to a kernel thread, which reads or
+ * writes the file at the given position, without moving the file's
+ * own position.  As each finishes, in whatever order, the kernel 
+ * puts its tag and its result (what Read or Write would return, or -1
+ * if the request is bad) in cq[cqTail % AioRingSize], and increments
+ * cqTail; the program consumes completions from cqHead, incrementing
+ * it.  The counters only ever increase.
+ *
+ * The kernel only writes sqHead and cqTail, and the program only 
+ * writes sqTail and cqHead.  The kernel accepts a request only if
+ * there will be room for its completion, so the program should keep
+ * consuming completions.
+ *
+ * The buffers must not be touched until their requests complete; a
+ * file must not be closed, nor the program exit, until its requests
+ * complete (if it does, the kernel waits for them first).
+ */
+#define AioRingSize	16	/* # of requests and completions */
+
+#define AioRead		0	/* opcodes */
+#define AioWrite	1
+
+typedef struct {
+    int opcode;			/* AioRead or AioWrite */
+    OpenFileId id;		/* the file */
+    char *buffer;		/* the data */
+    int size;			/* # of bytes to read or write */
+    int position;		/* where in the file */
+    int tag;			/* anything, to identify the completion */
+} AioRequest;
+
+typedef struct {
+    int tag;			/* the request's tag */
+    int result;			/* # of bytes read or written, or -1 */
+} AioCompletion;
+
+typedef struct {
+    unsigned int sqHead, sqTail;	/* requests */
+    unsigned int cqHead, cqTail;	/* completions */
+    AioRequest sq[AioRingSize];
+    AioCompletion cq[AioRingSize];
+} AioRing;
+
+/* Share "ring" with the kernel, which must be zeroed.  Return 0, or -1
+ * if it isn't in the address space, or the program already has one.
+ */
+int AioSetup(AioRing *ring);
+
+/* Start the requests between sqHead and sqTail; return how many were 
+ * taken (and sqHead moved past), which may be fewer if there's no room
+ * for their completions.
+ */
+int AioSubmit();
+
+/* Wait until at least "count" completions are ready to be consumed, or
+ * until nothing is in progress; return how many are ready.
+ */
+int AioWait(int count);
+
+
+/* Batched system calls: MultiCall.  Make "count" system calls with one
+ * trap into the kernel, rather than one trap each, for a program that
+ * makes a lot of small ones (several Writes to the console, say).
+ * Each is described by a SysCall: its code (SC_Write, ...) and its
+ * arguments, as they would be passed to the stub; the kernel makes 
+ * them in order, and puts each one's result in it, as the stub would 
+ * have returned it.  A call that fails doesn't stop the rest.
+ *
+ * Halt, Exit, Fork and MultiCall itself can't be batched; nor can a 
+ * code the kernel doesn't know.  Their result is -1.
+ *
+ * Return the number of calls made (all of them), or -1 if "calls"
+ * isn't in the address space (or is read-only), or "count" is more 
+ * than MaxMultiCalls.
+ */
+typedef struct {
+    int code;			/* the system call */
+    int arg1, arg2, arg3;	/* its arguments */
+    int result;			/* what it returned */
+} SysCall;
+
+#define MaxMultiCalls	16	/* most calls in one MultiCall */
+
+int MultiCall(SysCall *calls, int count);
 
 
 /* User-level thread operations: Fork and Yield.  To allow multiple
  * threads to run within a user program. 
  */
 
-/* Fork a thread to run a procedure ("func") in the *same* address space 
- * as the current thread.
+/* Fork a process to run a procedure ("func") in a *copy* of the address
+ * space of the current thread, and return its address space identifier.
+ * The copy shares the current one's memory until either of them writes
+ * to it (copy-on-write).  If "func" returns, the new process returns
+ * from Fork, with the value "func" returned.  Returns -1 if there
+ * isn't enough memory for the copy.
  */
-void Fork(void (*func)());
+SpaceId Fork(void (*func)());
 
 /* Yield the CPU to another runnable thread, whether in this address space 
  * or not. 
@@ -0,0 +1,120 @@
+// textcache.cc
+//	Routines to keep track of the code pages shared by the address
+//	spaces running the same executable.
+//
+//	An executable stays in the cache while any address space is
+//	running it.  The cache only records where the pages are; the
+//	frames themselves belong to the address spaces mapping them,
+//	and whichever of them frees a frame notes that the page is no
+//	longer in memory.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "textcache.h"
+
+//----------------------------------------------------------------------
+// TextCache::TextCache
+// 	Initialize the text cache; no executables are running yet.
+//----------------------------------------------------------------------
+
+TextCache::TextCache()
+{
+    texts = NULL;
+}
+
+//----------------------------------------------------------------------
+// TextCache::~TextCache
+// 	De-allocate the text cache, and whatever executables are still
+//	in it.
+//----------------------------------------------------------------------
+
+TextCache::~TextCache()
+{
+    SharedText *text;
+
+    while (texts != NULL) {
+	text = texts;
+	texts = text->next;
+	delete [] text->frames;
+	delete text;
+    }
+}
+
+//----------------------------------------------------------------------
+// TextCache::Attach
+// 	Find the shared code pages of an executable, for a new address
+//	space to run, adding the executable to the cache if no one else
+//	is running it.
+//
+//	Returns NULL if the code segment doesn't cover a whole page, so
+//	that there is nothing to share.
+//
+//	"executable" -- the file the code is loaded from
+//	"header" -- where the code is in it
+//----------------------------------------------------------------------
+
+SharedText *
+TextCache::Attach(OpenFile *executable, NoffHeader *header)
+{
+    int device = executable->Device();
+    int identity = executable->Identity();
+    int firstPage = divRoundUp(header->code.virtualAddr, PageSize);
+    int endPage = (header->code.virtualAddr + header->code.size) / PageSize;
+    SharedText *text;
+
+    if (endPage <= firstPage)
+	return NULL;
+    for (text = texts; text != NULL; text = text->next)
+	if ((text->device == device) && (text->identity == identity) &&
+		(text->inFileAddr == header->code.inFileAddr) &&
+		(text->firstPage == firstPage) && 
+		(text->numPages == endPage - firstPage)) {
+	    text->refs++;
+	    return text;
+	}
+
+    DEBUG('a', "Caching text of file %d, pages %d to %d\n", identity,
+		firstPage, endPage - 1);
+    text = new SharedText;
+    text->device = device;
+    text->identity = identity;
+    text->inFileAddr = header->code.inFileAddr;
+    text->firstPage = firstPage;
+    text->numPages = endPage - firstPage;
+    text->frames = new int[text->numPages];
+    for (int i = 0; i < text->numPages; i++)
+	text->frames[i] = -1;
+    text->refs = 1;
+    text->next = texts;
+    texts = text;
+    return text;
+}
+
+//----------------------------------------------------------------------
+// TextCache::Detach
+// 	An address space has finished running some code; if it was the
+//	last one running it, take the executable out of the cache.  By
+//	now, none of its pages are in memory.
+//
+//	"text" -- the code the address space was running
+//----------------------------------------------------------------------
+
+void
+TextCache::Detach(SharedText *text)
+{
+    SharedText **ptr;
+
+    if (--text->refs > 0)
+	return;
+    for (int i = 0; i < text->numPages; i++)
+	ASSERT(text->frames[i] == -1);
+    for (ptr = &texts; *ptr != text; ptr = &(*ptr)->next)
+	ASSERT(*ptr != NULL);
+    *ptr = text->next;
+    delete [] text->frames;
+    delete text;
+}
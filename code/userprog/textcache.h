@@ -0,0 +1,70 @@
+// textcache.h
+//	Data structures for sharing the code (text) of a program between
+//	all the address spaces running it.
+//
+//	Code is never modified, so there is no need for each address
+//	space to have a copy of its own.  The text cache keeps track of
+//	which frames hold the code pages of each executable that is
+//	running, keyed by the identity of the executable's file, and the
+//	page's place in its code segment.  Every address space keeps its
+//	executable open while it runs, so the file can't be removed, and
+//	its identity taken by another, while its code is in the cache.  Only the first address space
+//	to need a code page reads it from the file; the others map the
+//	same frame, read-only.
+//
+//	Only the pages that lie entirely within the code segment are
+//	shared; the pages at either end of the segment may also hold
+//	data, and so are loaded as usual.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TEXTCACHE_H
+#define TEXTCACHE_H
+
+#include "copyright.h"
+#include "openfile.h"		// NoffHeader comes from noff.h, which
+				// addrspace.h includes before us
+
+// The following class defines the shared code pages of one executable.
+
+class SharedText {
+  public:
+    int device;			// which device the executable is on
+    int identity;		// which file it is on the device
+    int inFileAddr;		// where its code is in the file
+    int firstPage;		// first virtual page that is shared
+    int numPages;		// # of pages that are shared
+    int *frames;		// the frame holding each of them, or -1
+				// if it isn't in memory
+    int refs;			// # of address spaces running the code
+    SharedText *next;		// next executable in the cache
+
+    bool Contains(int vpn)	// Is virtual page "vpn" shared?
+	{ return (vpn >= firstPage) && (vpn < firstPage + numPages); }
+    int *FrameOf(int vpn)	// Where the frame of page "vpn" is noted
+	{ return &frames[vpn - firstPage]; }
+};
+
+// The following class defines the text cache.
+
+class TextCache {
+  public:
+    TextCache();			// Initialize the cache, empty
+    ~TextCache();			// De-allocate the cache
+
+    SharedText *Attach(OpenFile *executable, NoffHeader *header);
+					// An address space is starting to
+					// run "executable"; return its
+					// shared code, or NULL if none of
+					// it can be shared
+    void Detach(SharedText *text);	// An address space is done with
+					// "text", and has let go of its
+					// frames
+
+  private:
+    SharedText *texts;			// the executables being run
+};
+
+#endif // TEXTCACHE_H
@@ -0,0 +1,392 @@
+// coremap.cc
+//	Routines to keep track of physical page frames, and to choose
+//	which page to replace when they are all in use.
+//
+//	Free frames come from the same frame map that address spaces
+//	use without virtual memory.  When there are none, a frame is
+//	taken from its page by having the page's address space page it
+//	out (writing it to swap if it is dirty); the caller then loads
+//	the new page into it.
+//
+//	A frame shared copy-on-write by several address spaces is given
+//	back only when the last of them has finished with it.  To take
+//	it away, the core map writes the page to swap itself, if need be,
+//	so that the page is written once rather than once for each.
+//
+//	Note that the machine caches translations, along with the use
+//	and dirty bits it has set (see translate.cc), so whenever we
+//	change a page table entry -- including clearing its use bit --
+//	we must flush the cached translations.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "coremap.h"
+#include "addrspace.h"
+
+//----------------------------------------------------------------------
+// CoreMap::CoreMap
+// 	Initialize the core map; every frame starts out free.
+//
+//	"which" -- the page replacement policy to use
+//----------------------------------------------------------------------
+
+CoreMap::CoreMap(ReplacementPolicy which)
+{
+    for (int i = 0; i < NumPhysPages; i++) {
+	frames[i].mappings = NULL;
+	frames[i].pins = 0;
+    }
+    policy = which;
+    hand = 0;
+    numLoads = 0;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::~CoreMap
+// 	De-allocate the core map.  Nothing to do!
+//----------------------------------------------------------------------
+
+CoreMap::~CoreMap()
+{}
+
+//----------------------------------------------------------------------
+// CoreMap::Allocate
+// 	Find a frame to hold a virtual page, and record that the page
+//	is in it.  Use a free frame if there is one; otherwise page out
+//	the page chosen by the replacement policy.
+//
+//	Returns the frame, pinned, so that no one else takes it while
+//	we may be waiting for the old page to be written out, or for the
+//	new one to be read in; the caller is responsible for loading the
+//	page into it, validating the page table entry, and unpinning it.
+//
+//	"space" -- the address space the page belongs to
+//	"vpn" -- the virtual page number
+//	"entry" -- its page table entry
+//----------------------------------------------------------------------
+
+int
+CoreMap::Allocate(AddrSpace *space, int vpn, TranslationEntry *entry)
+{
+    int frame = frameMap->Find();
+
+    if (frame == -1) {			// none free
+#ifdef USE_TLB
+	tlbManager->Sync();		// get the use bits up to date
+#endif
+	frame = ChooseVictim();
+	DEBUG('a', "Replacing page %d in frame %d\n",
+		frames[frame].mappings->virtualPage, frame);
+	frames[frame].pins++;
+	Evict(frame);
+    } else
+	frames[frame].pins++;
+    machine->FlushTranslations();	// the page table has changed
+
+    frames[frame].mappings = NULL;
+    Share(frame, space, vpn, entry);
+    frames[frame].loadedAt = numLoads++;
+    frames[frame].age = 0x80;		// it is about to be used
+    frames[frame].cacheEntry = NULL;
+    return frame;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Share
+// 	Record that a page of another address space is in a frame, which
+//	it shares copy-on-write with the address spaces already using it.
+//
+//	"frame" -- the frame, which must be in use
+//	"space", "vpn", "entry" -- the page, as for Allocate
+//----------------------------------------------------------------------
+
+void
+CoreMap::Share(int frame, AddrSpace *space, int vpn, TranslationEntry *entry)
+{
+    FrameMapping *mapping = new FrameMapping;
+
+    mapping->space = space;
+    mapping->virtualPage = vpn;
+    mapping->entry = entry;
+    mapping->next = frames[frame].mappings;
+    frames[frame].mappings = mapping;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Unmap
+// 	Record that an address space no longer uses the page in a frame
+//	(it has gone away, or has made a copy of its own).  If no other
+//	address space is using the page, the frame is free.
+//
+//	"frame" -- the frame
+//	"space" -- the address space that has finished with it
+//----------------------------------------------------------------------
+
+void
+CoreMap::Unmap(int frame, AddrSpace *space)
+{
+    FrameMapping **ptr = &frames[frame].mappings;
+    FrameMapping *mapping;
+
+    while (((mapping = *ptr) != NULL) && (mapping->space != space))
+	ptr = &mapping->next;
+    ASSERT(mapping != NULL);
+    *ptr = mapping->next;
+    delete mapping;
+    if (frames[frame].mappings == NULL) {
+	if (frames[frame].cacheEntry != NULL)
+	    *frames[frame].cacheEntry = -1;
+	frameMap->Clear(frame);
+    }
+}
+
+//----------------------------------------------------------------------
+// CoreMap::IsShared
+// 	Return TRUE if more than one address space is using the page in
+//	a frame.
+//
+//	"frame" -- the frame, which must be in use
+//----------------------------------------------------------------------
+
+bool
+CoreMap::IsShared(int frame)
+{
+    ASSERT(frames[frame].mappings != NULL);
+    return frames[frame].mappings->next != NULL;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Pin, CoreMap::Unpin
+// 	Keep the page in a frame in memory while the kernel is using it,
+//	for I/O to or from a user program's buffer -- even if the thread
+//	doing the I/O has to wait, and some other thread needs a frame
+//	in the meantime.  Pins nest.
+//
+//	"frame" -- the frame, which must be in use
+//----------------------------------------------------------------------
+
+void
+CoreMap::Pin(int frame)
+{
+    ASSERT(frames[frame].mappings != NULL);
+    frames[frame].pins++;
+}
+
+void
+CoreMap::Unpin(int frame)
+{
+    ASSERT(frames[frame].pins > 0);
+    frames[frame].pins--;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Cache
+// 	Record that the text cache knows the page in a frame is there,
+//	so that other address spaces running the same executable can
+//	share it.  When the page leaves the frame (because it is paged
+//	out, or the last address space using it has gone away), we tell
+//	the text cache, by setting its entry to -1.
+//
+//	"frame" -- the frame, which must be in use
+//	"entry" -- the text cache's entry for the page
+//----------------------------------------------------------------------
+
+void
+CoreMap::Cache(int frame, int *entry)
+{
+    ASSERT(frames[frame].mappings != NULL);
+    frames[frame].cacheEntry = entry;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Evict
+// 	Take the page out of a frame, so that the frame can be used for
+//	another page.  If only one address space is using the page, it
+//	pages the page out itself.  Otherwise, each of them lets go of
+//	it; and if the page has been modified since it was loaded, we 
+//	write it to a swap slot that they all share.
+//
+//	The page is gone from every page table before we wait for it to 
+//	be written, so no one can change it meanwhile.
+//
+//	"frame" -- the frame to empty
+//----------------------------------------------------------------------
+
+void
+CoreMap::Evict(int frame)
+{
+    FrameInfo *info = &frames[frame];
+    FrameMapping *mapping, *next;
+    int slot = -1;
+
+    if (!IsShared(frame))
+	info->mappings->space->PageOut(info->mappings->virtualPage);
+    else {
+	if (Dirty(info))
+	    slot = swapSpace->Allocate();
+	for (mapping = info->mappings; mapping != NULL; mapping = mapping->next)
+	    mapping->space->PageOutShared(mapping->virtualPage, slot);
+	machine->FlushTranslations();
+	if (slot != -1) {
+	    DEBUG('a', "Writing shared frame %d to swap slot %d\n",
+			frame, slot);
+	    swapSpace->WritePage(slot, &machine->mainMemory[frame * PageSize]);
+	    swapSpace->Free(slot);	// the address spaces have their
+	}				// own references to it now
+    }
+    for (mapping = info->mappings; mapping != NULL; mapping = next) {
+	next = mapping->next;
+	delete mapping;
+    }
+    info->mappings = NULL;
+    if (info->cacheEntry != NULL) {
+	*info->cacheEntry = -1;
+	info->cacheEntry = NULL;
+    }
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ChooseVictim
+// 	Choose a frame whose page is to be replaced, according to the
+//	replacement policy.  Only called when every frame is in use.
+//	Pinned frames are never chosen; at least one frame must not be
+//	pinned.
+//----------------------------------------------------------------------
+
+int
+CoreMap::ChooseVictim()
+{
+    switch (policy) {
+      case FifoReplacement:
+	return FifoVictim();
+      case ClockReplacement:
+	return ClockVictim();
+      case LruReplacement:
+	return LruVictim();
+    }
+    ASSERT(FALSE);
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::FifoVictim
+// 	Choose the page that was loaded the longest time ago.
+//----------------------------------------------------------------------
+
+int
+CoreMap::FifoVictim()
+{
+    int victim = -1;
+
+    for (int i = 0; i < NumPhysPages; i++)
+	if ((frames[i].pins == 0) && ((victim == -1) ||
+		(frames[i].loadedAt < frames[victim].loadedAt)))
+	    victim = i;
+    ASSERT(victim != -1);		// every frame is pinned
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ClockVictim
+// 	Sweep the clock hand around the frames, clearing use bits, until
+//	it comes to a page that hasn't been used since the last time
+//	around.  At worst, this is the first unpinned page we passed, on
+//	the second time around; if there is none, every frame is pinned.
+//----------------------------------------------------------------------
+
+int
+CoreMap::ClockVictim()
+{
+    FrameInfo *frame;
+
+    for (int i = 0; i < 2 * NumPhysPages; i++) {
+	frame = &frames[hand];
+	hand = (hand + 1) % NumPhysPages;
+	if (frame->pins > 0)
+	    continue;
+	if (!Used(frame))
+	    return frame - frames;
+	ClearUse(frame);		// second chance
+    }
+    ASSERT(FALSE);			// every frame is pinned
+    return -1;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::LruVictim
+// 	Age every page, by shifting its use bit into the top of its age
+//	and clearing the use bit, and choose the page with the smallest
+//	age: the one least recently used, as far as we can tell.  Among
+//	pages of the same age, choose a clean one if we can, since it
+//	needn't be written to swap, and then the oldest.
+//----------------------------------------------------------------------
+
+int
+CoreMap::LruVictim()
+{
+    FrameInfo *frame, *victim = NULL;
+
+    for (frame = frames; frame < frames + NumPhysPages; frame++) {
+	frame->age = (frame->age >> 1) | (Used(frame) ? 0x80 : 0);
+	ClearUse(frame);
+	if (frame->pins > 0)
+	    continue;
+	if ((victim == NULL) || (frame->age < victim->age))
+	    victim = frame;
+	else if (frame->age == victim->age) {
+	    if (Dirty(frame) != Dirty(victim)) {
+		if (!Dirty(frame))
+		    victim = frame;
+	    } else if (frame->loadedAt < victim->loadedAt)
+		victim = frame;
+	}
+    }
+    ASSERT(victim != NULL);		// every frame is pinned
+    return victim - frames;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::Used, CoreMap::Dirty
+// 	Return TRUE if any of the address spaces using the page in a frame
+//	has used it (or modified it) since its use bit was last cleared
+//	(or since it was loaded).
+//
+//	"frame" -- the frame, which must be in use
+//----------------------------------------------------------------------
+
+bool
+CoreMap::Used(FrameInfo *frame)
+{
+    for (FrameMapping *m = frame->mappings; m != NULL; m = m->next)
+	if (m->entry->use)
+	    return TRUE;
+    return FALSE;
+}
+
+bool
+CoreMap::Dirty(FrameInfo *frame)
+{
+    for (FrameMapping *m = frame->mappings; m != NULL; m = m->next)
+	if (m->entry->dirty)
+	    return TRUE;
+    return FALSE;
+}
+
+//----------------------------------------------------------------------
+// CoreMap::ClearUse
+// 	Clear the use bits of all the address spaces using the page in
+//	a frame.  The caller must flush the machine's cached translations.
+//
+//	"frame" -- the frame, which must be in use
+//----------------------------------------------------------------------
+
+void
+CoreMap::ClearUse(FrameInfo *frame)
+{
+    for (FrameMapping *m = frame->mappings; m != NULL; m = m->next)
+	m->entry->use = FALSE;
+}
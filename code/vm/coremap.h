@@ -0,0 +1,113 @@
+// coremap.h
+//	Data structures to keep track of the physical page frames of
+//	main memory, under demand paging: which virtual page of which
+//	address space each frame holds, and which frame to take away
+//	when we run out.
+//
+//	The page replacement policy is chosen when Nachos starts (-rp):
+//
+//	FIFO -- replace the page that was loaded the longest time ago
+//	clock -- FIFO, but give pages that have been used since the
+//		hand last passed them a second chance
+//	LRU -- approximate least recently used: each time we need a
+//		frame, shift every page's use bit into an "age" byte,
+//		and replace the page with the smallest age, preferring
+//		clean pages (which needn't be written to swap)
+//
+//	A frame can hold a page of more than one address space, when a
+//	process has been forked and the pages are shared copy-on-write;
+//	then the page has been used if any of them has used it.  Code
+//	pages are shared the same way, by address spaces running the 
+//	same executable (see textcache.h).
+//
+//	A frame can be pinned, while the kernel reads or writes it on a
+//	user program's behalf; a pinned frame is never replaced.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef COREMAP_H
+#define COREMAP_H
+
+#include "copyright.h"
+#include "machine.h"
+
+class AddrSpace;
+
+// The page replacement policies we know about.
+
+enum ReplacementPolicy { FifoReplacement, ClockReplacement, LruReplacement };
+
+// The following class defines one of the pages in a frame.
+
+class FrameMapping {
+  public:
+    AddrSpace *space;		// address space the page belongs to
+    int virtualPage;		// which of its pages is in the frame
+    TranslationEntry *entry;	// the page's page table entry
+    FrameMapping *next;		// the next address space sharing the
+				// frame, if any
+};
+
+// The following class defines an entry in the core map: what is
+// in one physical page frame.
+
+class FrameInfo {
+  public:
+    FrameMapping *mappings;	// the pages in the frame, or NULL
+				// if the frame is free
+    int loadedAt;		// when the page was loaded (for FIFO)
+    unsigned char age;		// recent history of the use bit (for LRU)
+    int *cacheEntry;		// where the text cache remembers that
+				// the page is in this frame, or NULL
+    int pins;			// # of kernel I/Os using the frame
+};
+
+// The following class defines the core map -- one entry for each
+// physical page frame.
+
+class CoreMap {
+  public:
+    CoreMap(ReplacementPolicy which);	// Initialize the core map, with
+					// all frames free (in frameMap)
+    ~CoreMap();
+
+    int Allocate(AddrSpace *space, int vpn, TranslationEntry *entry);
+					// Find a frame for page "vpn" of
+					// "space", paging another page out
+					// if there are none free
+    void Share(int frame, AddrSpace *space, int vpn,
+			TranslationEntry *entry);
+					// Page "vpn" of "space" shares the
+					// page already in "frame"
+    void Unmap(int frame, AddrSpace *space);
+					// "space" no longer needs the page
+					// in "frame"
+    bool IsShared(int frame);		// Is the page in "frame" used by
+					// more than one address space?
+    void Pin(int frame);		// Don't replace the page in "frame"
+    void Unpin(int frame);		// until it is unpinned
+    void Cache(int frame, int *entry);	// The text cache remembers the page
+					// in "frame" at "entry"; set it to
+					// -1 when the page leaves the frame
+
+  private:
+    void Evict(int frame);		// Take the page out of "frame"
+    bool Used(FrameInfo *frame);	// Have any of the address spaces
+    bool Dirty(FrameInfo *frame);	// using the page used (modified)
+					// it?
+    void ClearUse(FrameInfo *frame);	// Clear their use bits
+
+    int ChooseVictim();			// Pick a page to replace,
+    int FifoVictim();			// by the replacement policy
+    int ClockVictim();
+    int LruVictim();
+
+    FrameInfo frames[NumPhysPages];
+    ReplacementPolicy policy;		// how to choose a page to replace
+    int hand;				// where the clock hand is
+    int numLoads;			// # of pages loaded so far
+};
+
+#endif // COREMAP_H
@@ -0,0 +1,159 @@
+// swap.cc
+//	Routines to manage the swap space.
+//
+//	The swap file is only created once there is a user program that
+//	may need it.  With the file system stub it is a scratch file on 
+//	the host, which goes away when Nachos exits; this also means that
+//	copies of Nachos running a batch of programs (-j) each get their
+//	own.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "swap.h"
+
+//----------------------------------------------------------------------
+// SwapSpace::SwapSpace
+// 	Initialize the swap space; every slot starts out free.
+//----------------------------------------------------------------------
+
+SwapSpace::SwapSpace()
+{
+    file = NULL;
+    creating = new Lock("swap file");
+    slotsInUse = new BitMap(NumSwapPages);
+    refs = new int[NumSwapPages];
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::~SwapSpace
+// 	De-allocate the swap space, and close (and, with a real file
+//	system, remove) the swap file.
+//----------------------------------------------------------------------
+
+SwapSpace::~SwapSpace()
+{
+    delete slotsInUse;
+    delete [] refs;
+    delete creating;
+    if (file != NULL) {
+	delete file;
+#ifndef FILESYS_STUB
+	fileSystem->Remove(SwapFileName);
+#endif
+    }
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::Open
+// 	Create the swap file, if it doesn't exist yet.  Called when an
+//	address space is made, so that paging out never has to wait for
+//	the file to be created: a page being paged out is in limbo --
+//	no longer in memory, and not yet in its slot.
+//----------------------------------------------------------------------
+
+void
+SwapSpace::Open()
+{
+    creating->Acquire();		// in case someone else is creating it
+    if (file == NULL) {
+#ifdef FILESYS_STUB
+	file = new OpenFile(OpenScratchFile());
+#else
+	bool created = fileSystem->Create(SwapFileName, 
+					NumSwapPages * PageSize);
+
+	ASSERT(created);
+	file = fileSystem->Open(SwapFileName);
+#endif
+    }
+    creating->Release();
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::Allocate
+// 	Find a free slot in the swap space.  It's a fatal error to run out
+//	of swap space.
+//----------------------------------------------------------------------
+
+int
+SwapSpace::Allocate()
+{
+    int slot = slotsInUse->Find();
+
+    ASSERT(file != NULL);
+    ASSERT(slot != -1);			// out of swap space
+    refs[slot] = 1;
+    return slot;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::Share
+// 	Record that another address space is using the page in a slot.
+//
+//	"slot" -- the slot, which must be in use
+//----------------------------------------------------------------------
+
+void
+SwapSpace::Share(int slot)
+{
+    ASSERT(slotsInUse->Test(slot));
+    refs[slot]++;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::Free
+// 	Record that an address space no longer needs the page in a slot;
+//	if no other address space does either, free the slot.
+//
+//	"slot" -- the slot to free
+//----------------------------------------------------------------------
+
+void
+SwapSpace::Free(int slot)
+{
+    ASSERT(slotsInUse->Test(slot));
+    if (--refs[slot] == 0)
+	slotsInUse->Clear(slot);
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::IsShared
+// 	Return TRUE if more than one address space is using the page in
+//	a slot, so that it mustn't be overwritten.
+//
+//	"slot" -- the slot, which must be in use
+//----------------------------------------------------------------------
+
+bool
+SwapSpace::IsShared(int slot)
+{
+    ASSERT(slotsInUse->Test(slot));
+    return refs[slot] > 1;
+}
+
+//----------------------------------------------------------------------
+// SwapSpace::ReadPage, SwapSpace::WritePage
+// 	Copy a page between a slot in the swap space, and main memory.
+//
+//	"slot" -- the slot to read or write
+//	"into", "from" -- where the page is in main memory
+//----------------------------------------------------------------------
+
+void
+SwapSpace::ReadPage(int slot, char *into)
+{
+    ASSERT(slotsInUse->Test(slot));
+    file->ReadAt(into, PageSize, slot * PageSize);
+}
+
+void
+SwapSpace::WritePage(int slot, char *from)
+{
+    ASSERT(slotsInUse->Test(slot));
+    file->WriteAt(from, PageSize, slot * PageSize);
+    stats->numPageOuts++;
+}
@@ -0,0 +1,68 @@
+// swap.h
+//	Data structures for the swap space -- the backing store for
+//	pages of virtual memory that have been modified, when they are
+//	not in main memory.
+//
+//	Pages that haven't been modified don't need swap space: they
+//	can always be read again from the executable (or, for the
+//	uninitialized data and the stack, zero filled).
+//
+//	A slot can be shared by the address spaces of forked processes,
+//	until one of them writes out a different copy of the page; so we
+//	keep count of how many are using each slot.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "copyright.h"
+#include "machine.h"
+#include "openfile.h"
+#include "bitmap.h"
+#include "synch.h"
+
+#ifdef FILESYS_STUB
+#define NumSwapPages	512	// size of the swap space, in pages
+#else
+#define NumSwapPages	(NumSectors * SectorSize / PageSize / 4)
+					// a quarter of the disk
+#endif
+#define SwapFileName	"SWAP"	// the swap file, if we have a real
+				// file system
+
+// The following class defines the swap space: a file of page-sized
+// slots, each of which can hold one page.
+
+class SwapSpace {
+  public:
+    SwapSpace();			// Initialize the swap space, with
+					// all slots free
+    ~SwapSpace();			// De-allocate the swap space
+
+    void Open();			// Create the swap file, if we haven't
+					// yet
+    int Allocate();			// Find a free slot for a page
+    void Share(int slot);		// One more address space is using
+					// the page in "slot"
+    void Free(int slot);		// One fewer address space needs the
+					// page in "slot"
+    bool IsShared(int slot);		// Is more than one using it?
+
+    void ReadPage(int slot, char *into);	// Read/write the page in
+    void WritePage(int slot, char *from);	// "slot", to/from "into" or
+						// "from" in main memory
+
+  private:
+    OpenFile *file;			// the swap file, or NULL if we
+					// haven't needed it yet
+    Lock *creating;			// held while the swap file is being
+					// created, which may mean waiting for
+					// the disk
+    BitMap *slotsInUse;			// which slots hold pages
+    int *refs;				// # of address spaces using each
+};
+
+#endif // SWAP_H
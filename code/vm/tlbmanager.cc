@@ -0,0 +1,249 @@
+// tlbmanager.cc
+//	Routines to refill the TLB on a miss, and to keep the page tables
+//	up to date with what the hardware has recorded in the TLB.
+//
+//	Note that the machine caches translations, along with the use
+//	and dirty bits it has set (see translate.cc), so whenever we
+//	replace a TLB entry, or clear its use bit, we must flush the
+//	cached translations.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#include "copyright.h"
+#include "system.h"
+#include "tlbmanager.h"
+
+//----------------------------------------------------------------------
+// TlbManager::TlbManager
+// 	Initialize the management of the TLBs.  Must be called after the
+//	machine has been set up, since we need to know how big its TLBs
+//	are.
+//
+//	"which" -- the TLB replacement policy to use
+//----------------------------------------------------------------------
+
+TlbManager::TlbManager(TlbPolicy which)
+{
+    int numEntries = machine->numCpus * machine->tlbSize;
+
+    policy = which;
+    asidsInUse = new BitMap(NumAsids);
+    for (int i = 0; i < NumAsids; i++)
+	pageTables[i] = NULL;
+    loadedAt = new int[numEntries];
+    age = new unsigned char[numEntries];
+    for (int i = 0; i < numEntries; i++) {
+	loadedAt[i] = 0;
+	age[i] = 0;
+    }
+    numLoads = 0;
+}
+
+//----------------------------------------------------------------------
+// TlbManager::~TlbManager
+// 	De-allocate the data structures for managing the TLBs.
+//----------------------------------------------------------------------
+
+TlbManager::~TlbManager()
+{
+    delete asidsInUse;
+    delete [] loadedAt;
+    delete [] age;
+}
+
+//----------------------------------------------------------------------
+// TlbManager::NewAsid
+// 	Choose an address space identifier for a new address space.
+//	It's a fatal error to have more than NumAsids address spaces.
+//
+//	"pageTable" -- the address space's page table, where the use and
+//		dirty bits from its TLB entries are to be copied back to
+//----------------------------------------------------------------------
+
+int
+TlbManager::NewAsid(TranslationEntry *pageTable)
+{
+    int asid = asidsInUse->Find();
+
+    ASSERT(asid != -1);			// out of ASIDs
+    pageTables[asid] = pageTable;
+    return asid;
+}
+
+//----------------------------------------------------------------------
+// TlbManager::FreeAsid
+// 	An address space has gone away.  Invalidate whatever entries it
+//	has left in the TLBs (there's no need to copy their bits back),
+//	so that its ASID can be used again.
+//
+//	"asid" -- the address space identifier to free
+//----------------------------------------------------------------------
+
+void
+TlbManager::FreeAsid(int asid)
+{
+    TranslationEntry *tlb;
+
+    for (int cpu = 0; cpu < machine->numCpus; cpu++) {
+	tlb = machine->cpuTlb[cpu];
+	for (int i = 0; i < machine->tlbSize; i++)
+	    if (tlb[i].valid && (tlb[i].asid == asid))
+		tlb[i].valid = FALSE;
+    }
+    machine->FlushTranslations();
+    pageTables[asid] = NULL;
+    asidsInUse->Clear(asid);
+}
+
+//----------------------------------------------------------------------
+// TlbManager::Refill
+// 	Handle a TLB miss: load the translation for a page of the running
+//	address space into the current CPU's TLB, replacing an entry of
+//	the set the page maps to.
+//
+//	"vpn" -- the virtual page the program touched
+//	"entry" -- its page table entry, which must be valid
+//----------------------------------------------------------------------
+
+void
+TlbManager::Refill(int vpn, TranslationEntry *entry)
+{
+    int i = ChooseEntry(vpn % (machine->tlbSize / machine->tlbWays));
+    TranslationEntry *tlbEntry = &machine->tlb[i];
+    int index = machine->currentCpu * machine->tlbSize + i;
+
+    ASSERT(entry->valid);
+    if (tlbEntry->valid) {
+	DEBUG('a', "Replacing TLB entry %d, for page %d\n", i,
+		tlbEntry->virtualPage);
+	WriteBack(tlbEntry);
+	machine->FlushTranslations();	// the old entry may be cached
+    }
+    *tlbEntry = *entry;
+    tlbEntry->asid = machine->asid;
+    tlbEntry->use = FALSE;		// the hardware sets these, and
+    tlbEntry->dirty = FALSE;		// we copy them back
+    loadedAt[index] = numLoads++;
+    age[index] = 0x80;			// it is about to be used
+}
+
+//----------------------------------------------------------------------
+// TlbManager::Forget
+// 	Invalidate any TLB entry, on any CPU, for a page that is being
+//	taken out of memory, first copying back its use and dirty bits.
+//
+//	"asid" -- the address space the page belongs to
+//	"vpn" -- the virtual page
+//----------------------------------------------------------------------
+
+void
+TlbManager::Forget(int asid, int vpn)
+{
+    int set = vpn % (machine->tlbSize / machine->tlbWays);
+    TranslationEntry *tlb;
+
+    for (int cpu = 0; cpu < machine->numCpus; cpu++) {
+	tlb = machine->cpuTlb[cpu];
+	for (int i = set * machine->tlbWays;
+				i < (set + 1) * machine->tlbWays; i++)
+	    if (tlb[i].valid && (tlb[i].asid == asid)
+				&& (tlb[i].virtualPage == vpn)) {
+		WriteBack(&tlb[i]);
+		tlb[i].valid = FALSE;
+	    }
+    }
+    machine->FlushTranslations();
+}
+
+//----------------------------------------------------------------------
+// TlbManager::Sync
+// 	Bring the use and dirty bits of the page tables up to date, by
+//	copying them back from every TLB entry on every CPU.  We clear
+//	the use bits in the TLBs as we go, so that a page table use bit
+//	cleared by page replacement stays cleared until the page really
+//	is used again.
+//----------------------------------------------------------------------
+
+void
+TlbManager::Sync()
+{
+    TranslationEntry *tlb;
+
+    for (int cpu = 0; cpu < machine->numCpus; cpu++) {
+	tlb = machine->cpuTlb[cpu];
+	for (int i = 0; i < machine->tlbSize; i++)
+	    if (tlb[i].valid) {
+		WriteBack(&tlb[i]);
+		tlb[i].use = FALSE;
+	    }
+    }
+    machine->FlushTranslations();
+}
+
+//----------------------------------------------------------------------
+// TlbManager::ChooseEntry
+// 	Choose which entry of a set of the current CPU's TLB to replace:
+//	an invalid one if there is one, else one chosen by the policy.
+//
+//	"set" -- the set the page being loaded maps to
+//----------------------------------------------------------------------
+
+int
+TlbManager::ChooseEntry(int set)
+{
+    TranslationEntry *tlb = machine->tlb;
+    int first = set * machine->tlbWays;
+    int last = first + machine->tlbWays;
+    int base = machine->currentCpu * machine->tlbSize;
+    int victim = first;
+
+    for (int i = first; i < last; i++)
+	if (!tlb[i].valid)
+	    return i;
+
+    switch (policy) {
+      case RandomTlb:
+	victim = first + Random() % machine->tlbWays;
+	break;
+      case FifoTlb:
+	for (int i = first + 1; i < last; i++)
+	    if (loadedAt[base + i] < loadedAt[base + victim])
+		victim = i;
+	break;
+      case LruTlb:
+	for (int i = first; i < last; i++) {
+	    WriteBack(&tlb[i]);		// before we clear the use bit
+	    age[base + i] = (age[base + i] >> 1) | (tlb[i].use ? 0x80 : 0);
+	    tlb[i].use = FALSE;
+	    if ((age[base + i] < age[base + victim]) ||
+			((age[base + i] == age[base + victim]) &&
+			(loadedAt[base + i] < loadedAt[base + victim])))
+		victim = i;
+	}
+	machine->FlushTranslations();	// we cleared use bits
+	break;
+    }
+    return victim;
+}
+
+//----------------------------------------------------------------------
+// TlbManager::WriteBack
+// 	Copy the use and dirty bits the hardware has set in a TLB entry
+//	back to the page table entry it was loaded from.
+//
+//	"tlbEntry" -- the TLB entry, which must be valid
+//----------------------------------------------------------------------
+
+void
+TlbManager::WriteBack(TranslationEntry *tlbEntry)
+{
+    TranslationEntry *entry =
+		&pageTables[tlbEntry->asid][tlbEntry->virtualPage];
+
+    if (tlbEntry->use)
+	entry->use = TRUE;
+    if (tlbEntry->dirty)
+	entry->dirty = TRUE;
+}
@@ -0,0 +1,82 @@
+// tlbmanager.h
+//	Data structures for managing the contents of the TLB, when the
+//	machine has one (USE_TLB) instead of walking our page tables.
+//
+//	On a TLB miss, the kernel loads the translation from the running
+//	address space's page table into the TLB, replacing an entry of
+//	the set the page maps to.  Which entry to replace is chosen when
+//	Nachos starts (-tlbr):
+//
+//	random -- any entry of the set
+//	FIFO -- the entry that was loaded the longest time ago
+//	LRU -- approximate least recently used: on each refill, shift
+//		the use bit of every entry in the set into its "age",
+//		and replace the entry with the smallest age
+//
+//	Each address space has an address space identifier (ASID), and
+//	the TLB only matches entries tagged with the running one, so we
+//	needn't flush the TLB on a context switch.  The price is that
+//	the page tables no longer see every reference: the hardware sets
+//	the use and dirty bits in the TLB, and we copy them back to the
+//	page tables before they are looked at, or the entry is lost.
+//
+// Copyright (c) 1992-1993 The Regents of the University of California.
+// All rights reserved.  See copyright.h for copyright notice and limitation
+// of liability and disclaimer of warranty provisions.
+
+#ifndef TLBMANAGER_H
+#define TLBMANAGER_H
+
+#include "copyright.h"
+#include "machine.h"
+#include "bitmap.h"
+
+#define NumAsids	64	// # of address spaces with TLB entries
+
+// The TLB replacement policies we know about.
+
+enum TlbPolicy { RandomTlb, FifoTlb, LruTlb };
+
+// The following class defines the kernel's management of the TLBs of
+// all the CPUs.
+
+class TlbManager {
+  public:
+    TlbManager(TlbPolicy which);	// Initialize; the TLBs start out
+					// empty
+    ~TlbManager();
+
+    int NewAsid(TranslationEntry *pageTable);
+					// Choose an ASID for an address
+					// space, with page table "pageTable"
+    void FreeAsid(int asid);		// The address space has gone away;
+					// remove its entries from the TLBs
+
+    void Refill(int vpn, TranslationEntry *entry);
+					// Load "entry", the translation for
+					// "vpn" in the running address
+					// space, into the TLB
+    void Forget(int asid, int vpn);	// Remove any TLB entries for page
+					// "vpn" of address space "asid",
+					// copying back their use/dirty bits
+    void Sync();			// Copy the use and dirty bits of
+					// every TLB entry back to the page
+					// tables, clearing the use bits
+
+  private:
+    int ChooseEntry(int set);		// Pick an entry of "set" of the
+					// current CPU's TLB to replace
+    void WriteBack(TranslationEntry *tlbEntry);
+					// Copy an entry's use/dirty bits
+					// back to its page table
+
+    TlbPolicy policy;			// how to choose an entry to replace
+    BitMap *asidsInUse;			// which ASIDs are taken
+    TranslationEntry *pageTables[NumAsids];	// page table of each ASID
+    int *loadedAt;			// when each entry of each CPU's TLB
+    unsigned char *age;			// was loaded, and how recently it
+					// has been used
+    int numLoads;			// # of entries loaded so far
+};
+
+#endif // TLBMANAGER_H